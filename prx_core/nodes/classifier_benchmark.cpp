@@ -0,0 +1,419 @@
+/**
+ * @file classifier_benchmark.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/applications/digit_classifier.hpp"
+#include "prx/utilities/applications/classifier_kernels.hpp"
+#include "prx/utilities/applications/idx_file.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace prx::util;
+
+static std::vector<float> random_values(size_t count)
+{
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; ++i)
+        values[i] = rand() / (float)RAND_MAX - 0.5f;
+    return values;
+}
+
+static std::vector<int8_t> random_quantized(size_t count)
+{
+    std::vector<int8_t> values(count);
+    for (size_t i = 0; i < count; ++i)
+        values[i] = rand() % 255 - 127;
+    return values;
+}
+
+// largest probability difference from the scalar kernels any implementation may have
+static const double parity_tolerance = 1e-4;
+
+// Switches to implementation k, or with k == available_count to the per layer choice of the classifier, and
+// names it
+static std::string select_kernels(digit_classifier_t& classifier, const classifier_kernels_t* const* available, int available_count, int k)
+{
+    if (k < available_count)
+    {
+        classifier.set_kernels(*available[k]);
+        return available[k]->name;
+    }
+    classifier.use_fastest_kernels();
+    std::string name = "fastest per layer (";
+    for (unsigned l = 0; l < classifier.get_layer_count(); ++l)
+        name += std::string(l > 0 ? " " : "") + classifier.get_layer_kernels(l).name;
+    return name + ")";
+}
+
+// Classifies every image with every implementation and compares the probabilities and labels with the first,
+// scalar, one; returns whether all of them stay within parity_tolerance
+static bool check_parity(digit_classifier_t& classifier, const classifier_kernels_t* const* available, int available_count,
+                         const std::vector<float>& inputs, const idx_dataset_t& test, int count)
+{
+    std::vector<float> reference((size_t)count * 10);
+    std::vector<int> reference_labels(count);
+    bool within = true;
+    for (int k = 0; k <= available_count; ++k)
+    {
+        std::string name = select_kernels(classifier, available, available_count, k);
+        float probabilities[10];
+        int correct = 0, disagreements = 0;
+        double largest_difference = 0;
+        sys_clock_t clock;
+        clock.reset();
+        for (int i = 0; i < count; ++i)
+        {
+            int label = classifier.classify(&inputs[(size_t)i * 784], probabilities);
+            correct += label == test.get_label(i);
+            if (k == 0)
+            {
+                reference_labels[i] = label;
+                std::copy(probabilities, probabilities + 10, &reference[(size_t)i * 10]);
+            }
+            disagreements += label != reference_labels[i];
+            for (int o = 0; o < 10; ++o)
+                largest_difference = PRX_MAXIMUM(largest_difference, std::fabs(probabilities[o] - reference[(size_t)i * 10 + o]));
+        }
+        double elapsed = clock.measure();
+        std::cout << name << ": accuracy " << correct / (double)count << ", " << 1e6 * elapsed / count << " us per image, "
+                  << disagreements << " labels and at most " << largest_difference << " probability different from scalar"
+                  << (largest_difference > parity_tolerance ? "  (ABOVE TOLERANCE)" : "") << std::endl;
+        within = within && largest_difference <= parity_tolerance;
+    }
+    return within;
+}
+
+// The convolutional network of tf_train_model_ASSIGNMENT_FILE_EXTRACREDIT.py with seeded random weights, so every
+// kernel the deployed softmax model does not use is checked on t10k too. Weights are uniform with variance 1 / fan in,
+// which keeps the activations of every layer around 1.
+static bool check_network_parity(const classifier_kernels_t* const* available, int available_count, const std::vector<float>& inputs,
+                                 const idx_dataset_t& test, int count)
+{
+    // weights, fan in and bias of every layer in load_weights order
+    const size_t shapes[4][3] = {{5 * 5 * 1 * 32, 5 * 5 * 1, 32}, {5 * 5 * 32 * 64, 5 * 5 * 32, 64}, {7 * 7 * 64 * 1024, 7 * 7 * 64, 1024}, {1024 * 10, 1024, 10}};
+    std::vector<float> parameters;
+    srand(13);
+    for (int l = 0; l < 4; ++l)
+    {
+        float range = std::sqrt(3.0f / shapes[l][1]);
+        for (size_t w = 0; w < shapes[l][0]; ++w)
+            parameters.push_back(range * (2 * rand() / (float)RAND_MAX - 1));
+        parameters.insert(parameters.end(), shapes[l][2], 0.01f);
+    }
+
+    // load_weights copies raw files, so the file can go as soon as it is loaded
+    char path[] = "/tmp/classifier_parity_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return false;
+    FILE* file = fdopen(fd, "wb");
+    bool written = fwrite(parameters.data(), sizeof(float), parameters.size(), file) == parameters.size();
+    fclose(file);
+    digit_classifier_t network;
+    network.set_layers("conv 5 32 relu, pool, conv 5 64 relu, pool, dense 1024 relu, dense 10");
+    if (written)
+        network.load_weights(path);
+    unlink(path);
+    if (!written)
+        return false;
+
+    std::cout << "Convolutional network with seeded weights, " << network.get_parameter_count() << " parameters:" << std::endl;
+    return check_parity(network, available, available_count, inputs, test, count);
+}
+
+// Compares every implementation with the logits the source model gives the first t10k images, written by
+// sensing/reference_logits.py; returns whether all of them stay within parity_tolerance
+static bool check_reference(digit_classifier_t& classifier, const classifier_kernels_t* const* available, int available_count,
+                            const std::vector<float>& inputs, int count, const std::string& reference_path)
+{
+    std::ifstream fin(reference_path.c_str());
+    std::vector<float> reference;
+    std::vector<int> reference_labels;
+    int label;
+    while ((int)reference_labels.size() < count && fin >> label)
+    {
+        double logits[10], largest = -1e30, sum = 0;
+        for (int o = 0; o < 10; ++o)
+            if (fin >> logits[o])
+                largest = PRX_MAXIMUM(largest, logits[o]);
+        if (!fin)
+            break;
+        int best = 0;
+        for (int o = 0; o < 10; ++o)
+        {
+            sum += std::exp(logits[o] - largest);
+            if (logits[o] > logits[best])
+                best = o;
+        }
+        for (int o = 0; o < 10; ++o)
+            reference.push_back(std::exp(logits[o] - largest) / sum);
+        reference_labels.push_back(best);
+    }
+    if (reference_labels.empty())
+    {
+        std::cout << "No reference logits in " << reference_path << ", write them with sensing/reference_logits.py" << std::endl;
+        return true;
+    }
+
+    std::cout << "Against the source model on " << reference_labels.size() << " images of " << reference_path << ":" << std::endl;
+    bool within = true;
+    for (int k = 0; k <= available_count; ++k)
+    {
+        std::string name = select_kernels(classifier, available, available_count, k);
+        float probabilities[10];
+        int disagreements = 0;
+        double largest_difference = 0;
+        for (unsigned i = 0; i < reference_labels.size(); ++i)
+        {
+            disagreements += classifier.classify(&inputs[(size_t)i * 784], probabilities) != reference_labels[i];
+            for (int o = 0; o < 10; ++o)
+                largest_difference = PRX_MAXIMUM(largest_difference, std::fabs(probabilities[o] - reference[(size_t)i * 10 + o]));
+        }
+        std::cout << name << ": " << disagreements << " labels and at most " << largest_difference << " probability different from the source model"
+                  << (largest_difference > parity_tolerance || disagreements > 0 ? "  (ABOVE TOLERANCE)" : "") << std::endl;
+        within = within && largest_difference <= parity_tolerance && disagreements == 0;
+    }
+    return within;
+}
+
+// How the sensing_confidence threshold of the application would split t10k: the share of images below it,
+// which SENSE retries or hedges between the top two digits, the accuracy of the rest, and for the images below
+// it how often the best digit is right, which is all a retry of the same view can give, against how often one
+// of the best two is, which hedging can reach. binary feeds 1 for pixels above 0.5 and 0 elsewhere, about the
+// black and white input sense_environment.py makes of a frame.
+static void report_confidence(digit_classifier_t& classifier, const std::vector<float>& inputs, const idx_dataset_t& test, int count, bool binary)
+{
+    static const double thresholds[] = {0.3, 0.5, 0.7, 0.9, 0.99};
+    const int threshold_count = sizeof(thresholds) / sizeof(thresholds[0]);
+    int below[threshold_count] = {0}, above_correct[threshold_count] = {0}, below_top1[threshold_count] = {0}, below_top2[threshold_count] = {0};
+    std::vector<float> image(784);
+    float probabilities[10];
+    for (int i = 0; i < count; ++i)
+    {
+        for (int p = 0; p < 784; ++p)
+            image[p] = binary ? (inputs[(size_t)i * 784 + p] > 0.5f ? 1.0f : 0.0f) : inputs[(size_t)i * 784 + p];
+        int best = classifier.classify(image.data(), probabilities);
+        int second = best == 0 ? 1 : 0;
+        for (int o = 0; o < 10; ++o)
+            if (o != best && probabilities[o] > probabilities[second])
+                second = o;
+        int label = test.get_label(i);
+        for (int t = 0; t < threshold_count; ++t)
+        {
+            if (probabilities[best] >= thresholds[t])
+                above_correct[t] += best == label;
+            else
+            {
+                below[t]++;
+                below_top1[t] += best == label;
+                below_top2[t] += best == label || second == label;
+            }
+        }
+    }
+    std::cout << "Sensing confidence on " << (binary ? "binary" : "continuous") << " t10k inputs:" << std::endl;
+    for (int t = 0; t < threshold_count; ++t)
+    {
+        int above = count - below[t];
+        std::cout << "  below " << thresholds[t] << ": " << 100.0 * below[t] / count << "% of images, accuracy above " << (above > 0 ? above_correct[t] / (double)above : 0)
+                  << ", below: best digit right " << (below[t] > 0 ? below_top1[t] / (double)below[t] : 0) << ", one of the best two "
+                  << (below[t] > 0 ? below_top2[t] / (double)below[t] : 0) << std::endl;
+    }
+}
+
+// accuracy and microseconds per image over t10k[first:count]
+static double evaluate(digit_classifier_t& classifier, const std::vector<float>& inputs, const idx_dataset_t& test, int first, int count, double& microseconds)
+{
+    int correct = 0;
+    sys_clock_t clock;
+    clock.reset();
+    for (int i = first; i < count; ++i)
+        correct += classifier.classify(&inputs[(size_t)i * 784]) == test.get_label(i);
+    microseconds = 1e6 * clock.measure() / (count - first);
+    return correct / (double)(count - first);
+}
+
+// time one kernel on the layer shapes of the convolutional network in tf_train_model_ASSIGNMENT_FILE_EXTRACREDIT.py
+static void benchmark_kernels(const classifier_kernels_t& kernels, int repetitions)
+{
+    std::vector<float> image = random_values(28 * 28 * 32), pooled = random_values(14 * 14 * 64);
+    std::vector<float> conv1 = random_values(5 * 5 * 1 * 32), conv2 = random_values(5 * 5 * 32 * 64);
+    std::vector<float> fc1 = random_values(7 * 7 * 64 * 1024), fc2 = random_values(1024 * 10), bias = random_values(1024);
+    std::vector<float> out(28 * 28 * 64);
+    std::vector<int8_t> quantized_image = random_quantized(28 * 28 * 32), quantized_pooled = random_quantized(14 * 14 * 64);
+    std::vector<int8_t> quantized_conv1 = random_quantized(conv1.size()), quantized_conv2 = random_quantized(conv2.size());
+    std::vector<int8_t> quantized_fc1 = random_quantized(fc1.size()), quantized_fc2 = random_quantized(fc2.size());
+    std::vector<float> scales = random_values(1024);
+    int batch = 16;
+    std::vector<float> batch_in = random_values((size_t)batch * 7 * 7 * 64), batch_out((size_t)batch * 1024);
+
+    sys_clock_t clock;
+    double times[11] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (int r = 0; r < repetitions; ++r)
+    {
+        clock.reset();
+        kernels.convolution(image.data(), 28, 28, 1, conv1.data(), bias.data(), 5, 32, true, out.data());
+        times[0] += clock.measure_reset();
+        kernels.max_pool(image.data(), 28, 28, 32, out.data());
+        times[1] += clock.measure_reset();
+        kernels.convolution(pooled.data(), 14, 14, 32, conv2.data(), bias.data(), 5, 64, true, out.data());
+        times[2] += clock.measure_reset();
+        kernels.dense(pooled.data(), 7 * 7 * 64, fc1.data(), bias.data(), 1024, true, out.data());
+        times[3] += clock.measure_reset();
+        kernels.dense(pooled.data(), 1024, fc2.data(), bias.data(), 10, false, out.data());
+        times[4] += clock.measure_reset();
+        kernels.quantized_convolution(quantized_image.data(), 28, 28, 1, quantized_conv1.data(), scales.data(), bias.data(), 5, 32, true, out.data());
+        times[5] += clock.measure_reset();
+        kernels.quantized_convolution(quantized_pooled.data(), 14, 14, 32, quantized_conv2.data(), scales.data(), bias.data(), 5, 64, true, out.data());
+        times[6] += clock.measure_reset();
+        kernels.quantized_dense(quantized_pooled.data(), 7 * 7 * 64, quantized_fc1.data(), scales.data(), bias.data(), 1024, true, out.data());
+        times[7] += clock.measure_reset();
+        kernels.quantized_dense(quantized_pooled.data(), 1024, quantized_fc2.data(), scales.data(), bias.data(), 10, false, out.data());
+        times[8] += clock.measure_reset();
+        kernels.dense_batch(batch_in.data(), batch, 7 * 7 * 64, fc1.data(), bias.data(), 1024, true, batch_out.data());
+        times[9] += clock.measure_reset() / batch;
+        kernels.dense_batch(batch_in.data(), batch, 1024, fc2.data(), bias.data(), 10, false, batch_out.data());
+        times[10] += clock.measure_reset() / batch;
+    }
+    const char* names[11] = {"conv 5x5 1->32 28x28 ", "max pool 28x28x32    ", "conv 5x5 32->64 14x14", "dense 3136->1024     ", "dense 1024->10       ",
+                            "int8 conv 5x5 1->32  ", "int8 conv 5x5 32->64 ", "int8 dense 3136->1024", "int8 dense 1024->10  ",
+                            "dense 3136->1024 x16 ", "dense 1024->10 x16   "};
+    // the batched dense layers are per image
+    for (int k = 0; k < 11; ++k)
+        std::cout << "  " << kernels.name << " " << names[k] << ": " << 1e6 * times[k] / repetitions << " us" << std::endl;
+}
+
+int main(int ac, char* av[])
+{
+    if (ac < 2)
+    {
+        std::cout << "Usage: classifier_benchmark <MNIST_data directory> [weights] [repetitions] [int8 weights output]" << std::endl;
+        return 1;
+    }
+    std::string data_directory = av[1];
+    std::string weights = ac > 2 ? av[2] : "";
+    int repetitions = ac > 3 ? atoi(av[3]) : 20;
+    std::string quantized_output = ac > 4 ? av[4] : "";
+
+    idx_dataset_t test;
+    sys_clock_t read_clock;
+    read_clock.reset();
+    if (!test.open(data_directory, "t10k") || test.get_rows() * test.get_columns() != 784)
+    {
+        std::cout << "Could not read the t10k set in " << data_directory << ": " << test.get_error() << std::endl;
+        return 1;
+    }
+    int count = test.get_count();
+    std::vector<float> inputs((size_t)count * 784);
+    test.get_inputs(0, count, inputs.data());
+    std::cout << "Read " << count << " t10k images in " << 1e3 * read_clock.measure() << " ms" << std::endl;
+
+    const classifier_kernels_t* available[4];
+    int available_count = get_available_classifier_kernels(available, 4);
+    std::cout << "Widest kernels on this CPU: " << get_classifier_kernels().name << std::endl;
+
+    // parity: every implementation against the scalar reference on t10k, for convolution, pooling and dense with
+    // and without relu
+    bool within_tolerance = check_network_parity(available, available_count, inputs, test, count);
+
+    if (!weights.empty())
+    {
+        // and for the deployed weights
+        digit_classifier_t classifier;
+        classifier.set_layers("dense 10");
+        classifier.load_weights(weights);
+        std::cout << "Deployed weights " << weights << ":" << std::endl;
+        within_tolerance = check_parity(classifier, available, available_count, inputs, test, count) && within_tolerance;
+        // the reference logits sit beside the weights, tf_model-8.logits for tf_model-8.weights
+        std::string reference_path = weights;
+        if (reference_path.size() > 8 && reference_path.compare(reference_path.size() - 8, 8, ".weights") == 0)
+            reference_path.erase(reference_path.size() - 8);
+        within_tolerance = check_reference(classifier, available, available_count, inputs, count, reference_path + ".logits") && within_tolerance;
+        std::vector<float> reference((size_t)count * 10);
+        std::vector<int> reference_labels(count);
+        classifier.set_kernels(*available[0]);
+        for (int i = 0; i < count; ++i)
+            reference_labels[i] = classifier.classify(&inputs[(size_t)i * 784], &reference[(size_t)i * 10]);
+
+        // what a sensing_confidence threshold would do with this model
+        classifier.use_fastest_kernels();
+        report_confidence(classifier, inputs, test, count, false);
+        report_confidence(classifier, inputs, test, count, true);
+
+        // batches: the same labels and confidences as one image at a time
+        std::vector<int> batch_labels(count);
+        std::vector<float> confidences(count);
+        for (int k = 0; k <= available_count; ++k)
+        {
+            std::string name = select_kernels(classifier, available, available_count, k);
+            sys_clock_t clock;
+            clock.reset();
+            classifier.classify_batch(inputs.data(), count, batch_labels.data(), confidences.data());
+            double elapsed = clock.measure();
+            int correct = 0, disagreements = 0;
+            double largest_difference = 0;
+            for (int i = 0; i < count; ++i)
+            {
+                correct += batch_labels[i] == test.get_label(i);
+                disagreements += batch_labels[i] != reference_labels[i];
+                largest_difference = PRX_MAXIMUM(largest_difference, std::fabs(confidences[i] - reference[(size_t)i * 10 + reference_labels[i]]));
+            }
+            std::cout << name << " batched: accuracy " << correct / (double)count << ", " << 1e6 * elapsed / count << " us per image, "
+                      << disagreements << " labels and at most " << largest_difference << " confidence different from scalar" << std::endl;
+        }
+
+        // int8: calibrate on training images when they are there, otherwise on the start of t10k, and never evaluate on
+        // the calibration images
+        classifier.use_fastest_kernels();
+        idx_dataset_t train;
+        int calibration_count = 1000, first = 0;
+        std::vector<float> calibration((size_t)calibration_count * 784);
+        if (train.open(data_directory, "train", calibration_count) && (int)train.get_count() == calibration_count)
+        {
+            train.get_inputs(0, calibration_count, calibration.data());
+            std::cout << "Calibrating int8 on train[0:" << calibration_count << "], evaluating on t10k[0:" << count << "]" << std::endl;
+        }
+        else
+        {
+            calibration_count = PRX_MINIMUM(calibration_count, count / 2);
+            calibration.assign(inputs.begin(), inputs.begin() + (size_t)calibration_count * 784);
+            first = calibration_count;
+            std::cout << "No training images, calibrating int8 on t10k[0:" << calibration_count << "], evaluating on t10k[" << first << ":" << count
+                      << "]" << std::endl;
+        }
+
+        double float_time, quantized_time;
+        double float_accuracy = evaluate(classifier, inputs, test, first, count, float_time);
+        size_t float_bytes = classifier.get_weight_bytes();
+        classifier.quantize(calibration.data(), calibration_count);
+        double quantized_accuracy = evaluate(classifier, inputs, test, first, count, quantized_time);
+        std::cout << "float32: accuracy " << float_accuracy << ", " << float_time << " us per image, " << float_bytes << " bytes of weights" << std::endl;
+        std::cout << "int8:    accuracy " << quantized_accuracy << " (" << (quantized_accuracy - float_accuracy) * 100 << " points), " << quantized_time
+                  << " us per image (" << float_time / quantized_time << "x), " << classifier.get_weight_bytes() << " bytes of weights" << std::endl;
+        if (!quantized_output.empty())
+        {
+            classifier.save_weights(quantized_output);
+            std::cout << "Wrote " << quantized_output << std::endl;
+        }
+    }
+
+    for (int k = 0; k < available_count; ++k)
+        benchmark_kernels(*available[k], repetitions);
+    return within_tolerance ? 0 : 1;
+}
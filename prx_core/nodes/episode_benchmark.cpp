@@ -0,0 +1,298 @@
+/**
+ * @file episode_benchmark.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/applications/digit_classifier.hpp"
+#include "prx/utilities/applications/digit_layout.hpp"
+#include "prx/utilities/applications/distance_oracle.hpp"
+#include "prx/utilities/applications/idx_file.hpp"
+#include "prx/utilities/applications/maze_loader.hpp"
+#include "prx/utilities/applications/search.hpp"
+#include "prx/utilities/definitions/random.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+using namespace prx::util;
+
+// Reads the digit in a rendered 28x28 bitmap, the pluggable part of the classifier sensor
+typedef std::function<int (const float* bitmap)> classifier_callback_t;
+
+static void report_latencies(const std::string& name, std::vector<double>& seconds)
+{
+    if (seconds.empty())
+        return;
+    std::sort(seconds.begin(), seconds.end());
+    double total = 0;
+    for (double s : seconds)
+        total += s;
+    auto percentile = [&](double p) { return 1000 * seconds[PRX_MINIMUM(seconds.size() - 1, (size_t)(p * seconds.size()))]; };
+    std::cout << name << ": mean " << 1000 * total / seconds.size() << " ms, p50 " << percentile(0.5) << " ms, p90 "
+              << percentile(0.9) << " ms, p99 " << percentile(0.99) << " ms, max " << 1000 * seconds.back() << " ms" << std::endl;
+}
+
+// A path has to go from start to goal in steps between 4-adjacent free cells
+static bool valid_path(const occupancy_grid_t* maze, const std::vector<std::pair<int, int> >& path, std::pair<int, int> start, std::pair<int, int> goal)
+{
+    if (path.empty() || path.front() != start || path.back() != goal)
+        return false;
+    for (unsigned k = 0; k < path.size(); ++k)
+    {
+        if (!maze->is_free(path[k].first, path[k].second))
+            return false;
+        if (k > 0 && std::abs(path[k].first - path[k - 1].first) + std::abs(path[k].second - path[k - 1].second) != 1)
+            return false;
+    }
+    return true;
+}
+
+// Breadth-first search from start, independent of the planners, to tell an unreachable goal from a planner that
+// missed a path
+static bool reachable(const occupancy_grid_t* maze, std::pair<int, int> start, std::pair<int, int> goal)
+{
+    int columns = maze->get_columns();
+    std::vector<bool> seen(maze->get_rows() * columns, false);
+    std::vector<int> queue(1, start.first * columns + start.second);
+    seen[queue[0]] = true;
+    int adjacent[4];
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        if (queue[head] == goal.first * columns + goal.second)
+            return true;
+        int count = maze->get_free_neighbors(queue[head], adjacent);
+        for (int k = 0; k < count; ++k)
+        {
+            if (!seen[adjacent[k]])
+            {
+                seen[adjacent[k]] = true;
+                queue.push_back(adjacent[k]);
+            }
+        }
+    }
+    return false;
+}
+
+// The oracle has to give a valid path as short as A*'s wherever A* finds one, and none where A* finds none. Queries
+// go from every one of up to samples free cells to every one of up to 10 free goals; returns the mismatches.
+static int check_oracle(const occupancy_grid_t* maze, int samples)
+{
+    std::vector<std::pair<int, int> > free_cells;
+    for (int i = 0; i < maze->get_rows(); ++i)
+        for (int j = 0; j < maze->get_columns(); ++j)
+            if (maze->is_free(i, j))
+                free_cells.push_back(std::make_pair(i, j));
+    if (free_cells.empty())
+        return 0;
+
+    search_t searcher;
+    searcher.set_grid(maze);
+    distance_oracle_t oracle(maze);
+    std::vector<std::pair<int, int> > goals, starts;
+    for (unsigned k = 0; k < free_cells.size() && goals.size() < 10; k += PRX_MAXIMUM((size_t)1, free_cells.size() / 10))
+    {
+        goals.push_back(free_cells[k]);
+        oracle.add_goal(free_cells[k].first, free_cells[k].second);
+    }
+    for (unsigned k = 0; k < free_cells.size() && (int)starts.size() < samples; k += PRX_MAXIMUM((size_t)1, free_cells.size() / samples))
+        starts.push_back(free_cells[k]);
+
+    int mismatches = 0;
+    for (auto& goal : goals)
+    {
+        for (auto& start : starts)
+        {
+            auto expected = searcher.search(start.first, start.second, goal.first, goal.second);
+            auto path = oracle.path(start.first, start.second, goal.first, goal.second);
+            bool same = expected.empty() ? path.empty() : valid_path(maze, path, start, goal) && path.size() == expected.size();
+            mismatches += !same;
+        }
+    }
+    return mismatches;
+}
+
+// One row or one column of count cells, with a wall at the middle one so half the queries have no path
+static occupancy_grid_t* line_maze(int count, bool column)
+{
+    occupancy_grid_t* line = column ? new occupancy_grid_t(count, 1) : new occupancy_grid_t(1, count);
+    for (int k = 0; k < count; ++k)
+        line->set_free(column ? k : 0, column ? 0 : k, k != count / 2);
+    return line;
+}
+
+// Replays the sense, plan and move legs of util_application_t without ROS. Episode e draws the digit layout of
+// build_environment with seed + e, puts the agent on the cell of the last digit and follows the whole sequence:
+// every leg senses the digit beside the agent, plans to its cell and moves there at once. The truth sensor returns
+// the digit shown; the classifier sensor renders it as an MNIST test image and classifies that, so a wrong reading
+// sends the agent to the wrong cell, like in the node.
+int main(int ac, char* av[])
+{
+    if (ac < 2)
+    {
+        std::cout << "Usage: episode_benchmark <maze file> [episodes] [a_star|jump_point|oracle] [truth|classifier] [seed] [MNIST_data directory] [weights]"
+                  << std::endl;
+        return 1;
+    }
+    std::string file_path = av[1];
+    int episodes = ac > 2 ? atoi(av[2]) : 1000;
+    std::string planner = ac > 3 ? av[3] : "a_star";
+    std::string sensor = ac > 4 ? av[4] : "truth";
+    int seed = ac > 5 ? atoi(av[5]) : 1;
+    if (planner != "a_star" && planner != "jump_point" && planner != "oracle")
+    {
+        std::cout << "Unknown planner " << planner << std::endl;
+        return 1;
+    }
+    if (sensor != "truth" && sensor != "classifier")
+    {
+        std::cout << "Unknown sensor " << sensor << std::endl;
+        return 1;
+    }
+
+    occupancy_grid_t* maze = load_maze(file_path);
+    if (maze == NULL)
+    {
+        std::cout << "Could not read the maze " << file_path << std::endl;
+        return 1;
+    }
+    search_t searcher;
+    searcher.set_grid(maze);
+
+    // One row and one column mazes are where a cell index alone cannot tell a horizontal step from a vertical one
+    std::unique_ptr<occupancy_grid_t> row(line_maze(16, false)), column(line_maze(16, true));
+    int oracle_mismatches = check_oracle(maze, 100) + check_oracle(row.get(), 16) + check_oracle(column.get(), 16);
+    std::cout << "Oracle against A*: " << oracle_mismatches << " mismatches" << std::endl;
+
+    // Every digit is rendered as each of its test images in turn
+    idx_dataset_t renderings;
+    std::vector<size_t> examples[10];
+    unsigned next_example[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    std::vector<float> bitmap;
+    digit_classifier_t classifier;
+    classifier_callback_t classify;
+    std::function<int (int digit)> sense = [](int digit) { return digit; };
+    if (sensor == "classifier")
+    {
+        const char* w = std::getenv("PRACSYS_PATH");
+        std::string data_directory = ac > 6 ? av[6] : std::string(w ? w : ".") + "/prx_core/sensing/MNIST_data";
+        std::string weights = ac > 7 ? av[7] : std::string(w ? w : ".") + "/prx_core/tf_model-8.weights";
+        if (!renderings.open(data_directory, "t10k"))
+        {
+            std::cout << "Could not read the t10k set: " << renderings.get_error() << std::endl;
+            return 1;
+        }
+        for (size_t k = 0; k < renderings.get_count(); ++k)
+            examples[renderings.get_label(k)].push_back(k);
+        classifier.set_layers("dense 10");
+        classifier.load_weights(weights);
+        bitmap.resize(classifier.get_input_size());
+        classify = [&](const float* image) { return classifier.classify(image); };
+        sense = [&](int digit)
+        {
+            renderings.get_inputs(examples[digit][next_example[digit]++ % examples[digit].size()], 1, bitmap.data());
+            return classify(bitmap.data());
+        };
+    }
+
+    std::vector<double> setup_seconds, sense_seconds, plan_seconds;
+    std::vector<int> path_lengths;
+    int legs = 0, correct = 0, lost = 0, unreachable = 0, invalid = 0;
+    digit_layout_t layout;
+    sys_clock_t clock, total_clock;
+    total_clock.reset();
+    for (int e = 0; e < episodes; ++e)
+    {
+        init_random(seed + e);
+        layout.generate(maze);
+        const std::vector<int>& sequence = layout.get_sequence();
+        const std::map<int, std::pair<int, int> >& digit_to_position = layout.get_digit_to_position();
+        if (sequence.size() < 2)
+        {
+            std::cout << file_path << " has " << sequence.size() << " cells for digits, episodes need two" << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<distance_oracle_t> oracle;
+        if (planner == "oracle")
+        {
+            clock.reset();
+            oracle.reset(new distance_oracle_t(maze));
+            for (int digit : sequence)
+                oracle->add_goal(digit_to_position.at(digit).first, digit_to_position.at(digit).second);
+            setup_seconds.push_back(clock.measure());
+        }
+
+        int at_digit = sequence.back();
+        for (unsigned leg = 0; leg < sequence.size(); ++leg)
+        {
+            int shown = layout.get_next_digit(at_digit);
+            clock.reset();
+            int sensed = sense(shown);
+            sense_seconds.push_back(clock.measure());
+            legs++;
+            correct += sensed == shown;
+            // A digit without a cell sends the agent to (0, 0) in the node, count it and start the next episode
+            if (layout.get_next_digit(sensed) < 0)
+            {
+                lost++;
+                break;
+            }
+
+            std::pair<int, int> start = digit_to_position.at(at_digit);
+            std::pair<int, int> goal = digit_to_position.at(sensed);
+            clock.reset();
+            std::vector<std::pair<int, int> > path;
+            if (oracle)
+                path = oracle->path(start.first, start.second, goal.first, goal.second);
+            else
+                path = searcher.search(start.first, start.second, goal.first, goal.second, planner == "jump_point" ? search_t::JUMP_POINT : search_t::A_STAR);
+            plan_seconds.push_back(clock.measure());
+            // A goal walled off from the agent is the maze's doing, not the planner's; the agent cannot go on
+            if (path.empty() && !reachable(maze, start, goal))
+            {
+                unreachable++;
+                break;
+            }
+            if (!valid_path(maze, path, start, goal))
+            {
+                invalid++;
+                break;
+            }
+            path_lengths.push_back(path.size() - 1);
+            at_digit = sensed;
+        }
+    }
+    double elapsed = total_clock.measure();
+
+    std::cout << file_path << ": " << maze->get_rows() << " x " << maze->get_columns() << ", " << episodes << " episodes, " << planner
+              << " planner, " << sensor << " sensor" << std::endl;
+    report_latencies("Oracle setup", setup_seconds);
+    report_latencies("Sense", sense_seconds);
+    report_latencies("Plan ", plan_seconds);
+    if (!path_lengths.empty())
+    {
+        std::sort(path_lengths.begin(), path_lengths.end());
+        double total = 0;
+        for (int length : path_lengths)
+            total += length;
+        std::cout << "Path length: mean " << total / path_lengths.size() << ", p50 " << path_lengths[path_lengths.size() / 2] << ", max "
+                  << path_lengths.back() << " cells" << std::endl;
+    }
+    std::cout << legs << " legs, " << correct << " sensed right, " << lost << " lost, " << unreachable << " unreachable, " << invalid << " invalid paths, in " << elapsed
+              << " s: " << legs / elapsed << " legs/s, " << episodes / elapsed << " episodes/s" << std::endl;
+
+    delete maze;
+    return invalid == 0 && oracle_mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file maze_benchmark.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/applications/maze_loader.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace prx::util;
+
+// The way build_environment used to read the maze: one operator>> per cell
+static occupancy_grid_t* stream_parse(const std::string& file_path)
+{
+    std::ifstream fin(file_path);
+    int rows, columns;
+    fin >> rows >> columns;
+    occupancy_grid_t* grid = new occupancy_grid_t(rows, columns);
+    for (int i = 0; i < rows; ++i)
+    {
+        for (int j = 0; j < columns; ++j)
+        {
+            int cell;
+            fin >> cell;
+            grid->set_free(i, j, cell == 1);
+        }
+    }
+    return grid;
+}
+
+// The way search_t used to read the maze: getline, stringstream and stoi per cell
+static occupancy_grid_t* getline_parse(const std::string& file_path)
+{
+    std::ifstream maze_file(file_path);
+    occupancy_grid_t* grid = NULL;
+    int rows = 0;
+    int i = 0;
+    std::string line;
+    while (getline(maze_file, line))
+    {
+        if (i == 0)
+            rows = stoi(line);
+        else if (i == 1)
+            grid = new occupancy_grid_t(rows, stoi(line));
+        else if (i - 2 < rows)
+        {
+            int x = 0;
+            std::string raw_num;
+            std::stringstream ss(line);
+            while (getline(ss, raw_num, ' ') && x < grid->get_columns())
+            {
+                if (!raw_num.empty())
+                    grid->set_free(i - 2, x++, stoi(raw_num) == 1);
+            }
+        }
+        i++;
+    }
+    return grid;
+}
+
+static bool same_grid(const occupancy_grid_t* a, const occupancy_grid_t* b)
+{
+    if (a->get_rows() != b->get_rows() || a->get_columns() != b->get_columns())
+        return false;
+    for (int i = 0; i < a->get_rows(); ++i)
+        for (int j = 0; j < a->get_columns(); ++j)
+            if (a->is_free(i, j) != b->is_free(i, j))
+                return false;
+    return true;
+}
+
+template <class Loader>
+static void run(const std::string& name, int repetitions, const occupancy_grid_t* reference, Loader load)
+{
+    sys_clock_t clock;
+    double best = 1e30, total = 0;
+    bool matches = true;
+    for (int k = 0; k < repetitions; ++k)
+    {
+        clock.reset();
+        occupancy_grid_t* grid = load();
+        double elapsed = clock.measure();
+        best = PRX_MINIMUM(best, elapsed);
+        total += elapsed;
+        matches = matches && grid != NULL && same_grid(reference, grid);
+        delete grid;
+    }
+    std::cout << name << ": mean " << 1000 * total / repetitions << " ms, best " << 1000 * best << " ms"
+              << (matches ? "" : "  (GRID MISMATCH)") << std::endl;
+}
+
+int main(int ac, char* av[])
+{
+    if (ac < 2)
+    {
+        std::cout << "Usage: maze_benchmark <maze file> [repetitions]" << std::endl;
+        return 1;
+    }
+    std::string file_path = av[1];
+    int repetitions = ac > 2 ? atoi(av[2]) : 10;
+
+    occupancy_grid_t* reference = parse_maze_text(file_path);
+    std::string cache_path = maze_cache_path(file_path);
+    write_maze_cache(*reference, cache_path, file_path);
+    std::cout << file_path << ": " << reference->get_rows() << " x " << reference->get_columns() << ", " << repetitions << " repetitions" << std::endl;
+
+    run("operator>> (build_environment)", repetitions, reference, [&]() { return stream_parse(file_path); });
+    run("getline/stoi (search_t)      ", repetitions, reference, [&]() { return getline_parse(file_path); });
+    run("mmap tokenizer               ", repetitions, reference, [&]() { return parse_maze_text(file_path); });
+    run("mmap binary cache            ", repetitions, reference, [&]() { return load_maze_cache(cache_path, file_path); });
+
+    delete reference;
+    return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file mesh_batch_check.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/applications/digit_layout.hpp"
+#include "prx/utilities/applications/maze_loader.hpp"
+#include "prx/utilities/definitions/random.hpp"
+#include "prx/visualization/PLUGINS/OSG/osg_mesh_batch.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <yaml-cpp/yaml.h>
+
+using namespace prx::util;
+using namespace prx::vis;
+
+// Builds the walls of assignment_2 the way build_environment does and counts the drawables osg_scene_t would
+// produce for them, one mesh per wall against the merged mesh_batch. Fails if a mesh cannot be read or if
+// batching does not reduce the drawables.
+int main(int ac, char* av[])
+{
+    if (ac < 2)
+    {
+        std::cout << "Usage: mesh_batch_check <maze file> [block yaml] [mesh directory] [seed]" << std::endl;
+        return 1;
+    }
+    char* w = std::getenv("PRACSYS_PATH");
+    std::string root_path = w ? w : ".";
+    std::string block_file = ac > 2 ? av[2] : root_path + "/prx_core/launches/block_2.yaml";
+    std::string mesh_directory = ac > 3 ? av[3] : root_path + "/meshes/";
+    int seed = ac > 4 ? atoi(av[4]) : 0;
+    osgDB::setDataFilePathList(mesh_directory);
+
+    occupancy_grid_t* maze = load_maze(av[1], false);
+
+    // The material and local transform every wall copies from the template
+    YAML::Node geometry;
+    try
+    {
+        geometry = YAML::LoadFile(block_file)["geometries"][0]["visualization_geometry"];
+    }
+    catch (const YAML::Exception& e)
+    {
+        std::cout << "Could not read the obstacle template " << block_file << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if (!geometry || geometry["type"].as<std::string>() != "mesh")
+    {
+        std::cout << block_file << " does not draw its walls with a mesh, there is nothing to batch" << std::endl;
+        return 1;
+    }
+    std::string material_name = geometry["material"].as<std::string>();
+    osg::Matrixd local_transform;
+    if (geometry["local_transform"])
+    {
+        std::vector<double> p = geometry["local_transform"]["position"].as<std::vector<double> >();
+        std::vector<double> q = geometry["local_transform"]["orientation"].as<std::vector<double> >();
+        local_transform = osg::Matrixd::rotate(osg::Quat(q[0], q[1], q[2], q[3])) * osg::Matrixd::translate(p[0], p[1], p[2]);
+    }
+
+    // Same meshes as build_environment: the digits of every block, then the blocks left of the digit locations
+    init_random(seed);
+    digit_layout_t layout;
+    layout.generate(maze);
+    std::vector<std::string> meshes;
+    for (const std::tuple<int, int, int>& digits : layout.get_block_digits())
+        meshes.push_back(std::to_string(std::get<0>(digits)) + "_" + std::to_string(std::get<1>(digits)) + "_" + std::to_string(std::get<2>(digits)) + ".obj");
+    const std::vector< std::tuple<int, int, int> >& locations = layout.get_locations();
+    const std::vector<int>& positions = layout.get_sequence();
+    for (unsigned i = 0; i < locations.size() && i < 10; ++i)
+    {
+        int next = (i + 1 < locations.size() && i < 9) ? positions[i + 1] : positions[0];
+        meshes[std::get<2>(locations[i]) - 1] = std::to_string(next) + "_" + std::to_string(positions[i]) + "_" + std::to_string(uniform_int_random(0, 9)) + ".obj";
+    }
+
+    osg_mesh_batch_t batch;
+    osg::ref_ptr<osg::StateSet> state = new osg::StateSet();
+    state->setAttribute(new osg::Material(), osg::StateAttribute::ON);
+    batch.set_material(material_name, state.get());
+
+    unsigned walls = 0, unbatched = 0, unreadable = 0;
+    for (int i = 0; i < maze->get_rows(); ++i)
+    {
+        for (int j = 0; j < maze->get_columns(); ++j)
+        {
+            if (maze->is_free(i, j))
+                continue;
+            const std::string& mesh = meshes[walls++];
+            // pose_from_indices and the height build_environment gives the blocks
+            osg::Matrixd transform = local_transform * osg::Matrixd::translate(j, -i, 0.5);
+            if (!batch.add(mesh, material_name, transform))
+            {
+                unreadable++;
+                continue;
+            }
+            // drawn on its own, every wall is a copy of the mesh under its own transform
+            unbatched += osg_mesh_batch_t::count_drawables(batch.get_mesh(mesh));
+        }
+    }
+    batch.merge();
+    unsigned batched = batch.count_drawables();
+    std::cout << av[1] << ": " << walls << " walls, " << unbatched << " drawables one mesh per wall, " << batched
+              << " merged in " << batch.get_instance_count() << " instances" << std::endl;
+    delete maze;
+
+    if (unreadable > 0)
+    {
+        std::cout << unreadable << " walls have meshes that cannot be read from " << mesh_directory << std::endl;
+        return 1;
+    }
+    if (walls > 1 && batched >= unbatched)
+    {
+        std::cout << "Batching did not reduce the drawables" << std::endl;
+        return 1;
+    }
+    return 0;
+}
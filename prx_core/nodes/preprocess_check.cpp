@@ -0,0 +1,102 @@
+/**
+ * @file preprocess_check.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/applications/frame_preprocessor.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <osg/Image>
+#include <osgDB/ReadFile>
+
+using namespace prx::util;
+
+// The cells where two inputs of the classifier disagree, on opposite sides of 0.5
+static int mismatches(const float* a, const float* b, int size)
+{
+    int count = 0;
+    for (int i = 0; i < size; ++i)
+        count += (a[i] > 0.5f) != (b[i] > 0.5f);
+    return count;
+}
+
+// Compares frame_preprocessor_t with the PIL pipeline of sense_environment.py on stored frames. Record the
+// reference of a frame with
+//   python sensing/sense_environment.py <frame> <frame>.ref
+// and check frames against their references with
+//   preprocess_check <cell budget> <frame> [<frame> ...]
+// for example preprocess_check 0 sensing/reference_frames/*.png. A frame passes if at most the budget of cells
+// differ from its reference. Two controls have to fail on every frame, or the frame could not tell a broken
+// preprocessor from a working one: an output without ink, and the frame shifted right by two cells.
+int main(int ac, char* av[])
+{
+    if (ac < 3)
+    {
+        std::cout << "Usage: preprocess_check <cell budget> <frame> [<frame> ...]" << std::endl;
+        return 1;
+    }
+    int budget = atoi(av[1]);
+    frame_preprocessor_t preprocessor;
+    int size = preprocessor.get_output_width() * preprocessor.get_output_height();
+    std::vector<float> input(size), blank(size, 0.0f), shifted_input(size);
+    std::vector<unsigned char> shifted;
+    int failed = 0;
+
+    for (int a = 2; a < ac; ++a)
+    {
+        osg::ref_ptr<osg::Image> image = osgDB::readImageFile(av[a]);
+        std::ifstream fin((std::string(av[a]) + ".ref").c_str());
+        std::vector<float> reference;
+        float value;
+        while (fin >> value)
+            reference.push_back(value);
+        if (!image.valid() || image->getDataType() != GL_UNSIGNED_BYTE || (int)reference.size() != size)
+        {
+            std::cout << av[a] << ": could not read the frame or its " << size << " reference values" << std::endl;
+            ++failed;
+            continue;
+        }
+
+        int channels = osg::Image::computeNumComponents(image->getPixelFormat());
+        bool bottom_up = image->getOrigin() == osg::Image::BOTTOM_LEFT;
+        size_t row_bytes = image->getRowSizeInBytes();
+        int repetitions = 100;
+        sys_clock_t clock;
+        clock.reset();
+        for (int r = 0; r < repetitions; ++r)
+            preprocessor.process(image->data(), image->s(), image->t(), channels, row_bytes, bottom_up, input.data());
+        double elapsed = clock.measure() / repetitions;
+
+        // the frame moved right by two output cells, white where it moved from
+        int shift = PRX_MINIMUM(image->s(), 2 * image->s() / preprocessor.get_output_width()) * channels;
+        shifted.assign(row_bytes * image->t(), 255);
+        for (int y = 0; y < image->t(); ++y)
+            std::copy(image->data() + y * row_bytes, image->data() + y * row_bytes + image->s() * channels - shift, shifted.begin() + y * row_bytes + shift);
+        preprocessor.process(shifted.data(), image->s(), image->t(), channels, row_bytes, bottom_up, shifted_input.data());
+
+        int differ = mismatches(input.data(), reference.data(), size);
+        int blank_differ = mismatches(blank.data(), reference.data(), size);
+        int shifted_differ = mismatches(shifted_input.data(), reference.data(), size);
+        bool passed = differ <= budget;
+        bool controls_failed = blank_differ > budget && shifted_differ > budget;
+        failed += !passed || !controls_failed;
+        std::cout << av[a] << " (" << image->s() << "x" << image->t() << "x" << channels << "): " << differ << " cells differ, "
+                  << blank_differ << " without ink, " << shifted_differ << " shifted, " << 1e6 * elapsed << " us"
+                  << (passed ? "" : " FAILED") << (controls_failed ? "" : " CONTROLS PASSED") << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file train_classifier.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/applications/digit_trainer.hpp"
+#include "prx/utilities/applications/idx_file.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace prx::util;
+
+// Trains a digit network on the MNIST training set, like tf_train_model_ASSIGNMENT_FILE.py, and writes a tensor
+// archive demo_app loads. The first 5000 training images are held out for validation, as input_data does. The
+// defaults are the model of the script: softmax regression, 500 steps of 100 images at a learning rate of 0.5.
+int main(int ac, char* av[])
+{
+    if (ac < 3)
+    {
+        std::cout << "Usage: train_classifier <MNIST_data directory> <output weights> [description] [steps] [learning rate] [seed] [threads] [set]"
+                  << std::endl;
+        return 1;
+    }
+    std::string data_directory = av[1];
+    std::string output = av[2];
+    std::string description = ac > 3 ? av[3] : "dense 10";
+    int steps = ac > 4 ? atoi(av[4]) : 500;
+    digit_trainer_t::settings_t settings;
+    if (ac > 5)
+        settings.learning_rate = atof(av[5]);
+    if (ac > 6)
+        settings.seed = atoi(av[6]);
+    if (ac > 7)
+        settings.threads = atoi(av[7]);
+    std::string set = ac > 8 ? av[8] : "train";
+
+    idx_dataset_t data, test;
+    if (!data.open(data_directory, set))
+    {
+        std::cout << "Could not read the " << set << " set: " << data.get_error() << std::endl;
+        return 1;
+    }
+    size_t validation = PRX_MINIMUM((size_t)5000, data.get_count() / 10);
+
+    digit_trainer_t trainer;
+    trainer.set_settings(settings);
+    trainer.set_layers(description);
+    trainer.initialize();
+    std::cout << "Training '" << description << "', " << trainer.get_parameter_count() << " parameters, on " << data.get_count() - validation
+              << " " << set << " images with " << trainer.get_thread_count() << " threads" << std::endl;
+
+    sys_clock_t clock;
+    clock.reset();
+    trainer.train(data, validation, data.get_count() - validation, steps);
+    double elapsed = clock.measure();
+    std::cout << steps << " steps in " << elapsed << " s, validation accuracy " << trainer.evaluate(data, 0, validation) << std::endl;
+    if (set != "t10k" && test.open(data_directory, "t10k"))
+        std::cout << "Test accuracy " << trainer.evaluate(test, 0, test.get_count()) << std::endl;
+
+    trainer.save_weights(output);
+    std::cout << "Wrote " << output << " for '" << trainer.get_inference_description() << "'" << std::endl;
+    return 0;
+}
@@ -98,7 +98,12 @@ int main(int ac, char* av[])
 
     
     // ros::Timer sim_timer = main_node_handle.createTimer(ros::Duration(1), &util_application_t::frame, app);
-    ros::Timer comm_timer = main_node_handle.createTimer(ros::Duration(1), &util_application_t::info_broadcasting, app);
+    //The agent steps at waypoint_rate and the visualization is updated at render_rate; a rate of 0 drops its timer
+    ros::Timer waypoint_timer, comm_timer;
+    if(app->get_waypoint_rate() > 0)
+        waypoint_timer = main_node_handle.createTimer(ros::Duration(1/app->get_waypoint_rate()), &util_application_t::waypoint_stepping, app);
+    if(app->get_render_rate() > 0)
+        comm_timer = main_node_handle.createTimer(ros::Duration(1/app->get_render_rate()), &util_application_t::info_broadcasting, app);
     app->execute();
     
 
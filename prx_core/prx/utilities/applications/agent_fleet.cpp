@@ -0,0 +1,102 @@
+#include "prx/utilities/applications/agent_fleet.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+namespace prx
+{
+
+    namespace util
+    {
+        agent_fleet_t::agent_fleet_t(const occupancy_grid_t* maze, const digit_layout_t* layout, unsigned thread_count) : pool(thread_count)
+        {
+            this->maze = maze;
+            this->layout = layout;
+            algorithm = search_t::A_STAR;
+            for (unsigned t = 0; t < pool.get_thread_count(); ++t)
+            {
+                workspaces.push_back(new search_t());
+                workspaces.back()->set_grid(maze);
+            }
+            reset(0);
+        }
+
+        agent_fleet_t::~agent_fleet_t()
+        {
+            for (auto workspace : workspaces)
+                delete workspace;
+        }
+
+        void agent_fleet_t::reset(int count)
+        {
+            const std::vector<int>& sequence = layout->get_sequence();
+            cell_i.assign(count, 0);
+            cell_j.assign(count, 0);
+            goal_digit.assign(count, -1);
+            paths.assign(count, std::vector< std::pair<int, int> >());
+            waypoint.assign(count, 0);
+            for (int agent = 0; agent < count && !sequence.empty(); ++agent)
+            {
+                goal_digit[agent] = sequence[agent % sequence.size()];
+                auto cell = layout->get_digit_to_position().at(goal_digit[agent]);
+                cell_i[agent] = cell.first;
+                cell_j[agent] = cell.second;
+            }
+            arrivals = plans = steps = 0;
+            plan_seconds = 0;
+        }
+
+        void agent_fleet_t::step()
+        {
+            int count = cell_i.size();
+            const std::map<int, std::pair<int, int> >& digit_to_position = layout->get_digit_to_position();
+
+            // an agent at the end of its path reads the next digit there
+            arrived.clear();
+            for (int agent = 0; agent < count; ++agent)
+            {
+                if (goal_digit[agent] >= 0 && waypoint[agent] + 1 >= (int)paths[agent].size())
+                {
+                    arrivals += !paths[agent].empty();
+                    goal_digit[agent] = layout->get_next_digit(goal_digit[agent]);
+                    arrived.push_back(agent);
+                }
+            }
+
+            if (!arrived.empty())
+            {
+                sys_clock_t clock;
+                clock.reset();
+                // one agent per task, so even a few arrivals are spread over every thread, and a long query does
+                // not hold up agents queued behind it in the same task
+                pool.run(arrived.size(), [&](int task, unsigned thread)
+                {
+                    search_t* searcher = workspaces[thread];
+                    int agent = arrived[task];
+                    waypoint[agent] = 0;
+                    if (goal_digit[agent] < 0)
+                    {
+                        paths[agent].clear();
+                        return;
+                    }
+                    auto goal = digit_to_position.at(goal_digit[agent]);
+                    paths[agent] = searcher->search(cell_i[agent], cell_j[agent], goal.first, goal.second, algorithm);
+                    // the goal cannot be reached, leave the agent where it is
+                    if (paths[agent].empty())
+                        goal_digit[agent] = -1;
+                });
+                plans += arrived.size();
+                plan_seconds += clock.measure();
+            }
+
+            for (int agent = 0; agent < count; ++agent)
+            {
+                if (waypoint[agent] + 1 < (int)paths[agent].size())
+                {
+                    const std::pair<int, int>& cell = paths[agent][++waypoint[agent]];
+                    cell_i[agent] = cell.first;
+                    cell_j[agent] = cell.second;
+                    steps++;
+                }
+            }
+        }
+    }
+}
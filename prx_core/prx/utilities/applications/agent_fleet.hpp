@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef PRX_UTIL_AGENT_FLEET_HPP
+#define	PRX_UTIL_AGENT_FLEET_HPP
+
+#include "prx/utilities/applications/digit_layout.hpp"
+#include "prx/utilities/applications/search.hpp"
+#include "prx/utilities/definitions/thread_pool.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        // Many independent agents following the digit sequence of one layout in one shared maze. Agent state is
+        // kept as a structure of arrays indexed by agent. Every tick the agents that reached their goal read the
+        // digit beside them from the layout and are planned for together, on a thread pool where every thread has
+        // a search workspace of its own over the shared, immutable grid; then every agent steps one waypoint.
+        // Agents do not see each other, several may stand on one cell.
+        class agent_fleet_t
+        {
+          public:
+            // thread_count 0 uses one thread per core
+            agent_fleet_t(const occupancy_grid_t* maze, const digit_layout_t* layout, unsigned thread_count = 0);
+            virtual ~agent_fleet_t();
+
+            void set_algorithm(search_t::algorithm_t algorithm) { this->algorithm = algorithm; }
+
+            // puts count agents on the digit cells, agent k on the cell of the k-th digit of the sequence, wrapping
+            void reset(int count);
+
+            // plans for the agents that arrived, then moves every agent one waypoint
+            void step();
+
+            int get_agent_count() const { return cell_i.size(); }
+            unsigned get_thread_count() const { return pool.get_thread_count(); }
+
+            // the cell every agent is on
+            const std::vector<int>& get_cell_i() const { return cell_i; }
+            const std::vector<int>& get_cell_j() const { return cell_j; }
+
+            // the digit every agent is heading to, -1 for an agent with no way there
+            const std::vector<int>& get_goal_digit() const { return goal_digit; }
+
+            // totals since reset: goals reached, paths planned, waypoints stepped, and seconds spent planning
+            long get_arrivals() const { return arrivals; }
+            long get_plans() const { return plans; }
+            long get_steps() const { return steps; }
+            double get_plan_seconds() const { return plan_seconds; }
+
+          protected:
+            const occupancy_grid_t* maze;
+            const digit_layout_t* layout;
+            search_t::algorithm_t algorithm;
+            thread_pool_t pool;
+            std::vector<search_t*> workspaces;
+
+            std::vector<int> cell_i, cell_j;
+            std::vector<int> goal_digit;
+            std::vector< std::vector< std::pair<int, int> > > paths;
+            // index into paths of the cell every agent is on
+            std::vector<int> waypoint;
+
+            // the agents planned for in this tick
+            std::vector<int> arrived;
+
+            long arrivals, plans, steps;
+            double plan_seconds;
+
+          private:
+            agent_fleet_t(const agent_fleet_t&);
+            agent_fleet_t& operator=(const agent_fleet_t&);
+        };
+    }
+}
+
+#endif
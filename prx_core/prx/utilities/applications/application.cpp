@@ -19,7 +19,10 @@
 #include "prx/utilities/communication/tf_broadcaster.hpp"
 
 // #include <boost/range/adaptor/map.hpp> //adaptors
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <sstream>
 #include "prx/utilities/definitions/sys_clock.hpp"
 #include <pluginlib/class_list_macros.h>
 #include "prx_core/send_plants_srv.h"
@@ -29,6 +32,9 @@
 #include "prx/utilities/graph/undirected_node.hpp"
 #include "prx_core/take_screenshot_srv.h"
 
+#include <XmlRpc.h>
+#include <yaml-cpp/yaml.h>
+
 #include <iostream>
 
 PLUGINLIB_EXPORT_CLASS(prx::util::util_application_t, prx::util::util_application_t)
@@ -48,18 +54,84 @@ namespace prx
             start_i = 0;
             start_j = 0;
             searcher = new search_t();
+            search_algorithm = search_t::A_STAR;
+            maze = NULL;
+            goal_oracle = NULL;
+            sensing_top_k = 3;
+            sensing_confidence = 0;
+            sensing_retries = 2;
+            hedge_low_confidence = false;
+            hedging = false;
+            consumed_waypoint = true;
+            pose_changed = true;
+            waypoint_rate = 1;
+            render_rate = 30;
+            start_delay = 5;
+            for(int state = 0; state < 4; ++state)
+            {
+                state_seconds[state] = 0;
+                state_entries[state] = 0;
+            }
+            accounted_seconds = 0;
+            accounted_cpu = 0;
+            pipelined = false;
+            speculated_legs = 0;
+            committed_legs = 0;
+            agent_count = 1;
+            fleet_threads = 0;
+            fleet = NULL;
             init_random(1);
         }
 
         util_application_t::~util_application_t()
         {
+            if(speculation_thread.joinable())
+                speculation_thread.join();
             delete tf_broadcaster;
             delete searcher;
+            delete goal_oracle;
+            delete fleet;
+            delete maze;
         }
 
         void util_application_t::init(const parameter_reader_t * const reader)
         {
 
+            //Set to the visualization's shared_frames to sense frames from shared memory instead of _0.jpg
+            shared_frames = reader->get_attribute_as<std::string>("shared_frames", "");
+
+            start_delay = reader->get_attribute_as<double>("start_delay", 5.0);
+            pipelined = reader->get_attribute_as<bool>("pipelined", false);
+            agent_count = PRX_MAXIMUM(1, reader->get_attribute_as<int>("agent_count", 1));
+            fleet_threads = PRX_MAXIMUM(0, reader->get_attribute_as<int>("fleet_threads", 0));
+            waypoint_rate = PRX_MAXIMUM(0.0, reader->get_attribute_as<double>("waypoint_rate", 1.0));
+            render_rate = PRX_MAXIMUM(0.0, reader->get_attribute_as<double>("render_rate", 30.0));
+            if(waypoint_rate == 0)
+                PRX_PRINT("Stepping along paths as fast as possible", PRX_TEXT_GREEN);
+            if(render_rate == 0)
+                PRX_PRINT("Headless: the visualization is only updated before sensing", PRX_TEXT_GREEN);
+
+            //Sensing below sensing_confidence is retried; low_confidence_policy "top2" then hedges between the two best goals
+            sensing_top_k = PRX_MAXIMUM(1, reader->get_attribute_as<int>("sensing_top_k", 3));
+            sensing_confidence = reader->get_attribute_as<double>("sensing_confidence", 0.0);
+            sensing_retries = PRX_MAXIMUM(0, reader->get_attribute_as<int>("sensing_retries", 2));
+            std::string low_confidence_policy = reader->get_attribute_as<std::string>("low_confidence_policy", "retry");
+            if(low_confidence_policy != "retry" && low_confidence_policy != "top2")
+                PRX_WARN_S("Unknown low_confidence_policy "<<low_confidence_policy<<", using retry");
+            hedge_low_confidence = low_confidence_policy == "top2";
+
+            //"a_star" (default) or "jump_point"; both return the same cell-by-cell waypoints
+            std::string planner = reader->get_attribute_as<std::string>("planner", "a_star");
+            if(planner == "jump_point")
+                search_algorithm = search_t::JUMP_POINT;
+            else if(planner != "a_star")
+                PRX_WARN_S("Unknown planner "<<planner<<", using a_star");
+            PRX_PRINT("Planner: "<<planner, PRX_TEXT_GREEN);
+
+            //The digit positions are fixed by build_environment, so paths to them can be prepared up front
+            if(reader->get_attribute_as<bool>("precompute_goal_paths", false))
+                precompute_goal_paths();
+
             //create the tf broadcaster, which tells the visualization node where all of the geometries are placed in the world
             tf_broadcaster = new tf_broadcaster_t;
             ros::ServiceClient plant_client = node_handle.serviceClient<prx_core::send_plants_srv > ("visualization/plants");
@@ -68,6 +140,21 @@ namespace prx
             plant_wrapper.request.source_node_name = "utilities";
             plant_wrapper.request.paths.push_back("simulator/disk");
             plant_wrapper.request.paths.push_back("simulator/goal");
+            agent_frames.push_back("simulator/disk/ball");
+            if(agent_count > 1)
+            {
+                //Every other agent is a plant of its own, with the geometry of the disk
+                XmlRpc::XmlRpcValue disk;
+                if(!ros::param::get("/utilities/simulator/subsystems/disk", disk))
+                    PRX_FATAL_S("agent_count needs the disk plant to copy for every agent");
+                for(int agent = 1; agent < agent_count; ++agent)
+                {
+                    std::string name = "agent_"+std::to_string(agent);
+                    ros::param::set("/utilities/simulator/subsystems/"+name, disk);
+                    plant_wrapper.request.paths.push_back("simulator/"+name);
+                    agent_frames.push_back("simulator/"+name+"/ball");
+                }
+            }
             plant_client.waitForExistence(ros::Duration(5));
             if( !plant_client.call(plant_wrapper) )
             {
@@ -106,6 +193,21 @@ namespace prx
                 PRX_FATAL_S("Service request to send obstacles failed.");
             }
 
+            if(agent_count > 1)
+            {
+                fleet = new agent_fleet_t(maze, &layout, fleet_threads);
+                fleet->set_algorithm(search_algorithm);
+                fleet->reset(agent_count);
+                agent_x.resize(agent_count);
+                agent_y.resize(agent_count);
+                for(int agent = 0; agent < agent_count; ++agent)
+                {
+                    auto pose = pose_from_indices(fleet->get_cell_i()[agent], fleet->get_cell_j()[agent]);
+                    agent_x[agent] = pose.first;
+                    agent_y[agent] = pose.second;
+                }
+                PRX_PRINT("Running "<<agent_count<<" agents on "<<fleet->get_thread_count()<<" threads", PRX_TEXT_GREEN);
+            }
         }
 
         std::pair<int, int> util_application_t::pose_from_indices(int i, int j)
@@ -118,6 +220,46 @@ namespace prx
             return std::make_pair(-y, x);
         }
 
+        //Converts a parsed yaml document into the XmlRpc form used by the parameter server, the same way rosparam load does
+        static XmlRpc::XmlRpcValue yaml_to_xmlrpc(const YAML::Node& node)
+        {
+            XmlRpc::XmlRpcValue value;
+            if(node.IsMap())
+            {
+                for(YAML::const_iterator it = node.begin(); it != node.end(); ++it)
+                    value[it->first.as<std::string>()] = yaml_to_xmlrpc(it->second);
+            }
+            else if(node.IsSequence())
+            {
+                value.setSize(node.size());
+                for(std::size_t k = 0; k < node.size(); ++k)
+                    value[(int)k] = yaml_to_xmlrpc(node[k]);
+            }
+            else if(node.IsScalar())
+            {
+                int int_value;
+                double double_value;
+                bool bool_value;
+                if(YAML::convert<int>::decode(node, int_value))
+                    value = int_value;
+                else if(YAML::convert<double>::decode(node, double_value))
+                    value = double_value;
+                else if(YAML::convert<bool>::decode(node, bool_value))
+                    value = bool_value;
+                else
+                    value = node.as<std::string>();
+            }
+            return value;
+        }
+
+        //Replaces the visualization mesh of an obstacle, if its first geometry has one
+        static void set_obstacle_mesh(XmlRpc::XmlRpcValue& obstacle, const std::string& mesh)
+        {
+            XmlRpc::XmlRpcValue& geometry = obstacle["geometries"][0];
+            if(geometry.hasMember("visualization_geometry"))
+                geometry["visualization_geometry"]["filename"] = mesh;
+        }
+
         void util_application_t::build_environment(std::string filename, std::string block_filename)
         {
             char* w = std::getenv("PRACSYS_PATH");
@@ -127,88 +269,84 @@ namespace prx
 
             environment_file = filename;
             PRX_INFO_S("File directory is: " << filename);
-            std::ifstream fin;
-
-            std::string script_file(w);
-            script_file += "/prx_core/prx/utilities/applications/create_environment.py"; 
-            std::vector< std::tuple<int,int,int> > locations;
 
+            //Parsed and validated once, then shared read-only with the planner
+            maze = load_maze(filename);
+            r = maze->get_rows();
+            c = maze->get_columns();
+            PRX_PRINT("The read attributes: "<<r<<" "<<c<<" ", PRX_TEXT_MAGENTA);
+            searcher->set_grid(maze);
 
+            //Every block is a copy of the template, collected here and sent to the parameter server in one write
+            XmlRpc::XmlRpcValue block_template;
             try
             {
-                fin.open(filename);
-                if(!fin.good())
-                {
-                    PRX_FATAL_S("Error in trying to read file "<<filename);
-                }
-                PRX_PRINT("Opened file..", PRX_TEXT_MAGENTA);
-
-                fin >> r;
-                fin >> c;
-                PRX_PRINT("The read attributes: "<<r<<" "<<c<<" ", PRX_TEXT_MAGENTA);
+                block_template = yaml_to_xmlrpc(YAML::LoadFile(block_file));
+            }
+            catch(const YAML::Exception& e)
+            {
+                PRX_FATAL_S("Could not read the obstacle template "<<block_file<<": "<<e.what());
+            }
+            XmlRpc::XmlRpcValue obstacles;
+            if(!ros::param::get("/utilities/obstacles", obstacles) || obstacles.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+                obstacles = XmlRpc::XmlRpcValue();
 
-                maze.resize(r);
-                int num_obs = 1;
-                int total_cells = r*c;
-                int progress = 0;
+            //The meshes and the digit cells are drawn up front, the same way a headless episode_benchmark run does
+            layout.generate(maze);
+            int num_obs = 1;
 
-                for(int i=0; i<r; ++i)
+            for(int i=0; i<r; ++i)
+            {
+                for(int j=0; j<c; ++j)
                 {
-                    maze[i].resize(c,-1);
-                    for(int j=0; j<c; ++j, ++progress)
+                    if(!maze->is_free(i,j))
                     {
-                        // PRX_PRINT("Reading index: "<<i<<", "<<j<<" to "<<maze[i][j], PRX_TEXT_MAGENTA);
-                        fin >> maze[i][j];
-                        // std::cout<<maze[i][j]<<" ";
-                        if(maze[i][j] == 0)
-                        {
-                            auto pose = pose_from_indices(i,j);
-                            std::vector<double> obs_pos = {(double)pose.first, (double)pose.second, 0.5};
-                            std::string command = "rosparam load "+block_file+" /utilities/obstacles/block_"+std::to_string(num_obs);
-                            auto ret = std::system(command.c_str());
-                            
-                            
+                        auto pose = pose_from_indices(i,j);
+                        XmlRpc::XmlRpcValue& block = obstacles["block_"+std::to_string(num_obs)];
+                        block = block_template;
 
-                            ros::param::set("/utilities/obstacles/block_"+std::to_string(num_obs)+"/root_configuration/position", obs_pos);
-                            // ros::param::set("/utilities/obstacles/block_"+std::to_string(num_obs)+"/collision_geometry/filename", std::to_string(uniform_int_random(0,9)) + "_" + std::to_string(uniform_int_random(0,9)) + ".png" ); 
+                        XmlRpc::XmlRpcValue& position = block["root_configuration"]["position"];
+                        position.setSize(3);
+                        position[0] = (double)pose.first;
+                        position[1] = (double)pose.second;
+                        position[2] = 0.5;
 
+                        auto& digits = layout.get_block_digits()[num_obs-1];
+                        set_obstacle_mesh(block, std::to_string(std::get<0>(digits))+"_"+std::to_string(std::get<1>(digits))+"_"+std::to_string(std::get<2>(digits))+".obj");
 
-                            std::string script_command = "python "+script_file+" "+std::to_string(num_obs)+" "+std::to_string(uniform_int_random(0,9)) + "_" + std::to_string(uniform_int_random(0,9))+ "_" + std::to_string(uniform_int_random(0,9)) + ".obj";
-                            auto script_ret = std::system(script_command.c_str());
-
-
-                            if (j!=0 && maze[i][j-1]==1)
-                                locations.push_back(std::make_tuple(i,j-1,num_obs));
-
-                            num_obs++;
-                        }
-                        PRX_STATUS("Constructing environment: "<<progress*100/(double)total_cells<<"%       ", PRX_TEXT_LIGHTGRAY);
+                        num_obs++;
                     }
-                    // std::cout<<"\n";
                 }
-
-            }
-            catch(...)
-            {
-                PRX_FATAL_S("Could not parse file.");
+                PRX_STATUS("Constructing environment: "<<(i+1)*100/(double)r<<"%       ", PRX_TEXT_LIGHTGRAY);
             }
 
 
 
 
-            std::vector<int> positions = {0,1,2,3,4,5,6,7,8,9};
-            std::random_shuffle ( positions.begin(), positions.end() );
-            std::random_shuffle ( locations.begin(), locations.end() );
-            if(locations.size()>10)
-                locations.resize(10);
+            std::vector< std::tuple<int,int,int> > locations = layout.get_locations();
+            std::vector<int> positions = layout.get_sequence();
+            digit_to_position = layout.get_digit_to_position();
 
-            
-            for(auto p:positions){digit_to_position[p] = std::make_pair(0,0);}for(int i = 0; i<locations.size(); ++i){digit_to_position[positions[i]] = std::make_pair(std::get<0>(locations[i]),std::get<1>(locations[i]));//PRX_PRINT("The digit: "<<positions[i]<<" mapped to "<<std::get<0>(locations[i])<<", "<<std::get<1>(locations[i]), PRX_TEXT_BROWN);
-            }int i;for(i = 0; i < locations.size()-1 && i < 9; ++i) {   auto location = locations[i]; auto next_location = locations[i+1];int this_index = positions[i];int next_index = positions[i+1];
-            std::string script_command = "python "+script_file+" "+std::to_string(std::get<2>(location))+" "+std::to_string(next_index) + "_" + std::to_string(this_index)+ "_" + std::to_string(uniform_int_random(0,9)) + ".obj";
-            auto script_ret = std::system(script_command.c_str()); } std::string script_command = "python "+script_file+" "+std::to_string(std::get<2>(locations[i]))+" "+std::to_string(positions[0]) + "_" + std::to_string(positions[i])+ "_" + std::to_string(uniform_int_random(0,9)) + ".obj"; auto script_ret = std::system(script_command.c_str());
+            //The block left of each digit location shows its own digit and the next one in the sequence, the last wraps around to the first
+            if(!locations.empty())
+            {
+                int i;
+                for(i = 0; i < (int)locations.size()-1 && i < 9; ++i)
+                {
+                    std::string mesh = std::to_string(positions[i+1]) + "_" + std::to_string(positions[i]) + "_" + std::to_string(uniform_int_random(0,9)) + ".obj";
+                    set_obstacle_mesh(obstacles["block_"+std::to_string(std::get<2>(locations[i]))], mesh);
+                }
+                std::string mesh = std::to_string(positions[0]) + "_" + std::to_string(positions[i]) + "_" + std::to_string(uniform_int_random(0,9)) + ".obj";
+                set_obstacle_mesh(obstacles["block_"+std::to_string(std::get<2>(locations[i]))], mesh);
+            }
+            //Keeps the random numbers drawn after this the same as before the layout was split out
+            positions.resize(10);
             std::random_shuffle ( positions.begin(), positions.end() );
             std::random_shuffle ( locations.begin(), locations.end() );
+
+            if(obstacles.getType() == XmlRpc::XmlRpcValue::TypeStruct)
+                ros::param::set("/utilities/obstacles", obstacles);
+            PRX_PRINT("Submitted "<<num_obs-1<<" obstacles", PRX_TEXT_MAGENTA);
             
 
             PRX_PRINT("Printing the read maze:", PRX_TEXT_MAGENTA);
@@ -218,26 +356,42 @@ namespace prx
                 std::cout<<"\n";
                 for(int j=0; j<c; ++j)
                 {
-                    std::cout<<maze[i][j]<<" ";
-                    if(! (maze[i][j]==0 || maze[i][j]==1) )
-                    {
-                        PRX_FATAL_S("Malformed maze. Cells can either be 0 or 1.");
-                    }
+                    std::cout<<maze->is_free(i,j)<<" ";
                 }
             }
             std::cout<<"\n-----------------------------\n";
         }
 
+        void util_application_t::precompute_goal_paths()
+        {
+            sys_clock_t clock;
+            clock.reset();
+
+            delete goal_oracle;
+            goal_oracle = new distance_oracle_t(maze);
+            for(auto& digit_position : digit_to_position)
+                goal_oracle->add_goal(digit_position.second.first, digit_position.second.second);
+
+            PRX_PRINT("Precomputed goal paths in "<<clock.measure()<<"s using "<<goal_oracle->get_memory_bytes()<<" bytes", PRX_TEXT_GREEN);
+        }
+
         void util_application_t::update_visualization()
         {
             PRX_ASSERT(tf_broadcaster != NULL);
             
             //update visualization about where the robot is
-            robot_configuration.set_position(_x,_y,_z);
-            robot_configuration.set_orientation(_qx,_qy,_qz,_qw);
+            if(fleet != NULL)
+            {
+                tf_broadcaster->queue_positions(agent_frames, agent_x.data(), agent_y.data(), _z, tf::Quaternion(_qx,_qy,_qz,_qw));
+            }
+            else
+            {
+                robot_configuration.set_position(_x,_y,_z);
+                robot_configuration.set_orientation(_qx,_qy,_qz,_qw);
+                tf_broadcaster->queue_config(robot_configuration, "simulator/disk/ball");
+            }
             goal_configuration.set_position(current_goal_x,current_goal_y,_z);
             goal_configuration.set_orientation(_qx,_qy,_qz,_qw);
-            tf_broadcaster->queue_config(robot_configuration, "simulator/disk/ball");
             tf_broadcaster->queue_config(goal_configuration, "simulator/goal/ball");
 
             
@@ -245,10 +399,111 @@ namespace prx
             tf_broadcaster->broadcast_configs();
         }
 
+        void util_application_t::flush_visualization()
+        {
+            if(pose_changed)
+            {
+                update_visualization();
+                pose_changed = false;
+            }
+        }
+
         void util_application_t::info_broadcasting(const ros::TimerEvent& event)
         {
-            update_visualization();
-            consumed_waypoint = true;
+            std::lock_guard<std::mutex> lock(event_mutex);
+            flush_visualization();
+        }
+
+        void util_application_t::waypoint_stepping(const ros::TimerEvent& event)
+        {
+            {
+                std::lock_guard<std::mutex> lock(event_mutex);
+                consumed_waypoint = true;
+            }
+            this->event.notify_all();
+        }
+
+        bool util_application_t::wait_for_event(const std::function<bool ()>& done, double timeout)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+            std::unique_lock<std::mutex> lock(event_mutex);
+            //Short slices, so a shutdown is noticed without a callback to wake the wait
+            while(!done() && ros::ok())
+            {
+                auto slice = std::min(deadline, std::chrono::steady_clock::time_point(std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+                if(event.wait_until(lock, slice) == std::cv_status::timeout && std::chrono::steady_clock::now() >= deadline)
+                    break;
+            }
+            return done();
+        }
+
+        void util_application_t::account_state(STATE state, double seconds)
+        {
+            state_seconds[state] += seconds;
+            accounted_seconds += seconds;
+        }
+
+        void util_application_t::report_state_times()
+        {
+            const char* names[4] = {"START", "SENSE", "PLAN", "MOVE"};
+            std::stringstream report;
+            for(int state = 0; state < 4; ++state)
+            {
+                report<<"\n  "<<names[state]<<": "<<state_seconds[state]<<"s in "<<state_entries[state]<<" visits";
+                if(accounted_seconds > 0)
+                    report<<", "<<100 * state_seconds[state] / accounted_seconds<<"%";
+            }
+            double cpu = (std::clock() - accounted_cpu) / (double)CLOCKS_PER_SEC;
+            if(pipelined)
+                report<<"\n  Pipelined: "<<committed_legs<<" of "<<speculated_legs<<" speculated legs committed";
+            report<<"\n  CPU: "<<cpu<<"s, "<<(accounted_seconds > 0 ? 100 * cpu / accounted_seconds : 0)<<"% of one core";
+            PRX_PRINT("Time per state over "<<accounted_seconds<<"s:"<<report.str(), PRX_TEXT_CYAN);
+        }
+
+        void util_application_t::start_speculation()
+        {
+            speculation.valid = false;
+            if(current_path.empty())
+                return;
+            speculation.i = current_path.back().first;
+            speculation.j = current_path.back().second;
+            speculation_thread = std::thread([this]()
+            {
+                //Without an earlier sensing in that cell there is nothing to speculate with
+                auto known = sensed_at.find(std::make_pair(speculation.i, speculation.j));
+                if(known == sensed_at.end())
+                    return;
+                speculated_legs++;
+                speculation.sensed = known->second;
+                const sensed_goal_t& goal = speculation.sensed.candidates[0];
+                speculation.path = plan(speculation.i, speculation.j, goal.i, goal.j);
+                speculation.valid = true;
+            });
+        }
+
+        bool util_application_t::commit_speculation()
+        {
+            if(!speculation_thread.joinable())
+                return false;
+            speculation_thread.join();
+            auto here = indices_from_pose(_x,_y);
+            if(!speculation.valid || here.first != speculation.i || here.second != speculation.j)
+                return false;
+
+            sensed = speculation.sensed;
+            current_goal_i = sensed.candidates[0].i;
+            current_goal_j = sensed.candidates[0].j;
+            current_path.swap(speculation.path);
+            path_counter = 0;
+            hedging = false;
+            committed_legs++;
+            PRX_PRINT("Committed the speculative leg to digit "<<sensed.candidates[0].digit<<" at ["<<current_goal_i<<", "<<current_goal_j<<"], "<<current_path.size()<<" waypoints", PRX_TEXT_GREEN);
+            auto xy_goal = pose_from_indices(current_goal_i, current_goal_j);
+            std::lock_guard<std::mutex> lock(event_mutex);
+            current_goal_x = xy_goal.first;
+            current_goal_y = xy_goal.second;
+            pose_changed = true;
+            return true;
         }
 
         pluginlib::ClassLoader<util_application_t>& util_application_t::get_loader()
@@ -257,40 +512,117 @@ namespace prx
         }
 
 
+        void util_application_t::execute_fleet()
+        {
+            ros::AsyncSpinner spinner(1);
+            spinner.start();
+            sys_clock_t clock, report_clock;
+            clock.reset();
+            report_clock.reset();
+            std::clock_t cpu = std::clock();
+            long ticks = 0;
+            auto report = [&]()
+            {
+                double seconds = clock.measure();
+                double plans = PRX_MAXIMUM(1L, fleet->get_plans());
+                PRX_PRINT(ticks<<" ticks in "<<seconds<<"s: "<<fleet->get_steps() / seconds<<" agent steps/s, "<<fleet->get_arrivals()<<" goals reached, "
+                          <<fleet->get_plans()<<" paths at "<<1000 * fleet->get_plan_seconds() / plans<<" ms per "<<fleet->get_thread_count()<<" threads, CPU "
+                          <<100 * (std::clock() - cpu) / (double)CLOCKS_PER_SEC / seconds<<"%", PRX_TEXT_CYAN);
+            };
+            while(ros::ok())
+            {
+                //All agents step together, at waypoint_rate or as fast as they can be planned for
+                if(waypoint_rate > 0 && !wait_for_event([this]() { return consumed_waypoint; }, 1))
+                    continue;
+                fleet->step();
+                ticks++;
+                {
+                    std::lock_guard<std::mutex> lock(event_mutex);
+                    for(int agent = 0; agent < agent_count; ++agent)
+                    {
+                        auto pose = pose_from_indices(fleet->get_cell_i()[agent], fleet->get_cell_j()[agent]);
+                        agent_x[agent] = pose.first;
+                        agent_y[agent] = pose.second;
+                    }
+                    //The goal marker follows agent 0
+                    _x = agent_x[0];
+                    _y = agent_y[0];
+                    int digit = fleet->get_goal_digit()[0];
+                    if(digit >= 0)
+                    {
+                        auto xy_goal = pose_from_indices(digit_to_position[digit].first, digit_to_position[digit].second);
+                        current_goal_x = xy_goal.first;
+                        current_goal_y = xy_goal.second;
+                    }
+                    consumed_waypoint = false;
+                    pose_changed = true;
+                }
+                if(report_clock.measure() > 10)
+                {
+                    report();
+                    report_clock.reset();
+                }
+            }
+            spinner.stop();
+            report();
+        }
+
         void util_application_t::execute()
         {
+            if(fleet != NULL)
+            {
+                execute_fleet();
+                return;
+            }
+
+            //The timer callbacks get a thread of their own, the automaton sleeps until they wake it
+            ros::AsyncSpinner spinner(1);
+            spinner.start();
+            accounted_cpu = std::clock();
+            sys_clock_t state_clock;
+            state_clock.reset();
+            state_entries[agent_state]++;
             while(ros::ok())
             {
+                STATE running = agent_state;
                 if(agent_state == START)
                 {
                     PRX_PRINT("Current state is START", PRX_TEXT_BROWN);
-                    sleep(5);
+                    wait_for_event([]() { return false; }, start_delay);
                     agent_state = SENSE;
                 }
                 else if(agent_state == SENSE)
                 {
-                    ros::ServiceClient screenshot_client = node_handle.serviceClient<prx_core::take_screenshot_srv > ("visualization/take_screenshot");
-                    prx_core::take_screenshot_srv screenshot_wrapper;
-                    screenshot_wrapper.request.screen_num = 1;
-                    screenshot_wrapper.request.number_of_screenshots = 1;
-                    screenshot_client.waitForExistence(ros::Duration(5));
-                    if( !screenshot_client.call(screenshot_wrapper) )
+                    PRX_PRINT("Current state is SENSE", PRX_TEXT_BROWN);
+                    sensing_result_t result = capture_and_sense();
+                    for(int retry = 0; retry < sensing_retries && (!result.is_valid() || result.get_confidence() < sensing_confidence); ++retry)
                     {
-                        PRX_FATAL_S("Service request to send obstacles failed.");
+                        PRX_WARN_S("Sensing "<<(result.is_valid() ? "confidence "+std::to_string(result.get_confidence())+" is too low" : "failed")<<", sensing again");
+                        result = capture_and_sense();
+                    }
+                    if(!result.is_valid())
+                    {
+                        //Better to stay than to walk to a goal that was never read
+                        PRX_WARN_S("Sensing failed "<<sensing_retries + 1<<" times, starting over");
+                        agent_state = START;
+                    }
+                    else
+                    {
+                        sensed = result;
+                        if(pipelined && result.get_confidence() >= sensing_confidence)
+                            sensed_at[indices_from_pose(_x,_y)] = result;
+                        for(auto& candidate : sensed.candidates)
+                            PRX_PRINT("Candidate digit "<<candidate.digit<<" with probability "<<candidate.probability<<" at ["<<candidate.i<<", "<<candidate.j<<"]", PRX_TEXT_LIGHTGRAY);
+                        current_goal_i = sensed.candidates[0].i;
+                        current_goal_j = sensed.candidates[0].j;
+                        agent_state = PLAN;
+                        PRX_PRINT("Sensed: ["<<current_goal_i<<", "<<current_goal_j<<"]", PRX_TEXT_GREEN);
+                        auto xy_goal = pose_from_indices(current_goal_i, current_goal_j);
+                        std::lock_guard<std::mutex> lock(event_mutex);
+                        current_goal_x = xy_goal.first;
+                        current_goal_y = xy_goal.second;
+                        pose_changed = true;
                     }
-                    char* w = std::getenv("PRACSYS_PATH");
-                    std::string sensing_image(w);
-                    sensing_image += ("/prx_output/images/_0.jpg");
-
-                    PRX_PRINT("Current state is SENSE", PRX_TEXT_BROWN);
-                    auto goal = sense(sensing_image);
-                    current_goal_i = goal.first;
-                    current_goal_j = goal.second;
-                    agent_state = PLAN;
-                    PRX_PRINT("Sensed: ["<<current_goal_i<<", "<<current_goal_j<<"]", PRX_TEXT_GREEN);
-                    auto xy_goal = pose_from_indices(current_goal_i, current_goal_j);
-                    current_goal_x = xy_goal.first;
-                    current_goal_y = xy_goal.second;
                 }
                 else if(agent_state == PLAN)
                 {
@@ -298,46 +630,84 @@ namespace prx
                     auto plan_initial = indices_from_pose(_x,_y);
                     PRX_PRINT("Planning from ["<<plan_initial.first<<","<<plan_initial.second<<"] -> ["<<current_goal_i<<","<<current_goal_j<<"]", PRX_TEXT_CYAN);
                     current_path = plan(plan_initial.first, plan_initial.second, current_goal_i, current_goal_j);
+                    hedging = false;
+                    if(hedge_low_confidence && sensed.get_confidence() < sensing_confidence && sensed.candidates.size() > 1)
+                    {
+                        //Unsure between two goals: only walk the way both paths go, then look again
+                        const sensed_goal_t& second = sensed.candidates[1];
+                        auto second_path = plan(plan_initial.first, plan_initial.second, second.i, second.j);
+                        unsigned shared = 0;
+                        while(shared < current_path.size() && shared < second_path.size() && current_path[shared] == second_path[shared])
+                            ++shared;
+                        //A shared prefix of only the start cell means the paths split here, so commit to the best goal
+                        if(shared > 1 && shared < current_path.size())
+                        {
+                            PRX_PRINT("Moving "<<shared<<" cells towards both digit "<<sensed.candidates[0].digit<<" and digit "<<second.digit<<" before sensing again", PRX_TEXT_CYAN);
+                            current_path.resize(shared);
+                            hedging = true;
+                        }
+                    }
                     PRX_PRINT("Path: ", PRX_TEXT_LIGHTGRAY);
                     for(auto p: current_path)
                         std::cout<<"["<<p.first<<","<<p.second<<"]->";
                     std::cout<<"[end]\n";
-                    consumed_waypoint = true;
+                    PRX_PRINT("Search workspace high-water mark: "<<searcher->get_memory_high_water_mark()<<" bytes", PRX_TEXT_LIGHTGRAY);
+                    {
+                        std::lock_guard<std::mutex> lock(event_mutex);
+                        consumed_waypoint = true;
+                    }
                     path_counter = 0;
                     agent_state = MOVE;
+                    if(pipelined)
+                        start_speculation();
                 }
                 else if(agent_state == MOVE)
                 {
-                    if(consumed_waypoint)
+                    //Sleeps until waypoint_stepping lets the agent take its next step
+                    if(waypoint_rate == 0 || wait_for_event([this]() { return consumed_waypoint; }, 1))
                     {
                         PRX_STATUS("Current state is MOVE: ["<<indices_from_pose(_x,_y).first<<", "<<indices_from_pose(_x,_y).second<<"]                ", PRX_TEXT_BROWN);
                         if(path_counter < current_path.size())
                         {
                             move();
-                            agent_state = MOVE;
+                        }
+                        else if(pipelined && commit_speculation())
+                        {
+                            //The next leg was sensed and planned during this one, keep moving
+                            start_speculation();
                         }
                         else
                         {
-                            agent_state = START;
+                            //A hedged path ends where the candidate paths split, sense again there
+                            agent_state = hedging ? SENSE : START;
                         }
                     }
-                    else
-                    {
-                        agent_state = MOVE;
-                    }
                 }
-                ros::spinOnce();
+
+                account_state(running, state_clock.measure_reset());
+                if(agent_state != running)
+                {
+                    state_entries[agent_state]++;
+                    if(running == MOVE && agent_state == START)
+                        report_state_times();
+                }
             }
+            if(speculation_thread.joinable())
+                speculation_thread.join();
+            spinner.stop();
+            report_state_times();
         }
 
 
         void util_application_t::move()
         {
             auto current_coordinate = pose_from_indices(current_path[path_counter].first, current_path[path_counter].second);
+            std::lock_guard<std::mutex> lock(event_mutex);
             _x = current_coordinate.first;
             _y = current_coordinate.second;
             path_counter++;
             consumed_waypoint = false;
+            pose_changed = true;
         }
 
 
@@ -346,20 +716,97 @@ namespace prx
 
 
 
-        std::pair<int, int> util_application_t::sense(std::string sensing_image)
+        sensing_result_t util_application_t::capture_and_sense()
+        {
+            //Without a render timer, or between two of its ticks, the view may not show the agent where it is yet
+            {
+                std::lock_guard<std::mutex> lock(event_mutex);
+                flush_visualization();
+            }
+
+            //Frames already in the ring were rendered before the robot finished moving
+            if(!shared_frames.empty() && !frame_ring.is_open())
+                frame_ring.open(shared_frames);
+            uint64_t last_frame = frame_ring.get_latest_sequence();
+
+            ros::ServiceClient screenshot_client = node_handle.serviceClient<prx_core::take_screenshot_srv > ("visualization/take_screenshot");
+            prx_core::take_screenshot_srv screenshot_wrapper;
+            screenshot_wrapper.request.screen_num = 1;
+            screenshot_wrapper.request.number_of_screenshots = 1;
+            screenshot_client.waitForExistence(ros::Duration(5));
+            if( !screenshot_client.call(screenshot_wrapper) )
+            {
+                PRX_FATAL_S("Service request to send obstacles failed.");
+            }
+
+            sensing_result_t result;
+            if(!shared_frames.empty())
+            {
+                shared_frame_t frame;
+                if(!wait_for_sensing_frame(last_frame, frame))
+                    PRX_FATAL_S("No frame after "<<last_frame<<" in the shared frame ring "<<shared_frames);
+                result = sense(frame);
+                //The slot was reused while it was classified, sense the newest frame again
+                for(int retry = 0; retry < 3 && !frame_ring.is_valid(frame) && frame_ring.read_latest(frame); ++retry)
+                    result = sense(frame);
+                PRX_PRINT("Sensed frame "<<frame.sequence, PRX_TEXT_LIGHTGRAY);
+            }
+            else
+            {
+                char* w = std::getenv("PRACSYS_PATH");
+                std::string sensing_image(w);
+                sensing_image += ("/prx_output/images/_0.jpg");
+                result = sense(sensing_image);
+            }
+            return result;
+        }
+
+        sensing_result_t util_application_t::rank_digits(const float* probabilities)
+        {
+            sensing_result_t result;
+            int digits[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+            int count = PRX_MINIMUM(sensing_top_k, 10);
+            std::partial_sort(digits, digits + count, digits + 10, [probabilities](int a, int b) { return probabilities[a] > probabilities[b]; });
+            for(int k = 0; k < count; ++k)
+            {
+                auto position = digit_to_position[digits[k]];
+                result.candidates.push_back({digits[k], probabilities[digits[k]], position.first, position.second});
+            }
+            return result;
+        }
+
+        sensing_result_t util_application_t::sense(std::string sensing_image)
         {
             // Currently reports a random collision free state as a goal
+            sensing_result_t result;
             while(true)
             {
                 int i = uniform_int_random(0,r-1);
                 int j = uniform_int_random(0,c-1);
-                if(maze[i][j] == 1)
+                if(maze->is_free(i,j))
                 {
-                    return std::make_pair(i,j);
+                    result.candidates.push_back({-1, 1.0, i, j});
+                    return result;
                 }
             }
         }
 
+        sensing_result_t util_application_t::sense(const shared_frame_t& frame)
+        {
+            return sense(std::string());
+        }
+
+        bool util_application_t::wait_for_sensing_frame(uint64_t after, shared_frame_t& frame)
+        {
+            //The visualization may have created the ring after this node started
+            for(int attempt = 0; !frame_ring.is_open() && attempt < 50; ++attempt)
+            {
+                usleep(100000);
+                frame_ring.open(shared_frames);
+            }
+            return frame_ring.is_open() && frame_ring.wait_for_frame(after, 5, frame);
+        }
+
         std::vector< std::pair<int, int> > util_application_t::plan(int initial_i, int initial_j, int goal_i, int goal_j )
         {
             //Input: initial coordinates in maze 2D array: (initial_i, initial_j)
@@ -381,11 +828,19 @@ namespace prx
             // for(int j=initial_j-1; j>=goal_j; --j)                                    //################
             //     path.push_back(std::make_pair(goal_i,j));                             //################ 
             //If using C++, you can choose to populate the following function in search.cpp 
-            path = searcher->search(environment_file, initial_i, initial_j, goal_i, goal_j);           
+            if(goal_oracle != NULL && goal_oracle->has_goal(goal_i, goal_j))
+            {
+                path = goal_oracle->path(initial_i, initial_j, goal_i, goal_j);
+            }
+            else
+            {
+                path = searcher->search(initial_i, initial_j, goal_i, goal_j, search_algorithm);
+                PRX_PRINT("Expanded "<<searcher->get_expansions()<<" nodes", PRX_TEXT_LIGHTGRAY);
+            }
             //################THE PRECEDING CODE SHOULD BE REPLACED BY YOUR SOLUTION####################
 
             //You can invoke your code using an std::system call, or write your code in C++ and include it here, or invoke your code through ROS
-            //Global variable environment_file has the path to the maze file
+            //Global variable environment_file has the path to the maze file, already loaded into maze
             //###############################################################
             //###############################################################
             //###############################################################
@@ -18,20 +18,46 @@
 #include "prx/utilities/definitions/defs.hpp"
 #include "prx/utilities/definitions/sys_clock.hpp"
 #include "prx/utilities/communication/tf_broadcaster.hpp"
+#include "prx/utilities/communication/shared_frame_ring.hpp"
 #include <pluginlib/class_loader.h>
 #include "prx/utilities/math/config.hpp"
 #include "prx/utilities/spaces/space.hpp"
 #include "prx/utilities/graph/undirected_graph.hpp"
 #include "prx/utilities/math/geometry_info.hpp"
 #include "prx/utilities/applications/search.hpp"
+#include "prx/utilities/applications/occupancy_grid.hpp"
+#include "prx/utilities/applications/maze_loader.hpp"
+#include "prx/utilities/applications/distance_oracle.hpp"
+#include "prx/utilities/applications/digit_layout.hpp"
+#include "prx/utilities/applications/agent_fleet.hpp"
 
 #include <ros/ros.h>
+#include <condition_variable>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 namespace prx
 {
     namespace util
     {
+        //A digit sensing found, how likely it is, and the maze cell it sends the agent to
+        struct sensed_goal_t
+        {
+            int digit;
+            double probability;
+            int i, j;
+        };
+
+        //The most likely goals of one sensing, most likely first; empty if sensing failed
+        struct sensing_result_t
+        {
+            std::vector<sensed_goal_t> candidates;
 
+            bool is_valid() const { return !candidates.empty(); }
+            double get_confidence() const { return candidates.empty() ? 0 : candidates[0].probability; }
+        };
 
         /**
          * An organizer class for our application. It contains the simulator and keeps all the extra 
@@ -63,13 +89,27 @@ namespace prx
             void update_visualization();
 
             /**
-             * This is a needed function to mimic the simulation application. Currently only calls tf_broadcasting.
+             * This is a needed function to mimic the simulation application. Runs at render_rate and calls
+             * tf_broadcasting if the robot or the goal moved since the last call, so waypoints stepped faster than
+             * the render rate are coalesced into one update.
              */
             virtual void info_broadcasting(const ros::TimerEvent& event);
 
+            //Runs at waypoint_rate and wakes the automaton to step the agent to its next waypoint
+            void waypoint_stepping(const ros::TimerEvent& event);
+
+            //Waypoints per second and visualization updates per second, 0 when the timer is not used
+            double get_waypoint_rate() const { return waypoint_rate; }
+            double get_render_rate() const { return render_rate; }
+
             void build_environment(std::string filename, std::string block_filename);
 
-            //Function that runs the automaton loop
+            /**
+             * Runs the automaton until ROS shuts down. Timer callbacks run on a spinner thread of their own, and the
+             * automaton sleeps on a condition variable until they wake it, so it uses no CPU while it waits for a
+             * waypoint to be consumed or for the START delay to pass. The time spent in every state is reported
+             * after every goal and at the end. With agent_count above 1 it runs the fleet of agents instead.
+             */
             void execute();
 
             //All possible automaton states
@@ -104,26 +144,119 @@ namespace prx
             space_t* state_space;
             int path_counter;
             bool consumed_waypoint;
+            //Whether the robot or the goal changed since the visualization was last updated
+            bool pose_changed;
+            //The agent steps at waypoint_rate, or along the whole path at once if it is 0. The visualization is
+            //updated at render_rate, or only before sensing if it is 0.
+            double waypoint_rate;
+            double render_rate;
+            //Updates the visualization now if the robot or the goal moved, call with event_mutex held
+            void flush_visualization();
+
+            //Guards the robot pose, pose_changed and consumed_waypoint between the automaton and the timer callbacks
+            std::mutex event_mutex;
+            std::condition_variable event;
+            //Seconds START waits before sensing, so the visualization shows the robot at its last goal
+            double start_delay;
+
+            //Waits until done holds, checked under event_mutex whenever a callback notifies event, or timeout seconds
+            //pass; returns done()
+            bool wait_for_event(const std::function<bool ()>& done, double timeout);
+
+            //Wall and CPU seconds spent in every state, and how often it was entered
+            double state_seconds[4];
+            int state_entries[4];
+            double accounted_seconds;
+            std::clock_t accounted_cpu;
+            void account_state(STATE state, double seconds);
+            void report_state_times();
 
 
             int current_goal_i, current_goal_j; //The currently sensed goal
             std::vector< std::pair<int, int> > current_path; //The currently computed path
             std::string environment_file; //The file that points to the maze
             int r,c; //Rows and columns in the maze
-            std::vector<std::vector<int>> maze; //The maze 2D data structure with r rows and c columns
+            const occupancy_grid_t* maze; //The immutable maze with r rows and c columns, shared with the searcher
 
             std::pair<int, int> pose_from_indices(int i, int j); //Helper functions to go between array indices to poses in the environment
             std::pair<int, int> indices_from_pose(int x, int y); //Helper functions to go between poses in the environment to array indices
             void move(); //Moves the agent along the current path
             
-            //Sense the scene and return the array indices of the next goal
-            virtual std::pair<int, int> sense(std::string sensing_image);
+            //Sense the scene and return the most likely next goals
+            virtual sensing_result_t sense(std::string sensing_image);
+
+            //Sense the scene in a frame mapped from the visualization's shared frame ring
+            virtual sensing_result_t sense(const shared_frame_t& frame);
+
+            //Takes a screenshot and senses it, from the shared frame ring or the screenshot file
+            sensing_result_t capture_and_sense();
+
+            //The sensing_top_k most likely digits of a softmax over the 10 digits, with their positions
+            sensing_result_t rank_digits(const float* probabilities);
+
+            //Below sensing_confidence the scene is captured and sensed again, up to sensing_retries times.
+            //With hedge_low_confidence the agent then moves along the part of the paths to the two most likely
+            //goals they share, and senses again from there.
+            int sensing_top_k;
+            double sensing_confidence;
+            int sensing_retries;
+            bool hedge_low_confidence;
+            //The candidates of the last sensing, and whether the current path is only their shared prefix
+            sensing_result_t sensed;
+            bool hedging;
+
+            //With pipelined on, a worker thread senses and plans the leg after the current one while the agent moves.
+            //The view at the end of a leg is only rendered once the agent is there, so the worker reuses what was
+            //sensed in that cell on an earlier visit, the scene being static. The leg is committed, skipping START,
+            //SENSE and PLAN, only if the agent ends in the cell it was speculated from.
+            struct speculation_t
+            {
+                int i, j; //The cell the leg starts from
+                sensing_result_t sensed;
+                std::vector< std::pair<int, int> > path;
+                bool valid;
+            };
+            bool pipelined;
+            std::map<std::pair<int, int>, sensing_result_t> sensed_at; //Confident sensings by the cell they were made in
+            std::thread speculation_thread;
+            speculation_t speculation;
+            int speculated_legs, committed_legs; //Legs speculated from a cached sensing, written by the worker
+            //Starts speculating the leg from the end of current_path; the automaton leaves sensed_at and the searcher
+            //alone until it is finished
+            void start_speculation();
+            //Waits for the speculation and makes it the current leg if it starts where the agent is
+            bool commit_speculation();
+
+            //Waits for the first frame rendered after the screenshot request that followed frame sequence "after"
+            bool wait_for_sensing_frame(uint64_t after, shared_frame_t& frame);
+
+            //Name of the shared memory ring the visualization writes frames to, empty to read screenshot files
+            std::string shared_frames;
+            shared_frame_ring_t frame_ring;
 
             //Plan from (initial_i, initial_j) to (goal_i, goal_j) in the maze and return the sequence of maze indices
             std::vector< std::pair<int, int> > plan(int initial_i, int initial_j, int goal_i, int goal_j );
 
             search_t* searcher;
+            search_t::algorithm_t search_algorithm; //Planner used by plan(), selected with the "planner" parameter
             std::map<int, std::pair<int, int>> digit_to_position;
+
+            //The meshes and digit cells drawn by build_environment
+            digit_layout_t layout;
+
+            //With agent_count above 1 many agents walk the digit sequence, planned for on fleet_threads threads.
+            //The one camera cannot look around every agent, so they read the next digit from the layout. Agent 0 is
+            //the disk and the others are copies of it, published in one tf batch per render tick.
+            int agent_count;
+            unsigned fleet_threads;
+            agent_fleet_t* fleet;
+            std::vector<std::string> agent_frames;
+            std::vector<double> agent_x, agent_y; //Guarded by event_mutex
+            void execute_fleet();
+
+            //Optional next-hop fields towards every digit position, answers plan() without searching
+            distance_oracle_t* goal_oracle;
+            void precompute_goal_paths();
         };
 
 
@@ -0,0 +1,906 @@
+#include "prx/utilities/applications/classifier_kernels.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+
+#if defined(__x86_64__)
+#define PRX_CLASSIFIER_X86
+#include <immintrin.h>
+#endif
+
+namespace prx
+{
+
+    namespace util
+    {
+        // the kernel rows that overlap the image for output row y, the padding is never read
+        static inline void clip_kernel(int y, int pad, int kernel, int size, int& begin, int& end)
+        {
+            begin = PRX_MAXIMUM(0, pad - y);
+            end = PRX_MINIMUM(kernel, size + pad - y);
+        }
+
+        static void scalar_convolution(const float* in, int height, int width, int channels,
+                                       const float* weights, const float* bias, int kernel, int filters, bool relu, float* out)
+        {
+            int pad = (kernel - 1) / 2;
+            for (int y = 0; y < height; ++y)
+            {
+                int ky_begin, ky_end;
+                clip_kernel(y, pad, kernel, height, ky_begin, ky_end);
+                for (int x = 0; x < width; ++x)
+                {
+                    int kx_begin, kx_end;
+                    clip_kernel(x, pad, kernel, width, kx_begin, kx_end);
+                    float* o = out + (y * width + x) * filters;
+                    for (int f = 0; f < filters; ++f)
+                        o[f] = bias[f];
+                    for (int ky = ky_begin; ky < ky_end; ++ky)
+                    {
+                        for (int kx = kx_begin; kx < kx_end; ++kx)
+                        {
+                            const float* pixel = in + ((y + ky - pad) * width + (x + kx - pad)) * channels;
+                            const float* w = weights + (ky * kernel + kx) * channels * filters;
+                            for (int c = 0; c < channels; ++c, w += filters)
+                            {
+                                float value = pixel[c];
+                                for (int f = 0; f < filters; ++f)
+                                    o[f] += value * w[f];
+                            }
+                        }
+                    }
+                    if (relu)
+                        for (int f = 0; f < filters; ++f)
+                            o[f] = PRX_MAXIMUM(o[f], 0.0f);
+                }
+            }
+        }
+
+        static void scalar_max_pool(const float* in, int height, int width, int channels, float* out)
+        {
+            int out_height = (height + 1) / 2, out_width = (width + 1) / 2;
+            for (int y = 0; y < out_height; ++y)
+            {
+                for (int x = 0; x < out_width; ++x)
+                {
+                    float* o = out + (y * out_width + x) * channels;
+                    const float* p = in + (2 * y * width + 2 * x) * channels;
+                    // SAME padding, an odd last row or column pools fewer values
+                    bool right = 2 * x + 1 < width, down = 2 * y + 1 < height;
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        float value = p[c];
+                        if (right)
+                            value = PRX_MAXIMUM(value, p[channels + c]);
+                        if (down)
+                            value = PRX_MAXIMUM(value, p[width * channels + c]);
+                        if (right && down)
+                            value = PRX_MAXIMUM(value, p[(width + 1) * channels + c]);
+                        o[c] = value;
+                    }
+                }
+            }
+        }
+
+        static void scalar_dense(const float* in, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out)
+        {
+            for (int o = 0; o < outputs; ++o)
+                out[o] = bias[o];
+            // the weights are inputs x outputs, walk them row by row
+            for (int i = 0; i < inputs; ++i)
+            {
+                float value = in[i];
+                if (value == 0)
+                    continue;
+                const float* w = weights + (size_t)i * outputs;
+                for (int o = 0; o < outputs; ++o)
+                    out[o] += value * w[o];
+            }
+            if (relu)
+                for (int o = 0; o < outputs; ++o)
+                    out[o] = PRX_MAXIMUM(out[o], 0.0f);
+        }
+
+        // the reference processes one image at a time
+        static void scalar_dense_batch(const float* in, int count, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out)
+        {
+            for (int b = 0; b < count; ++b)
+                scalar_dense(in + (size_t)b * inputs, inputs, weights, bias, outputs, relu, out + (size_t)b * outputs);
+        }
+
+        // int32 sums of up to quantized_block outputs at a time, so the scalar int8 kernels need no workspace
+        static const int quantized_block = 64;
+
+        static inline void scalar_quantized_rows(const int8_t* x, int n, const int8_t* w, int stride, int outputs, int32_t* acc)
+        {
+            for (int i = 0; i < n; ++i, w += stride)
+            {
+                int32_t value = x[i];
+                if (value == 0)
+                    continue;
+                for (int o = 0; o < outputs; ++o)
+                    acc[o] += value * w[o];
+            }
+        }
+
+        static inline void scalar_quantized_store(const int32_t* acc, int outputs, const float* scales, const float* bias, bool relu, float* out)
+        {
+            for (int o = 0; o < outputs; ++o)
+            {
+                float value = acc[o] * scales[o] + bias[o];
+                out[o] = relu ? PRX_MAXIMUM(value, 0.0f) : value;
+            }
+        }
+
+        static void scalar_quantized_convolution(const int8_t* in, int height, int width, int channels, const int8_t* weights,
+                                                 const float* scales, const float* bias, int kernel, int filters, bool relu, float* out)
+        {
+            int pad = (kernel - 1) / 2;
+            int32_t acc[quantized_block];
+            for (int y = 0; y < height; ++y)
+            {
+                int ky_begin, ky_end;
+                clip_kernel(y, pad, kernel, height, ky_begin, ky_end);
+                for (int x = 0; x < width; ++x)
+                {
+                    int kx_begin, kx_end;
+                    clip_kernel(x, pad, kernel, width, kx_begin, kx_end);
+                    for (int f = 0; f < filters; f += quantized_block)
+                    {
+                        int count = PRX_MINIMUM(quantized_block, filters - f);
+                        for (int o = 0; o < count; ++o)
+                            acc[o] = 0;
+                        for (int ky = ky_begin; ky < ky_end; ++ky)
+                            for (int kx = kx_begin; kx < kx_end; ++kx)
+                                scalar_quantized_rows(in + ((y + ky - pad) * width + (x + kx - pad)) * channels, channels,
+                                                      weights + (ky * kernel + kx) * channels * filters + f, filters, count, acc);
+                        scalar_quantized_store(acc, count, scales + f, bias + f, relu, out + (y * width + x) * filters + f);
+                    }
+                }
+            }
+        }
+
+        static void scalar_quantized_dense(const int8_t* in, int inputs, const int8_t* weights, const float* scales, const float* bias,
+                                           int outputs, bool relu, float* out)
+        {
+            int32_t acc[quantized_block];
+            for (int o = 0; o < outputs; o += quantized_block)
+            {
+                int count = PRX_MINIMUM(quantized_block, outputs - o);
+                for (int k = 0; k < count; ++k)
+                    acc[k] = 0;
+                scalar_quantized_rows(in, inputs, weights + o, outputs, count, acc);
+                scalar_quantized_store(acc, count, scales + o, bias + o, relu, out + o);
+            }
+        }
+
+        static const classifier_kernels_t scalar_kernels = {"scalar", scalar_convolution, scalar_max_pool, scalar_dense, scalar_dense_batch,
+                                                            scalar_quantized_convolution, scalar_quantized_dense};
+
+#ifdef PRX_CLASSIFIER_X86
+
+        // SSE2 is part of x86-64, so these need no dispatch. Outputs are computed in blocks of 16 (four
+        // registers), then 4, then one at a time, and every block reads all of its inputs once.
+
+        template<int N>
+        static inline void sse_convolution_block(const float* in, int width, int channels, const float* weights, const float* bias,
+                                                 int kernel, int filters, int pad, int y, int x,
+                                                 int ky_begin, int ky_end, int kx_begin, int kx_end, bool relu, float* o)
+        {
+            __m128 acc[N];
+            for (int j = 0; j < N; ++j)
+                acc[j] = _mm_loadu_ps(bias + 4 * j);
+            for (int ky = ky_begin; ky < ky_end; ++ky)
+            {
+                for (int kx = kx_begin; kx < kx_end; ++kx)
+                {
+                    const float* pixel = in + ((y + ky - pad) * width + (x + kx - pad)) * channels;
+                    const float* w = weights + (ky * kernel + kx) * channels * filters;
+                    for (int c = 0; c < channels; ++c, w += filters)
+                    {
+                        __m128 value = _mm_set1_ps(pixel[c]);
+                        for (int j = 0; j < N; ++j)
+                            acc[j] = _mm_add_ps(acc[j], _mm_mul_ps(value, _mm_loadu_ps(w + 4 * j)));
+                    }
+                }
+            }
+            for (int j = 0; j < N; ++j)
+            {
+                if (relu)
+                    acc[j] = _mm_max_ps(acc[j], _mm_setzero_ps());
+                _mm_storeu_ps(o + 4 * j, acc[j]);
+            }
+        }
+
+        static void sse_convolution(const float* in, int height, int width, int channels,
+                                    const float* weights, const float* bias, int kernel, int filters, bool relu, float* out)
+        {
+            int pad = (kernel - 1) / 2;
+            for (int y = 0; y < height; ++y)
+            {
+                int ky_begin, ky_end;
+                clip_kernel(y, pad, kernel, height, ky_begin, ky_end);
+                for (int x = 0; x < width; ++x)
+                {
+                    int kx_begin, kx_end;
+                    clip_kernel(x, pad, kernel, width, kx_begin, kx_end);
+                    float* o = out + (y * width + x) * filters;
+                    int f = 0;
+                    for (; f + 16 <= filters; f += 16)
+                        sse_convolution_block<4>(in, width, channels, weights + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    for (; f + 4 <= filters; f += 4)
+                        sse_convolution_block<1>(in, width, channels, weights + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    for (; f < filters; ++f)
+                    {
+                        float sum = bias[f];
+                        for (int ky = ky_begin; ky < ky_end; ++ky)
+                            for (int kx = kx_begin; kx < kx_end; ++kx)
+                                for (int c = 0; c < channels; ++c)
+                                    sum += in[((y + ky - pad) * width + (x + kx - pad)) * channels + c] * weights[((ky * kernel + kx) * channels + c) * filters + f];
+                        o[f] = relu ? PRX_MAXIMUM(sum, 0.0f) : sum;
+                    }
+                }
+            }
+        }
+
+        static void sse_max_pool(const float* in, int height, int width, int channels, float* out)
+        {
+            // the vector path needs every 2x2 window to be whole
+            if (height % 2 != 0 || width % 2 != 0 || channels % 4 != 0)
+            {
+                scalar_max_pool(in, height, width, channels, out);
+                return;
+            }
+            int out_height = height / 2, out_width = width / 2;
+            for (int y = 0; y < out_height; ++y)
+            {
+                for (int x = 0; x < out_width; ++x)
+                {
+                    float* o = out + (y * out_width + x) * channels;
+                    const float* p = in + (2 * y * width + 2 * x) * channels;
+                    const float* q = p + width * channels;
+                    for (int c = 0; c < channels; c += 4)
+                    {
+                        __m128 top = _mm_max_ps(_mm_loadu_ps(p + c), _mm_loadu_ps(p + channels + c));
+                        __m128 bottom = _mm_max_ps(_mm_loadu_ps(q + c), _mm_loadu_ps(q + channels + c));
+                        _mm_storeu_ps(o + c, _mm_max_ps(top, bottom));
+                    }
+                }
+            }
+        }
+
+        // rows of the weights a dense block reads before moving to the next block of outputs, so
+        // the rows stay in cache while every block of outputs is accumulated
+        static const int dense_rows = 16;
+
+        template<int N>
+        static inline void sse_dense_block(const float* in, int inputs, const float* weights, int outputs, bool relu, float* out)
+        {
+            __m128 acc[N];
+            for (int j = 0; j < N; ++j)
+                acc[j] = _mm_loadu_ps(out + 4 * j);
+            const float* w = weights;
+            for (int i = 0; i < inputs; ++i, w += outputs)
+            {
+                // MNIST images are mostly background
+                if (in[i] == 0)
+                    continue;
+                __m128 value = _mm_set1_ps(in[i]);
+                for (int j = 0; j < N; ++j)
+                    acc[j] = _mm_add_ps(acc[j], _mm_mul_ps(value, _mm_loadu_ps(w + 4 * j)));
+            }
+            for (int j = 0; j < N; ++j)
+            {
+                if (relu)
+                    acc[j] = _mm_max_ps(acc[j], _mm_setzero_ps());
+                _mm_storeu_ps(out + 4 * j, acc[j]);
+            }
+        }
+
+        static void sse_dense(const float* in, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out)
+        {
+            for (int o = 0; o < outputs; ++o)
+                out[o] = bias[o];
+            for (int i = 0; i < inputs; i += dense_rows)
+            {
+                int rows = PRX_MINIMUM(dense_rows, inputs - i);
+                bool last = i + rows == inputs;
+                const float* w = weights + (size_t)i * outputs;
+                int o = 0;
+                for (; o + 16 <= outputs; o += 16)
+                    sse_dense_block<4>(in + i, rows, w + o, outputs, relu && last, out + o);
+                for (; o + 4 <= outputs; o += 4)
+                    sse_dense_block<1>(in + i, rows, w + o, outputs, relu && last, out + o);
+                for (; o < outputs; ++o)
+                {
+                    float sum = out[o];
+                    for (int r = 0; r < rows; ++r)
+                        sum += in[i + r] * w[(size_t)r * outputs + o];
+                    out[o] = relu && last ? PRX_MAXIMUM(sum, 0.0f) : sum;
+                }
+            }
+        }
+
+        // The int8 kernels take two input rows at a time: the weights of both rows are interleaved and
+        // widened to int16, so one multiply-add gives row i * x[i] + row i+1 * x[i+1] for four outputs.
+        // Blocks are N groups of 8 outputs, each group is read with one 8 byte load per row.
+
+        // x[i] in the low and x[i+1] in the high half of every 32 bit lane
+        static inline int32_t quantized_pair(int8_t first, int8_t second)
+        {
+            return (int32_t)(((uint32_t)(uint16_t)(int16_t)second << 16) | (uint16_t)(int16_t)first);
+        }
+
+        // adds w0 * first + w1 * second to N groups of 8 outputs, w1 is NULL past the last row
+        template<int N>
+        static inline void sse_quantized_pair(int8_t first, int8_t second, const int8_t* w0, const int8_t* w1, __m128i* acc)
+        {
+            __m128i pair = _mm_set1_epi32(quantized_pair(first, second));
+            for (int j = 0; j < N; ++j)
+            {
+                __m128i row0 = _mm_loadl_epi64((const __m128i*)(w0 + 8 * j));
+                __m128i row1 = w1 == NULL ? _mm_setzero_si128() : _mm_loadl_epi64((const __m128i*)(w1 + 8 * j));
+                __m128i bytes = _mm_unpacklo_epi8(row0, row1);
+                // SSE2 has no sign extension, so move each byte into the high half of a word and shift back
+                __m128i low = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+                __m128i high = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+                acc[2 * j] = _mm_add_epi32(acc[2 * j], _mm_madd_epi16(low, pair));
+                acc[2 * j + 1] = _mm_add_epi32(acc[2 * j + 1], _mm_madd_epi16(high, pair));
+            }
+        }
+
+        template<int N>
+        static inline void sse_quantized_rows(const int8_t* x, int n, const int8_t* w, int stride, __m128i* acc)
+        {
+            int i = 0;
+            for (; i + 2 <= n; i += 2)
+                if ((x[i] | x[i + 1]) != 0)
+                    sse_quantized_pair<N>(x[i], x[i + 1], w + (size_t)i * stride, w + (size_t)(i + 1) * stride, acc);
+            if (i < n && x[i] != 0)
+                sse_quantized_pair<N>(x[i], 0, w + (size_t)i * stride, NULL, acc);
+        }
+
+        template<int N>
+        static inline void sse_quantized_store(const __m128i* acc, const float* scales, const float* bias, bool relu, float* out)
+        {
+            for (int j = 0; j < 2 * N; ++j)
+            {
+                __m128 value = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc[j]), _mm_loadu_ps(scales + 4 * j)), _mm_loadu_ps(bias + 4 * j));
+                if (relu)
+                    value = _mm_max_ps(value, _mm_setzero_ps());
+                _mm_storeu_ps(out + 4 * j, value);
+            }
+        }
+
+        template<int N>
+        static inline void sse_quantized_block(const int8_t* in, int width, int channels, const int8_t* weights, const float* scales, const float* bias,
+                                               int kernel, int filters, int pad, int y, int x,
+                                               int ky_begin, int ky_end, int kx_begin, int kx_end, bool relu, float* o)
+        {
+            __m128i acc[2 * N];
+            for (int j = 0; j < 2 * N; ++j)
+                acc[j] = _mm_setzero_si128();
+            for (int ky = ky_begin; ky < ky_end; ++ky)
+                for (int kx = kx_begin; kx < kx_end; ++kx)
+                    sse_quantized_rows<N>(in + ((y + ky - pad) * width + (x + kx - pad)) * channels, channels,
+                                          weights + (ky * kernel + kx) * channels * filters, filters, acc);
+            sse_quantized_store<N>(acc, scales, bias, relu, o);
+        }
+
+        static void sse_quantized_convolution(const int8_t* in, int height, int width, int channels, const int8_t* weights,
+                                              const float* scales, const float* bias, int kernel, int filters, bool relu, float* out)
+        {
+            int pad = (kernel - 1) / 2;
+            int32_t acc[8];
+            for (int y = 0; y < height; ++y)
+            {
+                int ky_begin, ky_end;
+                clip_kernel(y, pad, kernel, height, ky_begin, ky_end);
+                for (int x = 0; x < width; ++x)
+                {
+                    int kx_begin, kx_end;
+                    clip_kernel(x, pad, kernel, width, kx_begin, kx_end);
+                    float* o = out + (y * width + x) * filters;
+                    int f = 0;
+                    for (; f + 32 <= filters; f += 32)
+                        sse_quantized_block<4>(in, width, channels, weights + f, scales + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    for (; f + 8 <= filters; f += 8)
+                        sse_quantized_block<1>(in, width, channels, weights + f, scales + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    if (f < filters)
+                    {
+                        for (int k = 0; k < filters - f; ++k)
+                            acc[k] = 0;
+                        for (int ky = ky_begin; ky < ky_end; ++ky)
+                            for (int kx = kx_begin; kx < kx_end; ++kx)
+                                scalar_quantized_rows(in + ((y + ky - pad) * width + (x + kx - pad)) * channels, channels,
+                                                      weights + (ky * kernel + kx) * channels * filters + f, filters, filters - f, acc);
+                        scalar_quantized_store(acc, filters - f, scales + f, bias + f, relu, o + f);
+                    }
+                }
+            }
+        }
+
+        static void sse_quantized_dense(const int8_t* in, int inputs, const int8_t* weights, const float* scales, const float* bias,
+                                        int outputs, bool relu, float* out)
+        {
+            int o = 0;
+            for (; o + 32 <= outputs; o += 32)
+            {
+                __m128i acc[8];
+                for (int j = 0; j < 8; ++j)
+                    acc[j] = _mm_setzero_si128();
+                sse_quantized_rows<4>(in, inputs, weights + o, outputs, acc);
+                sse_quantized_store<4>(acc, scales + o, bias + o, relu, out + o);
+            }
+            for (; o + 8 <= outputs; o += 8)
+            {
+                __m128i acc[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+                sse_quantized_rows<1>(in, inputs, weights + o, outputs, acc);
+                sse_quantized_store<1>(acc, scales + o, bias + o, relu, out + o);
+            }
+            if (o < outputs && outputs >= 8)
+            {
+                // the last 8 outputs, overlapping ones already stored, rather than a scalar pass over the weights
+                int last = outputs - 8;
+                __m128i acc[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+                float stored[8];
+                sse_quantized_rows<1>(in, inputs, weights + last, outputs, acc);
+                sse_quantized_store<1>(acc, scales + last, bias + last, relu, stored);
+                for (; o < outputs; ++o)
+                    out[o] = stored[o - last];
+            }
+            else if (o < outputs)
+            {
+                int32_t acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+                scalar_quantized_rows(in, inputs, weights + o, outputs, outputs - o, acc);
+                scalar_quantized_store(acc, outputs - o, scales + o, bias + o, relu, out + o);
+            }
+        }
+
+        // the outputs from first on that do not fill a register, for the block of four images
+        static inline void dense_batch_tail(const float* in, int in_stride, int rows, const float* weights, int first, int outputs, bool relu, float* out, int out_stride)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                float* result = out + k * out_stride;
+                for (int r = 0; r < rows; ++r)
+                {
+                    float value = in[k * in_stride + r];
+                    const float* w = weights + (size_t)r * outputs;
+                    for (int o = first; o < outputs; ++o)
+                        result[o] += value * w[o];
+                }
+                if (relu)
+                    for (int o = first; o < outputs; ++o)
+                        result[o] = PRX_MAXIMUM(result[o], 0.0f);
+            }
+        }
+
+        // B images by N registers of outputs, accumulated over rows of weights into out; unlike dense,
+        // zero inputs are not skipped, a branch per image and row costs more than the multiplies
+        template<int B, int N>
+        static inline void sse_dense_batch_block(const float* in, int in_stride, int rows, const float* weights, int outputs, bool relu, float* out, int out_stride)
+        {
+            __m128 acc[B][N];
+            for (int b = 0; b < B; ++b)
+                for (int j = 0; j < N; ++j)
+                    acc[b][j] = _mm_loadu_ps(out + b * out_stride + 4 * j);
+            const float* w = weights;
+            for (int i = 0; i < rows; ++i, w += outputs)
+            {
+                __m128 row[N];
+                for (int j = 0; j < N; ++j)
+                    row[j] = _mm_loadu_ps(w + 4 * j);
+                for (int b = 0; b < B; ++b)
+                {
+                    __m128 broadcast = _mm_set1_ps(in[b * in_stride + i]);
+                    for (int j = 0; j < N; ++j)
+                        acc[b][j] = _mm_add_ps(acc[b][j], _mm_mul_ps(broadcast, row[j]));
+                }
+            }
+            for (int b = 0; b < B; ++b)
+            {
+                for (int j = 0; j < N; ++j)
+                {
+                    if (relu)
+                        acc[b][j] = _mm_max_ps(acc[b][j], _mm_setzero_ps());
+                    _mm_storeu_ps(out + b * out_stride + 4 * j, acc[b][j]);
+                }
+            }
+        }
+
+        // four images at a time, the rest one at a time
+        static void sse_dense_batch(const float* in, int count, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out)
+        {
+            int b = 0;
+            for (; b + 4 <= count; b += 4)
+            {
+                const float* images = in + (size_t)b * inputs;
+                float* results = out + (size_t)b * outputs;
+                for (int k = 0; k < 4; ++k)
+                    for (int o = 0; o < outputs; ++o)
+                        results[k * outputs + o] = bias[o];
+                for (int i = 0; i < inputs; i += dense_rows)
+                {
+                    int rows = PRX_MINIMUM(dense_rows, inputs - i);
+                    bool last = i + rows == inputs;
+                    const float* w = weights + (size_t)i * outputs;
+                    int o = 0;
+                    for (; o + 8 <= outputs; o += 8)
+                        sse_dense_batch_block<4, 2>(images + i, inputs, rows, w + o, outputs, relu && last, results + o, outputs);
+                    for (; o + 4 <= outputs; o += 4)
+                        sse_dense_batch_block<4, 1>(images + i, inputs, rows, w + o, outputs, relu && last, results + o, outputs);
+                    if (o < outputs)
+                        dense_batch_tail(images + i, inputs, rows, w, o, outputs, relu && last, results, outputs);
+                }
+            }
+            for (; b < count; ++b)
+                sse_dense(in + (size_t)b * inputs, inputs, weights, bias, outputs, relu, out + (size_t)b * outputs);
+        }
+
+        static const classifier_kernels_t sse_kernels = {"sse2", sse_convolution, sse_max_pool, sse_dense, sse_dense_batch,
+                                                         sse_quantized_convolution, sse_quantized_dense};
+
+        // The same loops with 8 wide registers and fused multiply-add, compiled for AVX2 whatever the
+        // flags of the rest of the library, and only called once CPUID has reported AVX2 and FMA.
+#define PRX_AVX2 __attribute__((target("avx2,fma")))
+
+        template<int N>
+        PRX_AVX2 static inline void avx2_convolution_block(const float* in, int width, int channels, const float* weights, const float* bias,
+                                                           int kernel, int filters, int pad, int y, int x,
+                                                           int ky_begin, int ky_end, int kx_begin, int kx_end, bool relu, float* o)
+        {
+            __m256 acc[N];
+            for (int j = 0; j < N; ++j)
+                acc[j] = _mm256_loadu_ps(bias + 8 * j);
+            for (int ky = ky_begin; ky < ky_end; ++ky)
+            {
+                for (int kx = kx_begin; kx < kx_end; ++kx)
+                {
+                    const float* pixel = in + ((y + ky - pad) * width + (x + kx - pad)) * channels;
+                    const float* w = weights + (ky * kernel + kx) * channels * filters;
+                    for (int c = 0; c < channels; ++c, w += filters)
+                    {
+                        __m256 value = _mm256_set1_ps(pixel[c]);
+                        for (int j = 0; j < N; ++j)
+                            acc[j] = _mm256_fmadd_ps(value, _mm256_loadu_ps(w + 8 * j), acc[j]);
+                    }
+                }
+            }
+            for (int j = 0; j < N; ++j)
+            {
+                if (relu)
+                    acc[j] = _mm256_max_ps(acc[j], _mm256_setzero_ps());
+                _mm256_storeu_ps(o + 8 * j, acc[j]);
+            }
+        }
+
+        PRX_AVX2 static void avx2_convolution(const float* in, int height, int width, int channels,
+                                              const float* weights, const float* bias, int kernel, int filters, bool relu, float* out)
+        {
+            int pad = (kernel - 1) / 2;
+            for (int y = 0; y < height; ++y)
+            {
+                int ky_begin, ky_end;
+                clip_kernel(y, pad, kernel, height, ky_begin, ky_end);
+                for (int x = 0; x < width; ++x)
+                {
+                    int kx_begin, kx_end;
+                    clip_kernel(x, pad, kernel, width, kx_begin, kx_end);
+                    float* o = out + (y * width + x) * filters;
+                    int f = 0;
+                    for (; f + 32 <= filters; f += 32)
+                        avx2_convolution_block<4>(in, width, channels, weights + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    for (; f + 8 <= filters; f += 8)
+                        avx2_convolution_block<1>(in, width, channels, weights + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    for (; f < filters; ++f)
+                    {
+                        float sum = bias[f];
+                        for (int ky = ky_begin; ky < ky_end; ++ky)
+                            for (int kx = kx_begin; kx < kx_end; ++kx)
+                                for (int c = 0; c < channels; ++c)
+                                    sum += in[((y + ky - pad) * width + (x + kx - pad)) * channels + c] * weights[((ky * kernel + kx) * channels + c) * filters + f];
+                        o[f] = relu ? PRX_MAXIMUM(sum, 0.0f) : sum;
+                    }
+                }
+            }
+        }
+
+        PRX_AVX2 static void avx2_max_pool(const float* in, int height, int width, int channels, float* out)
+        {
+            if (height % 2 != 0 || width % 2 != 0 || channels % 8 != 0)
+            {
+                sse_max_pool(in, height, width, channels, out);
+                return;
+            }
+            int out_height = height / 2, out_width = width / 2;
+            for (int y = 0; y < out_height; ++y)
+            {
+                for (int x = 0; x < out_width; ++x)
+                {
+                    float* o = out + (y * out_width + x) * channels;
+                    const float* p = in + (2 * y * width + 2 * x) * channels;
+                    const float* q = p + width * channels;
+                    for (int c = 0; c < channels; c += 8)
+                    {
+                        __m256 top = _mm256_max_ps(_mm256_loadu_ps(p + c), _mm256_loadu_ps(p + channels + c));
+                        __m256 bottom = _mm256_max_ps(_mm256_loadu_ps(q + c), _mm256_loadu_ps(q + channels + c));
+                        _mm256_storeu_ps(o + c, _mm256_max_ps(top, bottom));
+                    }
+                }
+            }
+        }
+
+        template<int N>
+        PRX_AVX2 static inline void avx2_dense_block(const float* in, int inputs, const float* weights, int outputs, bool relu, float* out)
+        {
+            __m256 acc[N];
+            for (int j = 0; j < N; ++j)
+                acc[j] = _mm256_loadu_ps(out + 8 * j);
+            const float* w = weights;
+            for (int i = 0; i < inputs; ++i, w += outputs)
+            {
+                if (in[i] == 0)
+                    continue;
+                __m256 value = _mm256_set1_ps(in[i]);
+                for (int j = 0; j < N; ++j)
+                    acc[j] = _mm256_fmadd_ps(value, _mm256_loadu_ps(w + 8 * j), acc[j]);
+            }
+            for (int j = 0; j < N; ++j)
+            {
+                if (relu)
+                    acc[j] = _mm256_max_ps(acc[j], _mm256_setzero_ps());
+                _mm256_storeu_ps(out + 8 * j, acc[j]);
+            }
+        }
+
+        PRX_AVX2 static void avx2_dense(const float* in, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out)
+        {
+            for (int o = 0; o < outputs; ++o)
+                out[o] = bias[o];
+            for (int i = 0; i < inputs; i += dense_rows)
+            {
+                int rows = PRX_MINIMUM(dense_rows, inputs - i);
+                bool last = i + rows == inputs;
+                const float* w = weights + (size_t)i * outputs;
+                int o = 0;
+                for (; o + 32 <= outputs; o += 32)
+                    avx2_dense_block<4>(in + i, rows, w + o, outputs, relu && last, out + o);
+                for (; o + 8 <= outputs; o += 8)
+                    avx2_dense_block<1>(in + i, rows, w + o, outputs, relu && last, out + o);
+                for (; o + 4 <= outputs; o += 4)
+                    sse_dense_block<1>(in + i, rows, w + o, outputs, relu && last, out + o);
+                for (; o < outputs; ++o)
+                {
+                    float sum = out[o];
+                    for (int r = 0; r < rows; ++r)
+                        sum += in[i + r] * w[(size_t)r * outputs + o];
+                    out[o] = relu && last ? PRX_MAXIMUM(sum, 0.0f) : sum;
+                }
+            }
+        }
+
+        template<int B, int N>
+        PRX_AVX2 static inline void avx2_dense_batch_block(const float* in, int in_stride, int rows, const float* weights, int outputs, bool relu, float* out, int out_stride)
+        {
+            __m256 acc[B][N];
+            for (int b = 0; b < B; ++b)
+                for (int j = 0; j < N; ++j)
+                    acc[b][j] = _mm256_loadu_ps(out + b * out_stride + 8 * j);
+            const float* w = weights;
+            for (int i = 0; i < rows; ++i, w += outputs)
+            {
+                __m256 row[N];
+                for (int j = 0; j < N; ++j)
+                    row[j] = _mm256_loadu_ps(w + 8 * j);
+                for (int b = 0; b < B; ++b)
+                {
+                    __m256 broadcast = _mm256_set1_ps(in[b * in_stride + i]);
+                    for (int j = 0; j < N; ++j)
+                        acc[b][j] = _mm256_fmadd_ps(broadcast, row[j], acc[b][j]);
+                }
+            }
+            for (int b = 0; b < B; ++b)
+            {
+                for (int j = 0; j < N; ++j)
+                {
+                    if (relu)
+                        acc[b][j] = _mm256_max_ps(acc[b][j], _mm256_setzero_ps());
+                    _mm256_storeu_ps(out + b * out_stride + 8 * j, acc[b][j]);
+                }
+            }
+        }
+
+        PRX_AVX2 static void avx2_dense_batch(const float* in, int count, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out)
+        {
+            int b = 0;
+            for (; b + 4 <= count; b += 4)
+            {
+                const float* images = in + (size_t)b * inputs;
+                float* results = out + (size_t)b * outputs;
+                for (int k = 0; k < 4; ++k)
+                    for (int o = 0; o < outputs; ++o)
+                        results[k * outputs + o] = bias[o];
+                for (int i = 0; i < inputs; i += dense_rows)
+                {
+                    int rows = PRX_MINIMUM(dense_rows, inputs - i);
+                    bool last = i + rows == inputs;
+                    const float* w = weights + (size_t)i * outputs;
+                    int o = 0;
+                    for (; o + 16 <= outputs; o += 16)
+                        avx2_dense_batch_block<4, 2>(images + i, inputs, rows, w + o, outputs, relu && last, results + o, outputs);
+                    for (; o + 8 <= outputs; o += 8)
+                        avx2_dense_batch_block<4, 1>(images + i, inputs, rows, w + o, outputs, relu && last, results + o, outputs);
+                    for (; o + 4 <= outputs; o += 4)
+                        sse_dense_batch_block<4, 1>(images + i, inputs, rows, w + o, outputs, relu && last, results + o, outputs);
+                    if (o < outputs)
+                        dense_batch_tail(images + i, inputs, rows, w, o, outputs, relu && last, results, outputs);
+                }
+            }
+            for (; b < count; ++b)
+                avx2_dense(in + (size_t)b * inputs, inputs, weights, bias, outputs, relu, out + (size_t)b * outputs);
+        }
+
+        // The int8 kernels with the same row pairs, widened with a sign extending move so each group
+        // of 8 outputs is one 256 bit multiply-add.
+        template<int N>
+        PRX_AVX2 static inline void avx2_quantized_pair(int8_t first, int8_t second, const int8_t* w0, const int8_t* w1, __m256i* acc)
+        {
+            __m256i pair = _mm256_set1_epi32(quantized_pair(first, second));
+            for (int j = 0; j < N; ++j)
+            {
+                __m128i row0 = _mm_loadl_epi64((const __m128i*)(w0 + 8 * j));
+                __m128i row1 = w1 == NULL ? _mm_setzero_si128() : _mm_loadl_epi64((const __m128i*)(w1 + 8 * j));
+                __m256i words = _mm256_cvtepi8_epi16(_mm_unpacklo_epi8(row0, row1));
+                acc[j] = _mm256_add_epi32(acc[j], _mm256_madd_epi16(words, pair));
+            }
+        }
+
+        template<int N>
+        PRX_AVX2 static inline void avx2_quantized_rows(const int8_t* x, int n, const int8_t* w, int stride, __m256i* acc)
+        {
+            int i = 0;
+            for (; i + 2 <= n; i += 2)
+                if ((x[i] | x[i + 1]) != 0)
+                    avx2_quantized_pair<N>(x[i], x[i + 1], w + (size_t)i * stride, w + (size_t)(i + 1) * stride, acc);
+            if (i < n && x[i] != 0)
+                avx2_quantized_pair<N>(x[i], 0, w + (size_t)i * stride, NULL, acc);
+        }
+
+        template<int N>
+        PRX_AVX2 static inline void avx2_quantized_store(const __m256i* acc, const float* scales, const float* bias, bool relu, float* out)
+        {
+            for (int j = 0; j < N; ++j)
+            {
+                __m256 value = _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[j]), _mm256_loadu_ps(scales + 8 * j), _mm256_loadu_ps(bias + 8 * j));
+                if (relu)
+                    value = _mm256_max_ps(value, _mm256_setzero_ps());
+                _mm256_storeu_ps(out + 8 * j, value);
+            }
+        }
+
+        template<int N>
+        PRX_AVX2 static inline void avx2_quantized_block(const int8_t* in, int width, int channels, const int8_t* weights, const float* scales, const float* bias,
+                                                         int kernel, int filters, int pad, int y, int x,
+                                                         int ky_begin, int ky_end, int kx_begin, int kx_end, bool relu, float* o)
+        {
+            __m256i acc[N];
+            for (int j = 0; j < N; ++j)
+                acc[j] = _mm256_setzero_si256();
+            for (int ky = ky_begin; ky < ky_end; ++ky)
+                for (int kx = kx_begin; kx < kx_end; ++kx)
+                    avx2_quantized_rows<N>(in + ((y + ky - pad) * width + (x + kx - pad)) * channels, channels,
+                                           weights + (ky * kernel + kx) * channels * filters, filters, acc);
+            avx2_quantized_store<N>(acc, scales, bias, relu, o);
+        }
+
+        PRX_AVX2 static void avx2_quantized_convolution(const int8_t* in, int height, int width, int channels, const int8_t* weights,
+                                                        const float* scales, const float* bias, int kernel, int filters, bool relu, float* out)
+        {
+            int pad = (kernel - 1) / 2;
+            int32_t acc[8];
+            for (int y = 0; y < height; ++y)
+            {
+                int ky_begin, ky_end;
+                clip_kernel(y, pad, kernel, height, ky_begin, ky_end);
+                for (int x = 0; x < width; ++x)
+                {
+                    int kx_begin, kx_end;
+                    clip_kernel(x, pad, kernel, width, kx_begin, kx_end);
+                    float* o = out + (y * width + x) * filters;
+                    int f = 0;
+                    for (; f + 64 <= filters; f += 64)
+                        avx2_quantized_block<8>(in, width, channels, weights + f, scales + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    for (; f + 8 <= filters; f += 8)
+                        avx2_quantized_block<1>(in, width, channels, weights + f, scales + f, bias + f, kernel, filters, pad, y, x, ky_begin, ky_end, kx_begin, kx_end, relu, o + f);
+                    if (f < filters)
+                    {
+                        for (int k = 0; k < filters - f; ++k)
+                            acc[k] = 0;
+                        for (int ky = ky_begin; ky < ky_end; ++ky)
+                            for (int kx = kx_begin; kx < kx_end; ++kx)
+                                scalar_quantized_rows(in + ((y + ky - pad) * width + (x + kx - pad)) * channels, channels,
+                                                      weights + (ky * kernel + kx) * channels * filters + f, filters, filters - f, acc);
+                        scalar_quantized_store(acc, filters - f, scales + f, bias + f, relu, o + f);
+                    }
+                }
+            }
+        }
+
+        PRX_AVX2 static void avx2_quantized_dense(const int8_t* in, int inputs, const int8_t* weights, const float* scales, const float* bias,
+                                                  int outputs, bool relu, float* out)
+        {
+            int o = 0;
+            for (; o + 64 <= outputs; o += 64)
+            {
+                __m256i acc[8];
+                for (int j = 0; j < 8; ++j)
+                    acc[j] = _mm256_setzero_si256();
+                avx2_quantized_rows<8>(in, inputs, weights + o, outputs, acc);
+                avx2_quantized_store<8>(acc, scales + o, bias + o, relu, out + o);
+            }
+            for (; o + 8 <= outputs; o += 8)
+            {
+                __m256i acc[1] = {_mm256_setzero_si256()};
+                avx2_quantized_rows<1>(in, inputs, weights + o, outputs, acc);
+                avx2_quantized_store<1>(acc, scales + o, bias + o, relu, out + o);
+            }
+            if (o < outputs && outputs >= 8)
+            {
+                // the last 8 outputs, overlapping ones already stored, rather than a scalar pass over the weights
+                int last = outputs - 8;
+                __m256i acc[1] = {_mm256_setzero_si256()};
+                float stored[8];
+                avx2_quantized_rows<1>(in, inputs, weights + last, outputs, acc);
+                avx2_quantized_store<1>(acc, scales + last, bias + last, relu, stored);
+                for (; o < outputs; ++o)
+                    out[o] = stored[o - last];
+            }
+            else if (o < outputs)
+            {
+                int32_t acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+                scalar_quantized_rows(in, inputs, weights + o, outputs, outputs - o, acc);
+                scalar_quantized_store(acc, outputs - o, scales + o, bias + o, relu, out + o);
+            }
+        }
+
+#undef PRX_AVX2
+
+        static const classifier_kernels_t avx2_kernels = {"avx2", avx2_convolution, avx2_max_pool, avx2_dense, avx2_dense_batch,
+                                                          avx2_quantized_convolution, avx2_quantized_dense};
+
+        static bool cpu_has_avx2()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }
+#endif
+
+        const classifier_kernels_t& get_scalar_classifier_kernels()
+        {
+            return scalar_kernels;
+        }
+
+        const classifier_kernels_t& get_classifier_kernels()
+        {
+#ifdef PRX_CLASSIFIER_X86
+            static const classifier_kernels_t& best = cpu_has_avx2() ? avx2_kernels : sse_kernels;
+            return best;
+#else
+            return scalar_kernels;
+#endif
+        }
+
+        int get_available_classifier_kernels(const classifier_kernels_t** kernels, int max_count)
+        {
+            int count = 0;
+            if (count < max_count)
+                kernels[count++] = &scalar_kernels;
+#ifdef PRX_CLASSIFIER_X86
+            if (count < max_count)
+                kernels[count++] = &sse_kernels;
+            if (count < max_count && cpu_has_avx2())
+                kernels[count++] = &avx2_kernels;
+#endif
+            return count;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef PRX_UTIL_CLASSIFIER_KERNELS_HPP
+#define	PRX_UTIL_CLASSIFIER_KERNELS_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace prx
+{
+    namespace util
+    {
+        /**
+         * The inner loops of digit_classifier_t, with one implementation per instruction set.
+         * Activations are height x width x channels and every kernel applies its bias and,
+         * if asked, a ReLU while storing, so no layer makes a second pass over its output.
+         *
+         * @brief <b> Convolution, pooling and dense kernels for the digit classifier </b>
+         */
+        struct classifier_kernels_t
+        {
+            const char* name;
+
+            // SAME padded, stride 1 convolution with kernel x kernel x channels x filters weights
+            void (*convolution)(const float* in, int height, int width, int channels,
+                                const float* weights, const float* bias, int kernel, int filters, bool relu, float* out);
+
+            // 2x2 max pool with stride 2, the output is (height + 1) / 2 x (width + 1) / 2 x channels
+            void (*max_pool)(const float* in, int height, int width, int channels, float* out);
+
+            // out = in * weights + bias for inputs x outputs weights, weights are read in blocks of outputs
+            void (*dense)(const float* in, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out);
+
+            // dense for count images at once, in is count x inputs and out count x outputs; every row of
+            // weights read is applied to several images before moving on
+            void (*dense_batch)(const float* in, int count, int inputs, const float* weights, const float* bias, int outputs, bool relu, float* out);
+
+            // The int8 versions of convolution and dense. Products are summed in int32 and stored as
+            // sum * scales[o] + bias[o], where scales combines the input scale with the per output channel
+            // weight scale.
+            void (*quantized_convolution)(const int8_t* in, int height, int width, int channels, const int8_t* weights,
+                                          const float* scales, const float* bias, int kernel, int filters, bool relu, float* out);
+            void (*quantized_dense)(const int8_t* in, int inputs, const int8_t* weights, const float* scales, const float* bias,
+                                    int outputs, bool relu, float* out);
+        };
+
+        // portable C++, the reference for the vectorized kernels
+        const classifier_kernels_t& get_scalar_classifier_kernels();
+
+        // the widest kernels this CPU supports, chosen once with CPUID; not always the fastest on a small layer,
+        // so digit_classifier_t times them per layer
+        const classifier_kernels_t& get_classifier_kernels();
+
+        // every implementation this CPU can run, scalar first
+        int get_available_classifier_kernels(const classifier_kernels_t** kernels, int max_count);
+    }
+}
+
+#endif
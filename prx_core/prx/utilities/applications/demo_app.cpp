@@ -17,11 +17,15 @@
 
 #include "prx/utilities/communication/tf_broadcaster.hpp"
 
+#include <cstdio>
 #include <fstream>
+#include <sstream>
 #include "prx/utilities/definitions/sys_clock.hpp"
 #include <pluginlib/class_list_macros.h>
 #include "prx/utilities/definitions/random.hpp"
 #include <boost/assign/list_of.hpp>
+#include <osg/Image>
+#include <osgDB/ReadFile>
 
 PLUGINLIB_EXPORT_CLASS(prx::util::demo_application_t, prx::util::util_application_t)
 
@@ -32,14 +36,97 @@ namespace prx
     {
 
         demo_application_t::demo_application_t()
-        {}
+        {
+            native_sensing = true;
+        }
 
         demo_application_t::~demo_application_t()
         {}
 
-        std::pair<int, int> demo_application_t::sense(std::string sensing_image)
+        void demo_application_t::init(const parameter_reader_t * const reader)
+        {
+            util_application_t::init(reader);
+
+            //tf_model-8.weights is the deployed checkpoint exported by sensing/export_weights.py, it declares its own layers.
+            //classifier_layers is only needed for raw float files such as the checkpoint data shard itself.
+            //classifier_precision int8 loads the quantized archive written by classifier_benchmark instead.
+            native_sensing = reader->get_attribute_as<bool>("native_sensing", true);
+            if(native_sensing)
+            {
+                char* w = std::getenv("PRACSYS_PATH");
+                std::string precision = reader->get_attribute_as<std::string>("classifier_precision", "float32");
+                if(precision != "float32" && precision != "int8")
+                    PRX_FATAL_S("classifier_precision has to be float32 or int8, not "<<precision);
+                bool int8 = precision == "int8";
+                //Inputs are 1 on black cells and 0 elsewhere, as sense_environment.py computes them; continuous_luminance
+                //feeds the inverted luminance itself instead
+                preprocessor.set_integer_luminance(!reader->get_attribute_as<bool>("continuous_luminance", false));
+                std::string weights = reader->get_attribute_as<std::string>("classifier_weights", std::string(w) + (int8 ? "/prx_core/tf_model-8.int8.weights" : "/prx_core/tf_model-8.weights"));
+                std::string layers = reader->get_attribute_as<std::string>("classifier_layers", "dense 10");
+                sys_clock_t clock;
+                clock.reset();
+                classifier.set_layers(layers);
+                classifier.load_weights(weights);
+                if(classifier.get_output_size() != 10)
+                    PRX_FATAL_S("The digit classifier "<<weights<<" has "<<classifier.get_output_size()<<" outputs, sensing needs one per digit");
+                if(classifier.is_quantized() != int8)
+                    PRX_FATAL_S("classifier_precision is "<<precision<<" but "<<weights<<" has "<<(int8 ? "float32" : "int8")<<" weights");
+                PRX_PRINT("Loaded "<<precision<<" digit classifier from "<<weights<<" with "<<classifier.get_parameter_count()<<" parameters ("<<classifier.get_weight_bytes()<<" bytes) in "<<clock.measure()<<"s", PRX_TEXT_GREEN);
+            }
+        }
+
+        sensing_result_t demo_application_t::classify_image(const std::string& sensing_image)
+        {
+            osg::ref_ptr<osg::Image> image = osgDB::readImageFile(sensing_image);
+            if(!image.valid() || image->getDataType() != GL_UNSIGNED_BYTE)
+            {
+                PRX_WARN_S("Could not read the sensing image "<<sensing_image);
+                return sensing_result_t();
+            }
+            int channels = osg::Image::computeNumComponents(image->getPixelFormat());
+            bool bottom_up = image->getOrigin() == osg::Image::BOTTOM_LEFT;
+
+            //Area average to 28x28 and invert the luminance so ink is 1, in one pass over the frame
+            classifier_input.resize(classifier.get_input_size());
+            preprocessor.process(image->data(), image->s(), image->t(), channels, image->getRowSizeInBytes(), bottom_up, classifier_input.data());
+            float probabilities[10];
+            classifier.classify(classifier_input.data(), probabilities);
+            return rank_digits(probabilities);
+        }
+
+        sensing_result_t demo_application_t::classify_with_python(const std::string& sensing_image)
+        {
+            char* w = std::getenv("PRACSYS_PATH");
+            std::string filename(w);
+            filename += ("/prx_output/images/predict.ion");
+            //A prediction left from an earlier run must not pass for this one
+            std::remove(filename.c_str());
+            std::string command = "python $PRACSYS_PATH/prx_core/sensing/sense_environment.py "+sensing_image;
+            int status = std::system(command.c_str());
+            std::ifstream fin(filename);
+            int digit = -1;
+            if(status != 0 || !(fin >> digit) || digit < 0 || digit > 9)
+            {
+                PRX_WARN_S("sense_environment.py "<<(status != 0 ? "failed" : "wrote no digit")<<" for "<<sensing_image);
+                return sensing_result_t();
+            }
+            float probabilities[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+            probabilities[digit] = 1;
+            sensing_result_t result = rank_digits(probabilities);
+            result.candidates.resize(1);
+            return result;
+        }
+
+        void demo_application_t::report(const sensing_result_t& result, const std::string& source, double seconds)
+        {
+            std::stringstream digits;
+            for(auto& candidate : result.candidates)
+                digits<<" "<<candidate.digit<<" ("<<candidate.probability<<")";
+            PRX_PRINT("\n##########################\n##########################\nSensed Digits"<<(result.is_valid() ? digits.str() : " none")<<" in "<<source<<" in "<<seconds*1000<<" ms\n##########################\n##########################", PRX_TEXT_LIGHTGRAY);
+        }
+
+        sensing_result_t demo_application_t::sense(std::string sensing_image)
         {
-            int digit = 0;
             //Currently senses a random digit in the image.
             //#######################################################
             // digit = uniform_int_random(0,9);                      //#                                 
@@ -58,17 +145,27 @@ namespace prx
             //###############################################################
 
             //SENSE THE DIGIT IN FILE sensing_image
-            //digit = neural_network(sensing_image);
-            std::string command = "python $PRACSYS_PATH/prx_core/sensing/sense_environment.py "+sensing_image;
-            std::system(command.c_str());
-            std::ifstream fin;
-            char* w = std::getenv("PRACSYS_PATH");
-            std::string filename(w);
-            filename += ("/prx_output/images/predict.ion");
-			fin.open(filename);
-			fin >> digit;
-            PRX_PRINT("\n##########################\n##########################\nSensed Digit "<<digit<<" in image \n"<<sensing_image<<"\n##########################\n##########################", PRX_TEXT_LIGHTGRAY);
-            return digit_to_position[digit];
+            sys_clock_t clock;
+            clock.reset();
+            sensing_result_t result = native_sensing ? classify_image(sensing_image) : classify_with_python(sensing_image);
+            report(result, "image \n"+sensing_image, clock.measure());
+            return result;
+        }
+
+        sensing_result_t demo_application_t::sense(const shared_frame_t& frame)
+        {
+            if(!native_sensing)
+                PRX_FATAL_S("Sensing shared frames needs native_sensing, sense_environment.py only reads image files");
+            sys_clock_t clock;
+            clock.reset();
+            //The pixels are read in place from the shared mapping
+            classifier_input.resize(classifier.get_input_size());
+            preprocessor.process(frame.pixels, frame.width, frame.height, frame.channels, frame.row_bytes, frame.bottom_up, classifier_input.data());
+            float probabilities[10];
+            classifier.classify(classifier_input.data(), probabilities);
+            sensing_result_t result = rank_digits(probabilities);
+            report(result, "shared frame "+std::to_string(frame.sequence), clock.measure());
+            return result;
         }
     }
 }
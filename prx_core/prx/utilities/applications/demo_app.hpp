@@ -16,6 +16,8 @@
 #define	PRX_UTIL_DEMO_APPLICATION_HPP
 
 #include "prx/utilities/applications/application.hpp"
+#include "prx/utilities/applications/digit_classifier.hpp"
+#include "prx/utilities/applications/frame_preprocessor.hpp"
 
 
 #include <ros/ros.h>
@@ -40,8 +42,35 @@ namespace prx
             demo_application_t();
             virtual ~demo_application_t();
 
-            //Sense the scene and return the array indices of the next goal
-            std::pair<int, int> sense(std::string sensing_image);
+            /**
+             * @copydoc util_application_t::init()
+             * @note Also loads the digit classifier, once, from the "classifier_layers", "classifier_weights" and
+             * "classifier_precision" (float32 or int8) parameters
+             */
+            virtual void init(const util::parameter_reader_t * const reader);
+
+            //Sense the scene and return the most likely digits with their goals
+            sensing_result_t sense(std::string sensing_image);
+
+            //Classify a frame straight from the shared frame ring, needs native_sensing
+            sensing_result_t sense(const shared_frame_t& frame);
+
+          protected:
+            //Classifies the screenshot in process, empty if the image could not be read
+            sensing_result_t classify_image(const std::string& sensing_image);
+
+            //Runs sense_environment.py and reads back its prediction, used when native_sensing is off. The script only
+            //gives the best digit, which is reported with probability 1; empty if it failed or wrote no digit.
+            sensing_result_t classify_with_python(const std::string& sensing_image);
+
+            //Prints the sensed digits and how long sensing took
+            void report(const sensing_result_t& result, const std::string& source, double seconds);
+
+            digit_classifier_t classifier;
+            frame_preprocessor_t preprocessor;
+            //The classifier input, filled by the preprocessor straight from the decoded frame
+            std::vector<float> classifier_input;
+            bool native_sensing;
 
 
         };
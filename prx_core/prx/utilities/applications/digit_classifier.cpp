@@ -0,0 +1,610 @@
+#include "prx/utilities/applications/digit_classifier.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+#include "prx/utilities/definitions/sys_clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace prx
+{
+
+    namespace util
+    {
+        // round to the nearest int8, clamped to the symmetric range
+        static inline int8_t quantize_value(float value)
+        {
+            value = PRX_MAXIMUM(-127.0f, PRX_MINIMUM(127.0f, value));
+            return (int8_t)(value >= 0 ? value + 0.5f : value - 0.5f);
+        }
+
+        // images classify_batch runs through each layer together, enough for every weight read to be
+        // reused several times while its activations stay in cache
+        static const int batch_size = 64;
+
+        // seconds per call of run, the best of a few rounds of enough calls to be measurable
+        template <typename function_t>
+        static double time_calls(function_t run)
+        {
+            sys_clock_t clock;
+            clock.reset();
+            run();
+            double best = clock.measure();
+            int calls = PRX_MAXIMUM(1, PRX_MINIMUM(1000, (int)(1e-3 / PRX_MAXIMUM(best, 1e-9))));
+            for (int round = 0; round < 5; ++round)
+            {
+                clock.reset();
+                for (int c = 0; c < calls; ++c)
+                    run();
+                best = PRX_MINIMUM(best, clock.measure() / calls);
+            }
+            return best;
+        }
+
+        // a ring of ink like a written zero, about as sparse as an MNIST digit; the kernels skip zero inputs, so
+        // they have to be timed on something like what they will classify
+        static void probe_image(int height, int width, int channels, float* out)
+        {
+            float radius = 0.3f * PRX_MINIMUM(height, width);
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                {
+                    float distance = std::sqrt((y - 0.5f * height) * (y - 0.5f * height) + (x - 0.5f * width) * (x - 0.5f * width));
+                    for (int c = 0; c < channels; ++c)
+                        out[(y * width + x) * channels + c] = std::fabs(distance - radius) < 0.08f * radius + 1 ? 1.0f : 0.0f;
+                }
+        }
+
+        digit_classifier_t::digit_classifier_t()
+        {
+            input_height = 28;
+            input_width = 28;
+            input_channels = 1;
+            loaded = false;
+            quantized = false;
+            kernels = &get_classifier_kernels();
+            fixed_kernels = false;
+        }
+
+        digit_classifier_t::~digit_classifier_t() { }
+
+        void digit_classifier_t::set_kernels(const classifier_kernels_t& kernels)
+        {
+            this->kernels = &kernels;
+            fixed_kernels = true;
+            choose_kernels();
+        }
+
+        void digit_classifier_t::use_fastest_kernels()
+        {
+            kernels = &get_classifier_kernels();
+            fixed_kernels = false;
+            choose_kernels();
+        }
+
+        void digit_classifier_t::choose_kernels()
+        {
+            const classifier_kernels_t* available[8];
+            int available_count = fixed_kernels || !loaded ? 0 : get_available_classifier_kernels(available, 8);
+            if (available_count < 2)
+            {
+                for (unsigned l = 0; l < layers.size(); ++l)
+                    layers[l].kernels = layers[l].batch_kernels = kernels;
+                return;
+            }
+
+            // every layer is timed on what the layers before it make of the probe image
+            std::vector<float> probe(get_input_size()), batch_in, batch_out;
+            probe_image(input_height, input_width, input_channels, probe.data());
+            const float* in = probe.data();
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                layer_t& layer = layers[l];
+                float* out = activations[l % 2].data();
+                int inputs = layer.in_height * layer.in_width * layer.in_channels;
+                bool batched = layer.type == DENSE && !quantized;
+                if (batched)
+                {
+                    batch_in.resize((size_t)inputs * batch_size);
+                    for (int b = 0; b < batch_size; ++b)
+                        std::copy(in, in + inputs, batch_in.begin() + (size_t)b * inputs);
+                    batch_out.resize((size_t)layer.out_channels * batch_size);
+                }
+                double fastest = 0, fastest_batch = 0;
+                const classifier_kernels_t* best = kernels;
+                layer.batch_kernels = kernels;
+                for (int k = 0; k < available_count; ++k)
+                {
+                    const classifier_kernels_t* candidate = available[k];
+                    layer.kernels = candidate;
+                    double seconds = time_calls([&]() { run_layer(layer, in, out); });
+                    if (k == 0 || seconds < fastest)
+                    {
+                        fastest = seconds;
+                        best = candidate;
+                    }
+                    if (!batched)
+                        continue;
+                    seconds = time_calls([&]() {
+                        candidate->dense_batch(batch_in.data(), batch_size, inputs, layer.weights, layer.bias, layer.out_channels, layer.relu, batch_out.data());
+                    });
+                    if (k == 0 || seconds < fastest_batch)
+                    {
+                        fastest_batch = seconds;
+                        layer.batch_kernels = candidate;
+                    }
+                }
+                layer.kernels = best;
+                run_layer(layer, in, out);
+                in = out;
+            }
+        }
+
+        void digit_classifier_t::set_layers(const std::string& description)
+        {
+            layers.clear();
+            parameters.clear();
+            quantized_parameters.clear();
+            scale_parameters.clear();
+            archive.close();
+            loaded = false;
+            quantized = false;
+            this->description = description;
+
+            int height = input_height, width = input_width, channels = input_channels;
+            size_t largest = height * width * channels;
+
+            std::stringstream layer_stream(description);
+            std::string layer_description;
+            while (std::getline(layer_stream, layer_description, ','))
+            {
+                std::stringstream tokens(layer_description);
+                std::string type, activation;
+                if (!(tokens >> type))
+                    continue;
+
+                layer_t layer;
+                layer.in_height = height;
+                layer.in_width = width;
+                layer.in_channels = channels;
+                layer.kernel = 0;
+                layer.relu = false;
+                bool valid = true;
+                if (type == "conv")
+                {
+                    layer.type = CONVOLUTION;
+                    valid = (tokens >> layer.kernel >> layer.out_channels) && layer.kernel > 0 && layer.out_channels > 0;
+                    layer.out_height = height;
+                    layer.out_width = width;
+                }
+                else if (type == "pool")
+                {
+                    layer.type = MAX_POOL;
+                    layer.out_height = (height + 1) / 2;
+                    layer.out_width = (width + 1) / 2;
+                    layer.out_channels = channels;
+                }
+                else if (type == "dense")
+                {
+                    layer.type = DENSE;
+                    valid = (tokens >> layer.out_channels) && layer.out_channels > 0;
+                    layer.out_height = 1;
+                    layer.out_width = 1;
+                }
+                else
+                    valid = false;
+
+                if (valid && (tokens >> activation))
+                    valid = activation == "relu" && layer.type != MAX_POOL;
+                layer.relu = !activation.empty();
+                if (!valid)
+                    PRX_FATAL_S("Malformed classifier layer '" << layer_description << "' in '" << description << "'");
+
+                layer.weight_count = 0;
+                if (layer.type == CONVOLUTION)
+                    layer.weight_count = (size_t)layer.kernel * layer.kernel * layer.in_channels * layer.out_channels;
+                else if (layer.type == DENSE)
+                    layer.weight_count = (size_t)layer.in_height * layer.in_width * layer.in_channels * layer.out_channels;
+                layer.weights = layer.bias = NULL;
+                layer.quantized_weights = NULL;
+                layer.weight_scales = NULL;
+                layer.input_scale = 1;
+                layer.kernels = layer.batch_kernels = kernels;
+
+                height = layer.out_height;
+                width = layer.out_width;
+                channels = layer.out_channels;
+                largest = PRX_MAXIMUM(largest, (size_t)height * width * channels);
+                layers.push_back(layer);
+            }
+
+            if (layers.empty() || layers.back().type != DENSE)
+                PRX_FATAL_S("The classifier '" << description << "' has to end with a dense layer");
+
+            activations[0].assign(largest, 0);
+            activations[1].assign(largest, 0);
+            quantized_input.assign(largest, 0);
+            batch_activations[0].clear();
+            batch_activations[1].clear();
+        }
+
+        size_t digit_classifier_t::get_parameter_count() const
+        {
+            size_t count = 0;
+            for (unsigned l = 0; l < layers.size(); ++l)
+                if (layers[l].type != MAX_POOL)
+                    count += layers[l].weight_count + layers[l].out_channels;
+            return count;
+        }
+
+        size_t digit_classifier_t::get_weight_bytes() const
+        {
+            size_t bytes = 0;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                const layer_t& layer = layers[l];
+                if (layer.type == MAX_POOL)
+                    continue;
+                if (quantized)
+                    bytes += layer.weight_count + 2 * layer.out_channels * sizeof(float) + sizeof(float);
+                else
+                    bytes += (layer.weight_count + layer.out_channels) * sizeof(float);
+            }
+            return bytes;
+        }
+
+        int digit_classifier_t::get_output_size() const
+        {
+            return layers.empty() ? 0 : layers.back().out_channels;
+        }
+
+        void digit_classifier_t::load_weights(const std::string& file_path)
+        {
+            if (tensor_archive_t::is_archive(file_path))
+            {
+                load_archive(file_path);
+                return;
+            }
+
+            std::ifstream fin(file_path.c_str(), std::ios::binary | std::ios::ate);
+            if (!fin.good())
+                PRX_FATAL_S("Could not open classifier weights " << file_path);
+            size_t bytes = fin.tellg();
+            size_t expected = get_parameter_count() * sizeof(float);
+            if (bytes != expected)
+                PRX_FATAL_S("Classifier weights " << file_path << " have " << bytes << " bytes, the network needs " << expected);
+
+            archive.close();
+            quantized_parameters.clear();
+            scale_parameters.clear();
+            quantized = false;
+            parameters.resize(get_parameter_count());
+            fin.seekg(0);
+            fin.read((char*)parameters.data(), bytes);
+            if (!fin.good())
+                PRX_FATAL_S("Could not read classifier weights " << file_path);
+
+            const float* next = parameters.data();
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                if (layers[l].type == MAX_POOL)
+                    continue;
+                layers[l].weights = next;
+                layers[l].bias = next + layers[l].weight_count;
+                layers[l].quantized_weights = NULL;
+                layers[l].weight_scales = NULL;
+                next += layers[l].weight_count + layers[l].out_channels;
+            }
+            loaded = true;
+            choose_kernels();
+        }
+
+        void digit_classifier_t::load_archive(const std::string& file_path)
+        {
+            tensor_archive_t opened;
+            if (!opened.open(file_path))
+                PRX_FATAL_S("Classifier weights " << file_path << " are not a valid tensor archive");
+            if (!opened.get_description().empty())
+                set_layers(opened.get_description());
+            parameters.clear();
+            quantized_parameters.clear();
+            scale_parameters.clear();
+            loaded = false;
+            quantized = false;
+
+            // per convolution and dense layer in layer order: weights and bias, or int8 weights, weight
+            // scales, bias and input scale
+            const std::vector<tensor_archive_t::tensor_t>& tensors = opened.get_tensors();
+            bool int8 = !tensors.empty() && tensors[0].dtype == tensor_archive_t::INT8;
+            unsigned per_layer = int8 ? 4 : 2;
+            unsigned next = 0;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                layer_t& layer = layers[l];
+                if (layer.type == MAX_POOL)
+                    continue;
+                if (next + per_layer > tensors.size())
+                    PRX_FATAL_S("Classifier weights " << file_path << " have " << tensors.size() << " tensors, the network needs more");
+                const tensor_archive_t::tensor_t& weights = tensors[next++];
+                const tensor_archive_t::tensor_t* weight_scales = int8 ? &tensors[next++] : NULL;
+                const tensor_archive_t::tensor_t& bias = tensors[next++];
+                const tensor_archive_t::tensor_t* input_scale = int8 ? &tensors[next++] : NULL;
+                bool fits = weights.dtype == (int8 ? tensor_archive_t::INT8 : tensor_archive_t::FLOAT32) && weights.get_element_count() == layer.weight_count
+                    && bias.dtype == tensor_archive_t::FLOAT32 && bias.get_element_count() == (size_t)layer.out_channels;
+                if (int8)
+                    fits = fits && weight_scales->dtype == tensor_archive_t::FLOAT32 && weight_scales->get_element_count() == (size_t)layer.out_channels
+                        && input_scale->dtype == tensor_archive_t::FLOAT32 && input_scale->get_element_count() == 1;
+                if (!fits)
+                    PRX_FATAL_S("Tensors from " << weights.name << " to " << bias.name << " in " << file_path << " do not fit layer " << l);
+                layer.bias = (const float*)bias.data;
+                if (int8)
+                {
+                    layer.weights = NULL;
+                    layer.quantized_weights = (const int8_t*)weights.data;
+                    layer.weight_scales = (const float*)weight_scales->data;
+                    layer.input_scale = *(const float*)input_scale->data;
+                    layer.output_scales.resize(layer.out_channels);
+                    for (int o = 0; o < layer.out_channels; ++o)
+                        layer.output_scales[o] = layer.input_scale * layer.weight_scales[o];
+                }
+                else
+                {
+                    layer.weights = (const float*)weights.data;
+                    layer.quantized_weights = NULL;
+                    layer.weight_scales = NULL;
+                }
+            }
+            if (next != tensors.size())
+                PRX_WARN_S("Ignoring " << tensors.size() - next << " extra tensors in " << file_path);
+
+            archive.swap(opened);
+            loaded = true;
+            quantized = int8;
+            choose_kernels();
+        }
+
+        void digit_classifier_t::quantize(const float* images, int count)
+        {
+            if (!is_loaded() || layers.back().weights == NULL)
+                PRX_FATAL_S("The digit classifier needs float weights to quantize");
+            if (count <= 0)
+                PRX_FATAL_S("The digit classifier needs calibration images to quantize");
+
+            // the float network decides the input ranges, whatever is in use now
+            quantized = false;
+            std::vector<float> input_ranges(layers.size(), 0);
+            for (int i = 0; i < count; ++i)
+                forward(images + (size_t)i * get_input_size(), input_ranges.data());
+
+            size_t weight_count = 0, channel_count = 0;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                weight_count += layers[l].weight_count;
+                if (layers[l].type != MAX_POOL)
+                    channel_count += layers[l].out_channels;
+            }
+            quantized_parameters.resize(weight_count);
+            scale_parameters.resize(channel_count);
+
+            int8_t* next_weight = quantized_parameters.data();
+            float* next_scale = scale_parameters.data();
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                layer_t& layer = layers[l];
+                if (layer.type == MAX_POOL)
+                    continue;
+                // the output channel is the fastest changing index of both convolution and dense weights
+                int outputs = layer.out_channels;
+                size_t rows = layer.weight_count / outputs;
+                for (int o = 0; o < outputs; ++o)
+                {
+                    float largest = 0;
+                    for (size_t r = 0; r < rows; ++r)
+                        largest = PRX_MAXIMUM(largest, std::fabs(layer.weights[r * outputs + o]));
+                    next_scale[o] = largest > 0 ? largest / 127 : 1;
+                }
+                for (size_t r = 0; r < rows; ++r)
+                    for (int o = 0; o < outputs; ++o)
+                        next_weight[r * outputs + o] = quantize_value(layer.weights[r * outputs + o] / next_scale[o]);
+
+                layer.quantized_weights = next_weight;
+                layer.weight_scales = next_scale;
+                layer.input_scale = input_ranges[l] > 0 ? input_ranges[l] / 127 : 1;
+                layer.output_scales.resize(outputs);
+                for (int o = 0; o < outputs; ++o)
+                    layer.output_scales[o] = layer.input_scale * layer.weight_scales[o];
+                next_weight += layer.weight_count;
+                next_scale += outputs;
+            }
+            quantized = true;
+            choose_kernels();
+        }
+
+        void digit_classifier_t::set_quantized(bool quantized)
+        {
+            if (!is_loaded())
+                PRX_FATAL_S("The digit classifier has no weights");
+            if (quantized && layers.back().quantized_weights == NULL)
+                PRX_FATAL_S("The digit classifier has not been quantized");
+            if (!quantized && layers.back().weights == NULL)
+                PRX_FATAL_S("The digit classifier was loaded with int8 weights only");
+            this->quantized = quantized;
+            choose_kernels();
+        }
+
+        void digit_classifier_t::save_weights(const std::string& file_path) const
+        {
+            if (!is_loaded())
+                PRX_FATAL_S("The digit classifier has no weights");
+
+            std::vector<tensor_archive_t::tensor_t> tensors;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                const layer_t& layer = layers[l];
+                if (layer.type == MAX_POOL)
+                    continue;
+                std::stringstream prefix;
+                prefix << "layer" << l << "/";
+                std::vector<int64_t> channels(1, layer.out_channels);
+
+                tensor_archive_t::tensor_t weights;
+                weights.name = prefix.str() + "weights";
+                if (layer.type == CONVOLUTION)
+                {
+                    weights.shape.push_back(layer.kernel);
+                    weights.shape.push_back(layer.kernel);
+                    weights.shape.push_back(layer.in_channels);
+                }
+                else
+                    weights.shape.push_back(layer.in_height * layer.in_width * layer.in_channels);
+                weights.shape.push_back(layer.out_channels);
+                weights.dtype = quantized ? tensor_archive_t::INT8 : tensor_archive_t::FLOAT32;
+                weights.data = quantized ? (const void*)layer.quantized_weights : (const void*)layer.weights;
+                weights.bytes = layer.weight_count * (quantized ? sizeof(int8_t) : sizeof(float));
+                tensors.push_back(weights);
+
+                tensor_archive_t::tensor_t scales;
+                scales.name = prefix.str() + "weight_scales";
+                scales.dtype = tensor_archive_t::FLOAT32;
+                scales.shape = channels;
+                scales.data = layer.weight_scales;
+                scales.bytes = layer.out_channels * sizeof(float);
+                if (quantized)
+                    tensors.push_back(scales);
+
+                tensor_archive_t::tensor_t bias = scales;
+                bias.name = prefix.str() + "bias";
+                bias.data = layer.bias;
+                tensors.push_back(bias);
+
+                tensor_archive_t::tensor_t input_scale = scales;
+                input_scale.name = prefix.str() + "input_scale";
+                input_scale.shape.assign(1, 1);
+                input_scale.data = &layer.input_scale;
+                input_scale.bytes = sizeof(float);
+                if (quantized)
+                    tensors.push_back(input_scale);
+            }
+            if (!tensor_archive_t::write(file_path, description, tensors))
+                PRX_FATAL_S("Could not write classifier weights " << file_path);
+        }
+
+        void digit_classifier_t::run_layer(const layer_t& layer, const float* in, float* out)
+        {
+            int inputs = layer.in_height * layer.in_width * layer.in_channels;
+            if (quantized && layer.type != MAX_POOL)
+            {
+                float inverse = 1 / layer.input_scale;
+                for (int i = 0; i < inputs; ++i)
+                    quantized_input[i] = quantize_value(in[i] * inverse);
+            }
+
+            if (layer.type == CONVOLUTION && quantized)
+                layer.kernels->quantized_convolution(quantized_input.data(), layer.in_height, layer.in_width, layer.in_channels, layer.quantized_weights,
+                                               layer.output_scales.data(), layer.bias, layer.kernel, layer.out_channels, layer.relu, out);
+            else if (layer.type == CONVOLUTION)
+                layer.kernels->convolution(in, layer.in_height, layer.in_width, layer.in_channels, layer.weights, layer.bias, layer.kernel, layer.out_channels, layer.relu, out);
+            else if (layer.type == MAX_POOL)
+                layer.kernels->max_pool(in, layer.in_height, layer.in_width, layer.in_channels, out);
+            else if (quantized)
+                layer.kernels->quantized_dense(quantized_input.data(), inputs, layer.quantized_weights, layer.output_scales.data(), layer.bias, layer.out_channels, layer.relu, out);
+            else
+                layer.kernels->dense(in, inputs, layer.weights, layer.bias, layer.out_channels, layer.relu, out);
+        }
+
+        const float* digit_classifier_t::forward(const float* image, float* input_ranges)
+        {
+            const float* in = image;
+            float* out = NULL;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                out = activations[l % 2].data();
+                const layer_t& layer = layers[l];
+                if (input_ranges != NULL)
+                {
+                    int inputs = layer.in_height * layer.in_width * layer.in_channels;
+                    for (int i = 0; i < inputs; ++i)
+                        input_ranges[l] = PRX_MAXIMUM(input_ranges[l], std::fabs(in[i]));
+                }
+                run_layer(layer, in, out);
+                in = out;
+            }
+            return out;
+        }
+
+        int digit_classifier_t::softmax(const float* logits, float* probabilities) const
+        {
+            int outputs = get_output_size();
+            int best = 0;
+            for (int o = 1; o < outputs; ++o)
+                if (logits[o] > logits[best])
+                    best = o;
+
+            if (probabilities != NULL)
+            {
+                double sum = 0;
+                for (int o = 0; o < outputs; ++o)
+                    sum += std::exp(logits[o] - logits[best]);
+                for (int o = 0; o < outputs; ++o)
+                    probabilities[o] = std::exp(logits[o] - logits[best]) / sum;
+            }
+            return best;
+        }
+
+        int digit_classifier_t::classify(const float* image, float* probabilities)
+        {
+            if (!is_loaded())
+                PRX_FATAL_S("The digit classifier has no weights");
+            return softmax(forward(image, NULL), probabilities);
+        }
+
+        void digit_classifier_t::classify_batch(const float* images, int count, int* labels, float* confidences, float* probabilities)
+        {
+            if (!is_loaded())
+                PRX_FATAL_S("The digit classifier has no weights");
+
+            int image_size = get_input_size();
+            int outputs = get_output_size();
+            size_t largest = activations[0].size();
+            if (batch_activations[0].size() < largest * batch_size)
+            {
+                batch_activations[0].assign(largest * batch_size, 0);
+                batch_activations[1].assign(largest * batch_size, 0);
+            }
+            std::vector<float> image_probabilities(outputs);
+
+            for (int first = 0; first < count; first += batch_size)
+            {
+                int batch = PRX_MINIMUM(batch_size, count - first);
+                const float* in = images + (size_t)first * image_size;
+                size_t in_stride = image_size;
+                float* out = NULL;
+                // layer by layer over the whole batch; the float dense layers multiply the batch by their
+                // weights at once, everything else runs image by image
+                for (unsigned l = 0; l < layers.size(); ++l)
+                {
+                    const layer_t& layer = layers[l];
+                    out = batch_activations[l % 2].data();
+                    size_t out_stride = (size_t)layer.out_height * layer.out_width * layer.out_channels;
+                    if (layer.type == DENSE && !quantized)
+                        layer.batch_kernels->dense_batch(in, batch, (int)in_stride, layer.weights, layer.bias, layer.out_channels, layer.relu, out);
+                    else
+                        for (int b = 0; b < batch; ++b)
+                            run_layer(layer, in + b * in_stride, out + b * out_stride);
+                    in = out;
+                    in_stride = out_stride;
+                }
+
+                for (int b = 0; b < batch; ++b)
+                {
+                    int i = first + b;
+                    float* p = probabilities != NULL ? probabilities + (size_t)i * outputs : image_probabilities.data();
+                    labels[i] = softmax(out + (size_t)b * outputs, p);
+                    if (confidences != NULL)
+                        confidences[i] = p[labels[i]];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#ifndef PRX_UTIL_DIGIT_CLASSIFIER_HPP
+#define	PRX_UTIL_DIGIT_CLASSIFIER_HPP
+
+#include "prx/utilities/applications/classifier_kernels.hpp"
+#include "prx/utilities/applications/tensor_archive.hpp"
+
+#include <string>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        /**
+         * Native inference for the digit networks trained by the sensing scripts, so that sensing
+         * does not have to start python and TensorFlow. The network is a chain of layers on a
+         * 28x28x1 image, written as a comma separated description:
+         *
+         *   conv 5 32 relu, pool, conv 5 64 relu, pool, dense 1024 relu, dense 10
+         *
+         * "conv k n" is a k x k, SAME padded, stride 1 convolution with n filters, "pool" a 2x2
+         * max pool with stride 2 and "dense n" a fully connected layer with n outputs. The last
+         * layer is followed by a softmax. Activations are height x width x channels, as in TensorFlow.
+         *
+         * The network also runs with int8 weights: quantize calibrates it on sample images, or an archive
+         * written by save_weights after quantizing is loaded. Convolution and dense layers then quantize their
+         * input to int8 and sum the products in int32; activations between layers stay float.
+         *
+         * @brief <b> Digit classifier running a small convolutional network on the CPU </b>
+         */
+        class digit_classifier_t
+        {
+          public:
+            enum layer_type_t
+            {
+                CONVOLUTION, MAX_POOL, DENSE
+            };
+
+            digit_classifier_t();
+            virtual ~digit_classifier_t();
+
+            // replaces the network, reports a malformed description with PRX_FATAL_S
+            void set_layers(const std::string& description);
+
+            /**
+             * Loads the parameters of every layer, weights then bias, in layer order. Convolution weights are
+             * kernel height x kernel width x input channels x filters and dense weights inputs x outputs.
+             *
+             * The file is either a tensor archive written by sensing/export_weights.py or save_weights, which is mapped
+             * and used in place and replaces the layers with its own description if it has one, or raw float32 values.
+             * An archive of int8 weights has per output channel weight scales after each weight tensor and the scale
+             * of the layer input after each bias, and leaves the classifier quantized.
+             * Reports a file that does not fit the network with PRX_FATAL_S.
+             */
+            void load_weights(const std::string& file_path);
+
+            /**
+             * Builds the int8 weights from the float ones and switches to them. The float network is run on count
+             * images to find the largest input of every convolution and dense layer, which sets the input scale,
+             * and every output channel of the weights is scaled so its largest weight is 127.
+             */
+            void quantize(const float* images, int count);
+
+            // switch between the float and int8 weights, reports weights that are not loaded with PRX_FATAL_S
+            void set_quantized(bool quantized);
+            bool is_quantized() const { return quantized; }
+
+            // writes the weights in use to a tensor archive that load_weights reads
+            void save_weights(const std::string& file_path) const;
+
+            // classify a height x width image with values in [0,1] (1 is ink); probabilities, if given,
+            // receives the softmax output
+            int classify(const float* image, float* probabilities = NULL);
+
+            /**
+             * Classifies count images stored one after the other, giving the same labels as classify. The
+             * images go through the network in batches, so the float dense layers read their weights once per
+             * batch instead of once per image.
+             *
+             * @param labels Receives count labels.
+             * @param confidences If given, receives the probability of every label.
+             * @param probabilities If given, receives count rows of the softmax output.
+             */
+            void classify_batch(const float* images, int count, int* labels, float* confidences = NULL, float* probabilities = NULL);
+
+            /**
+             * By default every layer runs the kernels measured fastest on its shape, timed whenever weights are
+             * loaded, quantized or switched; a dense layer with few outputs is often faster in scalar code than
+             * in wide vectors. set_kernels fixes the kernels of every layer instead, and use_fastest_kernels goes
+             * back to measuring.
+             */
+            void set_kernels(const classifier_kernels_t& kernels);
+            void use_fastest_kernels();
+            const classifier_kernels_t& get_kernels() const { return *kernels; }
+            // what layer l runs with in classify
+            const classifier_kernels_t& get_layer_kernels(unsigned layer) const { return *layers[layer].kernels; }
+            unsigned get_layer_count() const { return layers.size(); }
+
+            bool is_loaded() const { return loaded; }
+            int get_input_size() const { return input_height * input_width * input_channels; }
+            int get_output_size() const;
+            size_t get_parameter_count() const;
+            // bytes of the weights, scales and biases classify reads
+            size_t get_weight_bytes() const;
+
+          protected:
+            struct layer_t
+            {
+                layer_type_t type;
+                int in_height, in_width, in_channels;
+                int out_height, out_width, out_channels;
+                int kernel;
+                bool relu;
+                size_t weight_count;
+                // into parameters or the archive
+                const float* weights;
+                const float* bias;
+                // int8 weights with one scale per output channel, NULL until quantized
+                const int8_t* quantized_weights;
+                const float* weight_scales;
+                float input_scale;
+                // input_scale * weight_scales, what the int8 kernels multiply their sums by
+                std::vector<float> output_scales;
+                // the kernels of classify, and of classify_batch for float dense layers
+                const classifier_kernels_t* kernels;
+                const classifier_kernels_t* batch_kernels;
+            };
+
+            void load_archive(const std::string& file_path);
+            // runs the network and returns the logits; input_ranges, if given, grows to the largest
+            // absolute input of every layer
+            const float* forward(const float* image, float* input_ranges);
+            // times every available kernel set on every layer and keeps the fastest, unless set_kernels fixed them
+            void choose_kernels();
+            // one layer on one image
+            void run_layer(const layer_t& layer, const float* in, float* out);
+            // the label of the logits, and their softmax if probabilities is given
+            int softmax(const float* logits, float* probabilities) const;
+
+            int input_height, input_width, input_channels;
+            // as given to set_layers, saved with the weights
+            std::string description;
+            std::vector<layer_t> layers;
+            bool loaded;
+            bool quantized;
+            const classifier_kernels_t* kernels;
+            bool fixed_kernels;
+            // raw weights are copied here, archive weights stay in the mapping
+            std::vector<float> parameters;
+            tensor_archive_t archive;
+            // weights and weight scales built by quantize
+            std::vector<int8_t> quantized_parameters;
+            std::vector<float> scale_parameters;
+            // ping-pong buffers sized for the largest activation, so classify does not allocate
+            std::vector<float> activations[2];
+            std::vector<int8_t> quantized_input;
+            // the activations of a batch of images, allocated by the first classify_batch
+            std::vector<float> batch_activations[2];
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "prx/utilities/applications/digit_layout.hpp"
+#include "prx/utilities/definitions/random.hpp"
+
+#include <algorithm>
+
+namespace prx
+{
+
+    namespace util
+    {
+        void digit_layout_t::generate(const occupancy_grid_t* maze)
+        {
+            block_digits.clear();
+            locations.clear();
+            int num_obs = 1;
+            for (int i = 0; i < maze->get_rows(); ++i)
+            {
+                for (int j = 0; j < maze->get_columns(); ++j)
+                {
+                    if (!maze->is_free(i, j))
+                    {
+                        int first = uniform_int_random(0, 9);
+                        int second = uniform_int_random(0, 9);
+                        int third = uniform_int_random(0, 9);
+                        block_digits.push_back(std::make_tuple(first, second, third));
+                        if (j != 0 && maze->is_free(i, j - 1))
+                            locations.push_back(std::make_tuple(i, j - 1, num_obs));
+                        num_obs++;
+                    }
+                }
+            }
+
+            sequence = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+            std::random_shuffle(sequence.begin(), sequence.end());
+            std::random_shuffle(locations.begin(), locations.end());
+            if (locations.size() > 10)
+                locations.resize(10);
+
+            digit_to_position.clear();
+            for (auto digit : sequence)
+                digit_to_position[digit] = std::make_pair(0, 0);
+            for (unsigned k = 0; k < locations.size(); ++k)
+                digit_to_position[sequence[k]] = std::make_pair(std::get<0>(locations[k]), std::get<1>(locations[k]));
+            sequence.resize(locations.size());
+        }
+
+        int digit_layout_t::get_next_digit(int digit) const
+        {
+            auto found = std::find(sequence.begin(), sequence.end(), digit);
+            if (found == sequence.end())
+                return -1;
+            return ++found == sequence.end() ? sequence.front() : *found;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef PRX_UTIL_DIGIT_LAYOUT_HPP
+#define	PRX_UTIL_DIGIT_LAYOUT_HPP
+
+#include "prx/utilities/applications/occupancy_grid.hpp"
+
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        // The random part of build_environment. Every block gets a mesh of three random digits, and up to ten
+        // digits are put on free cells right of a block, in a random order. The block beside the cell of
+        // sequence[k] shows sequence[k + 1], the last wrapping around to the first, so sensing there gives the
+        // next goal. The draws are made in the order build_environment makes them, with the generator of
+        // random.hpp, so the same seed gives the same layout in the node and in a headless run.
+        class digit_layout_t
+        {
+          public:
+            // draw the layout for a maze
+            void generate(const occupancy_grid_t* maze);
+
+            // the three digits of every block mesh, blocks in row-major order
+            const std::vector< std::tuple<int, int, int> >& get_block_digits() const { return block_digits; }
+
+            // (i, j, 1-based block number) of the cell of every digit in the sequence
+            const std::vector< std::tuple<int, int, int> >& get_locations() const { return locations; }
+
+            // the digits in the order they are visited, as many as there are locations
+            const std::vector<int>& get_sequence() const { return sequence; }
+
+            // the cell of every digit, (0, 0) for digits that did not get a location
+            const std::map<int, std::pair<int, int> >& get_digit_to_position() const { return digit_to_position; }
+
+            // the digit shown beside the cell of digit "digit", -1 if the digit has no location
+            int get_next_digit(int digit) const;
+
+          private:
+            std::vector< std::tuple<int, int, int> > block_digits;
+            std::vector< std::tuple<int, int, int> > locations;
+            std::vector<int> sequence;
+            std::map<int, std::pair<int, int> > digit_to_position;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,502 @@
+#include "prx/utilities/applications/digit_trainer.hpp"
+#include "prx/utilities/applications/idx_file.hpp"
+#include "prx/utilities/applications/tensor_archive.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+#include "prx/utilities/definitions/random.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace prx
+{
+
+    namespace util
+    {
+        // parameters each task of the gradient reduction sums
+        static const size_t reduction_chunk = 1 << 14;
+        // images each task of evaluate runs
+        static const size_t evaluation_chunk = 100;
+
+        static inline uint64_t mix_bits(uint64_t value)
+        {
+            value += 0x9e3779b97f4a7c15ull;
+            value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+            value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+            return value ^ (value >> 31);
+        }
+
+        // a normal sample from init_random, redrawn until it is within two deviations
+        static double truncated_normal(double deviation)
+        {
+            while (true)
+            {
+                double u = uniform_random(), v = uniform_random();
+                if (u <= 0)
+                    continue;
+                double sample = std::sqrt(-2 * std::log(u)) * std::cos(2 * PRX_PI * v);
+                if (std::fabs(sample) <= 2)
+                    return deviation * sample;
+            }
+        }
+
+        digit_trainer_t::digit_trainer_t()
+        {
+            pool = NULL;
+            kernels = &get_classifier_kernels();
+            order_first = order_position = 0;
+            step = 0;
+        }
+
+        digit_trainer_t::~digit_trainer_t()
+        {
+            delete pool;
+        }
+
+        void digit_trainer_t::set_settings(const settings_t& settings)
+        {
+            if (settings.batch_size <= 0 || settings.shard_size <= 0 || settings.learning_rate <= 0)
+                PRX_FATAL_S("The digit trainer needs a positive batch size, shard size and learning rate");
+            bool new_pool = pool == NULL || settings.threads != this->settings.threads;
+            this->settings = settings;
+            if (new_pool)
+                make_pool();
+        }
+
+        void digit_trainer_t::make_pool()
+        {
+            delete pool;
+            pool = new thread_pool_t(settings.threads);
+            workspaces.resize(pool->get_thread_count());
+        }
+
+        void digit_trainer_t::set_layers(const std::string& description)
+        {
+            layers.clear();
+            parameters.clear();
+            shard_gradients.clear();
+            inference_description.clear();
+            if (pool == NULL)
+                make_pool();
+
+            int height = 28, width = 28, channels = 1;
+            size_t count = 0;
+            std::stringstream layer_stream(description);
+            std::string layer_description;
+            while (std::getline(layer_stream, layer_description, ','))
+            {
+                std::stringstream tokens(layer_description);
+                std::string type, activation;
+                if (!(tokens >> type))
+                    continue;
+
+                layer_t layer;
+                layer.in_height = layer.out_height = height;
+                layer.in_width = layer.out_width = width;
+                layer.in_channels = layer.out_channels = channels;
+                layer.kernel = 0;
+                layer.drop_rate = 0;
+                bool valid = true;
+                if (type == "conv")
+                {
+                    layer.type = CONVOLUTION;
+                    valid = (tokens >> layer.kernel >> layer.out_channels) && layer.kernel > 0 && layer.out_channels > 0;
+                }
+                else if (type == "pool")
+                {
+                    layer.type = MAX_POOL;
+                    layer.out_height = (height + 1) / 2;
+                    layer.out_width = (width + 1) / 2;
+                }
+                else if (type == "dense")
+                {
+                    layer.type = DENSE;
+                    valid = (tokens >> layer.out_channels) && layer.out_channels > 0;
+                    layer.out_height = layer.out_width = 1;
+                }
+                else if (type == "dropout")
+                {
+                    layer.type = DROPOUT;
+                    valid = (tokens >> layer.drop_rate) && layer.drop_rate >= 0 && layer.drop_rate < 1;
+                }
+                else
+                    valid = false;
+
+                if (valid && (tokens >> activation))
+                    valid = activation == "relu" && (layer.type == CONVOLUTION || layer.type == DENSE);
+                layer.relu = !activation.empty();
+                if (!valid)
+                    PRX_FATAL_S("Malformed trainer layer '" << layer_description << "' in '" << description << "'");
+
+                layer.weights_size = 0;
+                if (layer.type == CONVOLUTION)
+                    layer.weights_size = (size_t)layer.kernel * layer.kernel * layer.in_channels * layer.out_channels;
+                else if (layer.type == DENSE)
+                    layer.weights_size = layer.get_inputs() * layer.out_channels;
+                layer.weights_offset = count;
+                if (layer.weights_size > 0)
+                    count += layer.weights_size + layer.out_channels;
+
+                if (layer.type != DROPOUT)
+                    inference_description += (inference_description.empty() ? "" : ", ") + layer_description.substr(layer_description.find(type));
+                height = layer.out_height;
+                width = layer.out_width;
+                channels = layer.out_channels;
+                layers.push_back(layer);
+            }
+
+            if (layers.empty() || layers.back().type != DENSE)
+                PRX_FATAL_S("The network '" << description << "' has to end with a dense layer");
+            parameters.assign(count, 0);
+            for (unsigned t = 0; t < workspaces.size(); ++t)
+                workspaces[t].activations.clear();
+        }
+
+        void digit_trainer_t::initialize()
+        {
+            init_random(settings.seed);
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                const layer_t& layer = layers[l];
+                if (layer.weights_size == 0)
+                    continue;
+                float* weights = &parameters[layer.weights_offset];
+                for (size_t i = 0; i < layer.weights_size; ++i)
+                    weights[i] = truncated_normal(0.1);
+                std::fill(weights + layer.weights_size, weights + layer.weights_size + layer.out_channels, layer.relu ? 0.1f : 0.0f);
+            }
+            order.clear();
+            order_position = 0;
+            step = 0;
+        }
+
+        float digit_trainer_t::get_dropout_scale(const layer_t& layer, unsigned layer_index, int step, size_t image_index, size_t unit) const
+        {
+            uint64_t key = mix_bits(mix_bits(mix_bits(mix_bits((uint64_t)settings.seed) ^ step) ^ image_index) ^ layer_index) ^ unit;
+            double sample = (mix_bits(key) >> 11) * (1.0 / 9007199254740992.0);
+            return sample < layer.drop_rate ? 0 : 1 / (1 - layer.drop_rate);
+        }
+
+        const float* digit_trainer_t::forward(workspace_t& workspace, const unsigned char* image, int step, size_t image_index)
+        {
+            std::vector<std::vector<float> >& activations = workspace.activations;
+            if (activations.size() != layers.size() + 1)
+            {
+                activations.resize(layers.size() + 1);
+                activations[0].resize(layers[0].get_inputs());
+                size_t largest = 0;
+                for (unsigned l = 0; l < layers.size(); ++l)
+                {
+                    activations[l + 1].resize(layers[l].get_outputs());
+                    largest = PRX_MAXIMUM(largest, PRX_MAXIMUM(layers[l].get_inputs(), layers[l].get_outputs()));
+                }
+                workspace.gradient.resize(largest);
+                workspace.previous_gradient.resize(largest);
+            }
+
+            for (size_t i = 0; i < activations[0].size(); ++i)
+                activations[0][i] = image[i] / 255.0f;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                const layer_t& layer = layers[l];
+                const float* in = activations[l].data();
+                float* out = activations[l + 1].data();
+                const float* weights = parameters.data() + layer.weights_offset;
+                const float* bias = weights + layer.weights_size;
+                if (layer.type == CONVOLUTION)
+                    kernels->convolution(in, layer.in_height, layer.in_width, layer.in_channels, weights, bias, layer.kernel, layer.out_channels, layer.relu, out);
+                else if (layer.type == MAX_POOL)
+                    kernels->max_pool(in, layer.in_height, layer.in_width, layer.in_channels, out);
+                else if (layer.type == DENSE)
+                    kernels->dense(in, layer.get_inputs(), weights, bias, layer.out_channels, layer.relu, out);
+                else
+                {
+                    size_t count = layer.get_outputs();
+                    for (size_t i = 0; i < count; ++i)
+                        out[i] = step == 0 ? in[i] : in[i] * get_dropout_scale(layer, l, step, image_index, i);
+                }
+            }
+            return activations.back().data();
+        }
+
+        double digit_trainer_t::backward(workspace_t& workspace, int label, int step, size_t image_index, float* gradients, bool& correct)
+        {
+            std::vector<std::vector<float> >& activations = workspace.activations;
+            const std::vector<float>& logits = activations.back();
+            int outputs = logits.size();
+            int best = 0;
+            for (int o = 1; o < outputs; ++o)
+                if (logits[o] > logits[best])
+                    best = o;
+            correct = best == label;
+
+            // softmax cross entropy: the gradient of the logits is the softmax minus the one-hot label
+            double sum = 0;
+            for (int o = 0; o < outputs; ++o)
+                sum += std::exp(logits[o] - logits[best]);
+            float* gradient = workspace.gradient.data();
+            for (int o = 0; o < outputs; ++o)
+                gradient[o] = std::exp(logits[o] - logits[best]) / sum - (o == label);
+            double loss = std::log(sum) - (logits[label] - logits[best]);
+
+            for (int l = layers.size() - 1; l >= 0; --l)
+            {
+                const layer_t& layer = layers[l];
+                const float* in = activations[l].data();
+                const float* out = activations[l + 1].data();
+                size_t inputs = layer.get_inputs(), count = layer.get_outputs();
+                // the first layer does not need the gradient of the image
+                bool propagate = l > 0;
+                float* in_gradient = workspace.previous_gradient.data();
+                if (layer.relu)
+                    for (size_t o = 0; o < count; ++o)
+                        gradient[o] = out[o] > 0 ? gradient[o] : 0;
+
+                const float* weights = parameters.data() + layer.weights_offset;
+                float* weight_gradients = gradients + layer.weights_offset;
+                float* bias_gradients = weight_gradients + layer.weights_size;
+                if (layer.type == DENSE)
+                {
+                    int filters = layer.out_channels;
+                    for (int f = 0; f < filters; ++f)
+                        bias_gradients[f] += gradient[f];
+                    for (size_t i = 0; i < inputs; ++i)
+                    {
+                        const float* w = weights + i * filters;
+                        float* g = weight_gradients + i * filters;
+                        float value = in[i], back = 0;
+                        for (int f = 0; f < filters; ++f)
+                        {
+                            g[f] += value * gradient[f];
+                            back += w[f] * gradient[f];
+                        }
+                        if (propagate)
+                            in_gradient[i] = back;
+                    }
+                }
+                else if (layer.type == CONVOLUTION)
+                {
+                    int height = layer.in_height, width = layer.in_width, channels = layer.in_channels;
+                    int kernel = layer.kernel, filters = layer.out_channels, pad = (kernel - 1) / 2;
+                    if (propagate)
+                        std::fill(in_gradient, in_gradient + inputs, 0.0f);
+                    for (int y = 0; y < height; ++y)
+                    {
+                        for (int x = 0; x < width; ++x)
+                        {
+                            const float* g_out = gradient + (y * width + x) * filters;
+                            for (int f = 0; f < filters; ++f)
+                                bias_gradients[f] += g_out[f];
+                            for (int ky = PRX_MAXIMUM(0, pad - y); ky < PRX_MINIMUM(kernel, height + pad - y); ++ky)
+                            {
+                                for (int kx = PRX_MAXIMUM(0, pad - x); kx < PRX_MINIMUM(kernel, width + pad - x); ++kx)
+                                {
+                                    size_t pixel = ((y + ky - pad) * width + (x + kx - pad)) * channels;
+                                    size_t tap = (ky * kernel + kx) * channels * filters;
+                                    for (int c = 0; c < channels; ++c)
+                                    {
+                                        const float* w = weights + tap + c * filters;
+                                        float* g = weight_gradients + tap + c * filters;
+                                        float value = in[pixel + c], back = 0;
+                                        for (int f = 0; f < filters; ++f)
+                                        {
+                                            g[f] += value * g_out[f];
+                                            back += w[f] * g_out[f];
+                                        }
+                                        if (propagate)
+                                            in_gradient[pixel + c] += back;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                else if (layer.type == MAX_POOL)
+                {
+                    int width = layer.in_width, channels = layer.in_channels;
+                    std::fill(in_gradient, in_gradient + inputs, 0.0f);
+                    for (int y = 0; y < layer.out_height; ++y)
+                    {
+                        for (int x = 0; x < layer.out_width; ++x)
+                        {
+                            // the gradient goes to the input the maximum came from
+                            bool right = 2 * x + 1 < width, down = 2 * y + 1 < layer.in_height;
+                            size_t corner = (2 * y * width + 2 * x) * channels;
+                            size_t candidates[4] = {corner, corner + channels, corner + width * channels, corner + (width + 1) * channels};
+                            bool used[4] = {true, right, down, right && down};
+                            for (int c = 0; c < channels; ++c)
+                            {
+                                size_t source = candidates[0] + c;
+                                for (int k = 1; k < 4; ++k)
+                                    if (used[k] && in[candidates[k] + c] > in[source])
+                                        source = candidates[k] + c;
+                                in_gradient[source] += gradient[(y * layer.out_width + x) * channels + c];
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    for (size_t i = 0; i < count; ++i)
+                        in_gradient[i] = gradient[i] * get_dropout_scale(layer, l, step, image_index, i);
+                }
+                workspace.gradient.swap(workspace.previous_gradient);
+                gradient = workspace.gradient.data();
+            }
+            return loss;
+        }
+
+        void digit_trainer_t::train(const idx_dataset_t& data, size_t first, size_t count, int steps)
+        {
+            if (layers.empty() || count == 0 || first + count > data.get_count())
+                PRX_FATAL_S("The digit trainer needs a network and images " << first << " to " << first + count << " of " << data.get_count());
+            if ((size_t)data.get_rows() * data.get_columns() != layers[0].get_inputs())
+                PRX_FATAL_S("The digit trainer takes " << layers[0].get_inputs() << " pixel images, not " << data.get_rows() << "x" << data.get_columns());
+
+            int batch_size = settings.batch_size;
+            int shard_count = (batch_size + settings.shard_size - 1) / settings.shard_size;
+            shard_gradients.resize(shard_count);
+            for (int s = 0; s < shard_count; ++s)
+                shard_gradients[s].resize(parameters.size());
+            std::vector<size_t> batch(batch_size);
+            std::vector<double> shard_losses(shard_count);
+            std::vector<int> shard_correct(shard_count);
+            double interval_loss = 0;
+            int interval_correct = 0, interval_images = 0;
+            float step_size = settings.learning_rate / batch_size;
+            size_t chunks = (parameters.size() + reduction_chunk - 1) / reduction_chunk;
+
+            for (int s = 0; s < steps; ++s)
+            {
+                // the next batch_size images of the epoch, reshuffling the order when it runs out
+                for (int b = 0; b < batch_size; ++b)
+                {
+                    if (order_position == order.size() || order.size() != count || order_first != first)
+                    {
+                        if (order.size() != count || order_first != first)
+                        {
+                            order.resize(count);
+                            for (size_t i = 0; i < count; ++i)
+                                order[i] = first + i;
+                            order_first = first;
+                        }
+                        for (size_t i = count - 1; i > 0; --i)
+                            std::swap(order[i], order[uniform_int_random(0, i)]);
+                        order_position = 0;
+                    }
+                    batch[b] = order[order_position++];
+                }
+
+                int current = step + 1;
+                pool->run(shard_count, [&](int shard, unsigned thread)
+                {
+                    std::vector<float>& gradients = shard_gradients[shard];
+                    std::fill(gradients.begin(), gradients.end(), 0.0f);
+                    shard_losses[shard] = 0;
+                    shard_correct[shard] = 0;
+                    int end = PRX_MINIMUM(batch_size, (shard + 1) * settings.shard_size);
+                    for (int b = shard * settings.shard_size; b < end; ++b)
+                    {
+                        bool correct;
+                        forward(workspaces[thread], data.get_image(batch[b]), current, b);
+                        shard_losses[shard] += backward(workspaces[thread], data.get_label(batch[b]), current, b, gradients.data(), correct);
+                        shard_correct[shard] += correct;
+                    }
+                });
+                pool->run(chunks, [&](int chunk, unsigned)
+                {
+                    size_t end = PRX_MINIMUM(parameters.size(), (chunk + 1) * reduction_chunk);
+                    for (size_t p = chunk * reduction_chunk; p < end; ++p)
+                    {
+                        float sum = 0;
+                        for (int shard = 0; shard < shard_count; ++shard)
+                            sum += shard_gradients[shard][p];
+                        parameters[p] -= step_size * sum;
+                    }
+                });
+                step = current;
+
+                for (int shard = 0; shard < shard_count; ++shard)
+                {
+                    interval_loss += shard_losses[shard];
+                    interval_correct += shard_correct[shard];
+                }
+                interval_images += batch_size;
+                if (settings.log_interval > 0 && (step % settings.log_interval == 0 || s == steps - 1))
+                {
+                    PRX_PRINT("Step " << step << ": loss " << interval_loss / interval_images << ", training accuracy "
+                              << interval_correct / (double)interval_images, PRX_TEXT_CYAN);
+                    interval_loss = 0;
+                    interval_correct = interval_images = 0;
+                }
+            }
+        }
+
+        double digit_trainer_t::evaluate(const idx_dataset_t& data, size_t first, size_t count)
+        {
+            if (layers.empty() || count == 0 || first + count > data.get_count())
+                PRX_FATAL_S("The digit trainer needs a network and images " << first << " to " << first + count << " of " << data.get_count());
+            size_t chunks = (count + evaluation_chunk - 1) / evaluation_chunk;
+            std::vector<int> chunk_correct(chunks);
+            pool->run(chunks, [&](int chunk, unsigned thread)
+            {
+                chunk_correct[chunk] = 0;
+                size_t end = PRX_MINIMUM(count, (chunk + 1) * evaluation_chunk);
+                for (size_t i = chunk * evaluation_chunk; i < end; ++i)
+                {
+                    const float* logits = forward(workspaces[thread], data.get_image(first + i), 0, i);
+                    int outputs = layers.back().out_channels;
+                    chunk_correct[chunk] += std::max_element(logits, logits + outputs) - logits == data.get_label(first + i);
+                }
+            });
+            int correct = 0;
+            for (size_t c = 0; c < chunks; ++c)
+                correct += chunk_correct[c];
+            return correct / (double)count;
+        }
+
+        void digit_trainer_t::save_weights(const std::string& file_path) const
+        {
+            // the layers digit_classifier_t numbers, without dropout
+            std::vector<tensor_archive_t::tensor_t> tensors;
+            int index = 0;
+            for (unsigned l = 0; l < layers.size(); ++l)
+            {
+                const layer_t& layer = layers[l];
+                if (layer.type == DROPOUT)
+                    continue;
+                if (layer.weights_size > 0)
+                {
+                    std::stringstream prefix;
+                    prefix << "layer" << index << "/";
+                    tensor_archive_t::tensor_t weights;
+                    weights.name = prefix.str() + "weights";
+                    weights.dtype = tensor_archive_t::FLOAT32;
+                    if (layer.type == CONVOLUTION)
+                    {
+                        weights.shape.push_back(layer.kernel);
+                        weights.shape.push_back(layer.kernel);
+                        weights.shape.push_back(layer.in_channels);
+                    }
+                    else
+                        weights.shape.push_back(layer.get_inputs());
+                    weights.shape.push_back(layer.out_channels);
+                    weights.data = &parameters[layer.weights_offset];
+                    weights.bytes = layer.weights_size * sizeof(float);
+                    tensors.push_back(weights);
+
+                    tensor_archive_t::tensor_t bias = weights;
+                    bias.name = prefix.str() + "bias";
+                    bias.shape.assign(1, layer.out_channels);
+                    bias.data = &parameters[layer.weights_offset + layer.weights_size];
+                    bias.bytes = layer.out_channels * sizeof(float);
+                    tensors.push_back(bias);
+                }
+                ++index;
+            }
+            if (!tensor_archive_t::write(file_path, inference_description, tensors))
+                PRX_FATAL_S("Could not write trained weights " << file_path);
+        }
+    }
+}
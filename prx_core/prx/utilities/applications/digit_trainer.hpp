@@ -0,0 +1,141 @@
+#pragma once
+
+#ifndef PRX_UTIL_DIGIT_TRAINER_HPP
+#define	PRX_UTIL_DIGIT_TRAINER_HPP
+
+#include "prx/utilities/applications/classifier_kernels.hpp"
+#include "prx/utilities/definitions/thread_pool.hpp"
+
+#include <string>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        class idx_dataset_t;
+
+        /**
+         * Trains the networks digit_classifier_t runs, without python or TensorFlow, by mini-batch SGD on
+         * the softmax cross entropy. The description is the one of digit_classifier_t, plus "dropout p" layers
+         * that drop each value with probability p while training and do nothing afterwards:
+         *
+         *   conv 5 32 relu, pool, conv 5 64 relu, pool, dense 1024 relu, dropout 0.5, dense 10
+         *
+         * Every mini-batch is cut into shards of a fixed number of images, whatever the number of threads.
+         * The shards run on a thread pool, each adding up the gradients of its images in order into its own
+         * buffer, and the buffers are then summed in shard order. The initial weights and the order of the
+         * images come from init_random, and the dropout masks from a hash of the seed, step, image and value,
+         * so a seed gives bit-identical weights on any number of threads.
+         *
+         * @brief <b> Deterministic data parallel trainer for the digit classifier </b>
+         */
+        class digit_trainer_t
+        {
+          public:
+            struct settings_t
+            {
+                settings_t() : batch_size(100), shard_size(10), learning_rate(0.5), seed(10), threads(0), log_interval(100) { }
+
+                int batch_size;
+                // images per shard of a mini-batch; part of what makes a run, unlike threads
+                int shard_size;
+                double learning_rate;
+                int seed;
+                // 0 uses one thread per core
+                unsigned threads;
+                // steps between progress reports, 0 for none
+                int log_interval;
+            };
+
+            digit_trainer_t();
+            virtual ~digit_trainer_t();
+
+            // replaces the network, reports a malformed description with PRX_FATAL_S
+            void set_layers(const std::string& description);
+            void set_settings(const settings_t& settings);
+            const settings_t& get_settings() const { return settings; }
+
+            // draws the initial weights from the seed; weights are normal with deviation 0.1, cut off at two
+            // deviations, and biases 0.1 before a relu and 0 otherwise
+            void initialize();
+
+            /**
+             * Runs steps mini-batches on the images [first, first + count) of data, going through them in a
+             * new random order every epoch. Can be called again to keep training.
+             */
+            void train(const idx_dataset_t& data, size_t first, size_t count, int steps);
+
+            // the fraction of the images [first, first + count) of data the network labels correctly
+            double evaluate(const idx_dataset_t& data, size_t first, size_t count);
+
+            // writes the weights to a tensor archive digit_classifier_t::load_weights reads
+            void save_weights(const std::string& file_path) const;
+
+            // the description without the dropout layers, as digit_classifier_t takes it
+            const std::string& get_inference_description() const { return inference_description; }
+            size_t get_parameter_count() const { return parameters.size(); }
+            const std::vector<float>& get_parameters() const { return parameters; }
+            int get_step() const { return step; }
+            unsigned get_thread_count() const { return pool->get_thread_count(); }
+
+          protected:
+            enum layer_type_t
+            {
+                CONVOLUTION, MAX_POOL, DENSE, DROPOUT
+            };
+
+            struct layer_t
+            {
+                layer_type_t type;
+                int in_height, in_width, in_channels;
+                int out_height, out_width, out_channels;
+                int kernel;
+                bool relu;
+                float drop_rate;
+                // into parameters: weights_size weights, then out_channels biases
+                size_t weights_offset, weights_size;
+                size_t get_inputs() const { return (size_t)in_height * in_width * in_channels; }
+                size_t get_outputs() const { return (size_t)out_height * out_width * out_channels; }
+            };
+
+            // what one thread needs to run images forward and backward
+            struct workspace_t
+            {
+                // the input, then the output of every layer
+                std::vector<std::vector<float> > activations;
+                std::vector<float> gradient, previous_gradient;
+            };
+
+            // runs the image through the network and returns the logits; a step of 0 runs without dropout
+            const float* forward(workspace_t& workspace, const unsigned char* image, int step, size_t image_index);
+            // adds the gradients of the image just run forward to gradients, returns its loss
+            double backward(workspace_t& workspace, int label, int step, size_t image_index, float* gradients, bool& correct);
+
+            // the scale of value unit of a dropout layer: 0 if it is dropped, 1 / (1 - rate) if it is kept
+            float get_dropout_scale(const layer_t& layer, unsigned layer_index, int step, size_t image_index, size_t unit) const;
+
+            void make_pool();
+
+            settings_t settings;
+            std::string inference_description;
+            std::vector<layer_t> layers;
+            std::vector<float> parameters;
+            // one gradient buffer per shard of a mini-batch
+            std::vector<std::vector<float> > shard_gradients;
+            std::vector<workspace_t> workspaces;
+            thread_pool_t* pool;
+            const classifier_kernels_t* kernels;
+            // the order of the images in the current epoch, and the next one to use
+            std::vector<size_t> order;
+            size_t order_first, order_position;
+            int step;
+
+          private:
+            digit_trainer_t(const digit_trainer_t&);
+            digit_trainer_t& operator=(const digit_trainer_t&);
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "prx/utilities/applications/distance_oracle.hpp"
+
+namespace prx
+{
+
+    namespace util
+    {
+        distance_oracle_t::distance_oracle_t(const occupancy_grid_t* grid)
+        {
+            this->grid = grid;
+            columns = grid->get_columns();
+        }
+
+        distance_oracle_t::~distance_oracle_t()
+        {}
+
+        void distance_oracle_t::add_goal(int goal_i, int goal_j)
+        {
+            int goal = goal_i * columns + goal_j;
+            if (fields.count(goal) > 0 || !grid->is_free(goal_i, goal_j))
+                return;
+
+            int cell_count = grid->get_rows() * columns;
+            std::vector< uint8_t >& field = fields[goal];
+            field.assign((cell_count + 1) / 2, 0xFF);
+
+            // breadth-first search outwards from the goal, each reached cell points back at the
+            // neighbour it was reached from
+            std::vector< int > queue;
+            queue.reserve(cell_count);
+            queue.push_back(goal);
+            set_hop(field, goal, HOP_GOAL);
+
+            int adjacent[4];
+            for (size_t head = 0; head < queue.size(); head++)
+            {
+                int index = queue[head];
+                int count = grid->get_free_neighbors(index, adjacent);
+                for (int k = 0; k < count; k++)
+                {
+                    int adj = adjacent[k];
+                    if (get_hop(field, adj) != HOP_NONE)
+                        continue;
+
+                    // step from adj back to index, told apart by row and column since with one column
+                    // index + 1 is also the cell below
+                    int hop;
+                    int di = adj / columns - index / columns;
+                    int dj = adj % columns - index % columns;
+                    if (dj == 1)
+                        hop = HOP_LEFT;
+                    else if (dj == -1)
+                        hop = HOP_RIGHT;
+                    else if (di == 1)
+                        hop = HOP_UP;
+                    else
+                        hop = HOP_DOWN;
+                    set_hop(field, adj, hop);
+                    queue.push_back(adj);
+                }
+            }
+        }
+
+        bool distance_oracle_t::has_goal(int goal_i, int goal_j) const
+        {
+            return fields.count(goal_i * columns + goal_j) > 0;
+        }
+
+        std::vector< std::pair<int, int> > distance_oracle_t::path(int initial_i, int initial_j, int goal_i, int goal_j) const
+        {
+            std::vector< std::pair<int, int> > path;
+
+            auto found = fields.find(goal_i * columns + goal_j);
+            if (found == fields.end() || initial_i < 0 || initial_i >= grid->get_rows() || initial_j < 0 || initial_j >= columns)
+                return path;
+
+            const std::vector< uint8_t >& field = found->second;
+            int i = initial_i;
+            int j = initial_j;
+            int hop = get_hop(field, i * columns + j);
+            if (hop == HOP_NONE)
+                return path;
+
+            path.push_back(std::make_pair(i, j));
+            while (hop != HOP_GOAL)
+            {
+                if (hop == HOP_LEFT)
+                    j--;
+                else if (hop == HOP_RIGHT)
+                    j++;
+                else if (hop == HOP_UP)
+                    i--;
+                else
+                    i++;
+                path.push_back(std::make_pair(i, j));
+                hop = get_hop(field, i * columns + j);
+            }
+            return path;
+        }
+
+        size_t distance_oracle_t::get_memory_bytes() const
+        {
+            size_t bytes = 0;
+            for (auto &goal_field : fields)
+                bytes += goal_field.second.capacity();
+            return bytes;
+        }
+    }
+}
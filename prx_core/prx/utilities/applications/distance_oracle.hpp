@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef PRX_UTIL_DISTANCE_ORACLE_HPP
+#define	PRX_UTIL_DISTANCE_ORACLE_HPP
+
+#include "prx/utilities/applications/occupancy_grid.hpp"
+
+#include <map>
+#include <utility>
+
+namespace prx
+{
+    namespace util
+    {
+        // Shortest paths to a small fixed set of goal cells. One breadth-first search per goal
+        // leaves a next-hop field, packed as 4 bits per cell, that leads every reachable cell
+        // to the goal, so a query is a walk along the field in O(path length).
+        class distance_oracle_t
+        {
+          public:
+            distance_oracle_t(const occupancy_grid_t* grid);
+            virtual ~distance_oracle_t();
+
+            // run the breadth-first search for a goal, does nothing if the goal is already known
+            void add_goal(int goal_i, int goal_j);
+
+            bool has_goal(int goal_i, int goal_j) const;
+
+            // cells from (initial_i, initial_j) to the goal inclusive, empty if the goal is unreachable
+            std::vector< std::pair<int, int> > path(int initial_i, int initial_j, int goal_i, int goal_j) const;
+
+            size_t get_memory_bytes() const;
+
+          private:
+            // next-hop codes, the direction to step in to get one cell closer to the goal
+            enum hop_t
+            {
+                HOP_LEFT = 0, HOP_RIGHT = 1, HOP_UP = 2, HOP_DOWN = 3, HOP_GOAL = 4, HOP_NONE = 15
+            };
+
+            static int get_hop(const std::vector< uint8_t >& field, int index)
+            {
+                return (field[index >> 1] >> ((index & 1) << 2)) & 15;
+            }
+
+            static void set_hop(std::vector< uint8_t >& field, int index, int hop)
+            {
+                uint8_t& byte = field[index >> 1];
+                int shift = (index & 1) << 2;
+                byte = (uint8_t)((byte & ~(15 << shift)) | (hop << shift));
+            }
+
+            const occupancy_grid_t* grid;
+            int columns;
+
+            // next-hop field for each goal, keyed by the goal's row*columns+col
+            std::map< int, std::vector< uint8_t > > fields;
+        };
+    }
+}
+
+#endif
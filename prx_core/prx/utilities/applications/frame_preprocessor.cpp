@@ -0,0 +1,361 @@
+#include "prx/utilities/applications/frame_preprocessor.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace prx
+{
+
+    namespace util
+    {
+        // sums[b] += weight * row[b] for the first count bytes of a row
+        static inline void accumulate_row(const unsigned char* row, int count, float weight, float* sums)
+        {
+            int b = 0;
+#if defined(__x86_64__)
+            __m128 w = _mm_set1_ps(weight);
+            __m128i zero = _mm_setzero_si128();
+            for (; b + 16 <= count; b += 16)
+            {
+                __m128i bytes = _mm_loadu_si128((const __m128i*)(row + b));
+                __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+                for (int j = 0; j < 2; ++j)
+                {
+                    float* s = sums + b + 8 * j;
+                    __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words[j], zero));
+                    __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words[j], zero));
+                    _mm_storeu_ps(s, _mm_add_ps(_mm_loadu_ps(s), _mm_mul_ps(w, low)));
+                    _mm_storeu_ps(s + 4, _mm_add_ps(_mm_loadu_ps(s + 4), _mm_mul_ps(w, high)));
+                }
+            }
+#endif
+            for (; b < count; ++b)
+                sums[b] += weight * row[b];
+        }
+
+        // totals[b] += row[b], for rows the output row covers completely; 257 rows fit in 16 bits
+        static inline void add_row(const unsigned char* row, int count, uint16_t* totals)
+        {
+            int b = 0;
+#if defined(__x86_64__)
+            __m128i zero = _mm_setzero_si128();
+            for (; b + 16 <= count; b += 16)
+            {
+                __m128i bytes = _mm_loadu_si128((const __m128i*)(row + b));
+                __m128i* t = (__m128i*)(totals + b);
+                _mm_storeu_si128(t, _mm_add_epi16(_mm_loadu_si128(t), _mm_unpacklo_epi8(bytes, zero)));
+                _mm_storeu_si128(t + 1, _mm_add_epi16(_mm_loadu_si128(t + 1), _mm_unpackhi_epi8(bytes, zero)));
+            }
+#endif
+            for (; b < count; ++b)
+                totals[b] += row[b];
+        }
+
+        // sums[b] += weight * totals[b], and clears totals
+        static inline void flush_totals(uint16_t* totals, int count, float weight, float* sums)
+        {
+            int b = 0;
+#if defined(__x86_64__)
+            __m128 w = _mm_set1_ps(weight);
+            __m128i zero = _mm_setzero_si128();
+            for (; b + 8 <= count; b += 8)
+            {
+                __m128i words = _mm_loadu_si128((const __m128i*)(totals + b));
+                __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+                __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+                _mm_storeu_ps(sums + b, _mm_add_ps(_mm_loadu_ps(sums + b), _mm_mul_ps(w, low)));
+                _mm_storeu_ps(sums + b + 4, _mm_add_ps(_mm_loadu_ps(sums + b + 4), _mm_mul_ps(w, high)));
+                _mm_storeu_si128((__m128i*)(totals + b), zero);
+            }
+#endif
+            for (; b < count; ++b)
+            {
+                sums[b] += weight * totals[b];
+                totals[b] = 0;
+            }
+        }
+
+        // PIL keeps 2 bits of headroom above the 8 bits of a channel in an int32 sum
+        static const int lanczos_precision = 32 - 8 - 2;
+
+        static inline double sinc(double x)
+        {
+            if (x == 0.0)
+                return 1.0;
+            x *= M_PI;
+            return std::sin(x) / x;
+        }
+
+        static inline double lanczos(double x)
+        {
+            return (x >= -3.0 && x < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+        }
+
+        // the byte a fixed point sum rounds to
+        static inline unsigned char clip_sum(int32_t sum)
+        {
+            sum >>= lanczos_precision;
+            return sum <= 0 ? 0 : sum >= 255 ? 255 : (unsigned char)sum;
+        }
+
+        frame_preprocessor_t::frame_preprocessor_t(int output_width, int output_height)
+        {
+            this->output_width = output_width;
+            this->output_height = output_height;
+            frame_width = frame_height = 0;
+            full_row_weight = 0;
+            lanczos_stride = 0;
+            integer_luminance = true;
+        }
+
+        frame_preprocessor_t::~frame_preprocessor_t() { }
+
+        void frame_preprocessor_t::build_spans(int source, int output, std::vector<span_t>& spans, std::vector<float>& weights)
+        {
+            spans.resize(output);
+            weights.clear();
+            // output cell i covers [i, i + 1) * scale of the source, source pixel s covers [s, s + 1)
+            double scale = source / (double)output;
+            for (int i = 0; i < output; ++i)
+            {
+                double low = i * scale, high = (i + 1) * scale;
+                span_t& span = spans[i];
+                span.begin = (int)low;
+                span.end = PRX_MINIMUM(source, (int)std::ceil(high));
+                span.first_weight = weights.size();
+                for (int s = span.begin; s < span.end; ++s)
+                    weights.push_back((PRX_MINIMUM(s + 1.0, high) - PRX_MAXIMUM((double)s, low)) / scale);
+            }
+        }
+
+        void frame_preprocessor_t::build_lanczos_spans(int source, int output, std::vector<span_t>& spans, std::vector<int32_t>& weights)
+        {
+            spans.resize(output);
+            weights.clear();
+            // as precompute_coeffs and normalize_coeffs_8bpc of PIL's Resample.c
+            double scale = source / (double)output;
+            double filter_scale = PRX_MAXIMUM(scale, 1.0);
+            double support = 3.0 * filter_scale, inverse_scale = 1.0 / filter_scale;
+            std::vector<double> k;
+            for (int i = 0; i < output; ++i)
+            {
+                double center = (i + 0.5) * scale;
+                span_t& span = spans[i];
+                span.begin = PRX_MAXIMUM(0, (int)(center - support + 0.5));
+                span.end = PRX_MINIMUM(source, (int)(center + support + 0.5));
+                span.first_weight = weights.size();
+                k.resize(span.end - span.begin);
+                double total = 0;
+                for (int s = span.begin; s < span.end; ++s)
+                    total += k[s - span.begin] = lanczos((s - center + 0.5) * inverse_scale);
+                for (unsigned j = 0; j < k.size(); ++j)
+                {
+                    double w = (total != 0 ? k[j] / total : k[j]) * (1 << lanczos_precision);
+                    weights.push_back((int32_t)(w < 0 ? w - 0.5 : w + 0.5));
+                }
+            }
+        }
+
+        // splits a row of pixels into one 16 bit plane per used channel
+        template <int channels>
+        static void split_planes(const unsigned char* row, int width, int plane_size, int16_t* planes)
+        {
+            int16_t* red = planes;
+            int16_t* green = planes + plane_size;
+            int16_t* blue = planes + 2 * plane_size;
+            for (int sx = 0; sx < width; ++sx, row += channels)
+            {
+                red[sx] = row[0];
+                if (channels >= 3)
+                {
+                    green[sx] = row[1];
+                    blue[sx] = row[2];
+                }
+            }
+        }
+
+        // the fixed point sums of count pixels of each of used planes weighted by split weights; count is a
+        // multiple of 8
+        template <int used>
+        static inline void lanczos_dot(const int16_t* planes, int plane_size, const int16_t* high, const int16_t* low, int count, int32_t* sums)
+        {
+#if defined(__x86_64__)
+            __m128i high_sums[used], low_sums[used];
+            for (int c = 0; c < used; ++c)
+                high_sums[c] = low_sums[c] = _mm_setzero_si128();
+            for (int t = 0; t < count; t += 8)
+            {
+                __m128i h = _mm_loadu_si128((const __m128i*)(high + t));
+                __m128i l = _mm_loadu_si128((const __m128i*)(low + t));
+                for (int c = 0; c < used; ++c)
+                {
+                    __m128i p = _mm_loadu_si128((const __m128i*)(planes + c * plane_size + t));
+                    high_sums[c] = _mm_add_epi32(high_sums[c], _mm_madd_epi16(p, h));
+                    low_sums[c] = _mm_add_epi32(low_sums[c], _mm_madd_epi16(p, l));
+                }
+            }
+            for (int c = 0; c < used; ++c)
+            {
+                __m128i v = high_sums[c], w = low_sums[c];
+                v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+                v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+                w = _mm_add_epi32(w, _mm_shuffle_epi32(w, _MM_SHUFFLE(1, 0, 3, 2)));
+                w = _mm_add_epi32(w, _mm_shuffle_epi32(w, _MM_SHUFFLE(2, 3, 0, 1)));
+                sums[c] = _mm_cvtsi128_si32(v) * 256 + _mm_cvtsi128_si32(w);
+            }
+#else
+            for (int c = 0; c < used; ++c)
+            {
+                sums[c] = 0;
+                for (int t = 0; t < count; ++t)
+                    sums[c] += planes[c * plane_size + t] * (high[t] * 256 + low[t]);
+            }
+#endif
+        }
+
+        void frame_preprocessor_t::process_lanczos(const unsigned char* pixels, int width, int height, int channels, size_t row_bytes, bool bottom_up, float* out)
+        {
+            int used = channels >= 3 ? 3 : 1;
+            int resized_row = output_width * used;
+            // room for the 8 pixels a dot product can read past the last one
+            int plane_size = width + 8;
+            planes.assign((size_t)used * plane_size, 0);
+            columns_resized.resize((size_t)height * resized_row);
+            const int32_t half = 1 << (lanczos_precision - 1);
+            for (int sy = 0; sy < height; ++sy)
+            {
+                const unsigned char* row = pixels + (bottom_up ? height - 1 - sy : sy) * row_bytes;
+                switch (channels)
+                {
+                    case 1: split_planes<1>(row, width, plane_size, planes.data()); break;
+                    case 2: split_planes<2>(row, width, plane_size, planes.data()); break;
+                    case 3: split_planes<3>(row, width, plane_size, planes.data()); break;
+                    default: split_planes<4>(row, width, plane_size, planes.data()); break;
+                }
+                unsigned char* resized = &columns_resized[(size_t)sy * resized_row];
+                for (int x = 0; x < output_width; ++x)
+                {
+                    const span_t& columns = lanczos_column_spans[x];
+                    int count = (columns.end - columns.begin + 7) & ~7;
+                    const int16_t* high = &lanczos_column_high[x * lanczos_stride];
+                    const int16_t* low = &lanczos_column_low[x * lanczos_stride];
+                    int32_t sums[3];
+                    if (used == 3)
+                        lanczos_dot<3>(&planes[columns.begin], plane_size, high, low, count, sums);
+                    else
+                        lanczos_dot<1>(&planes[columns.begin], plane_size, high, low, count, sums);
+                    for (int c = 0; c < used; ++c)
+                        resized[x * used + c] = clip_sum(half + sums[c]);
+                }
+            }
+            // the rows of every output row, a whole row of bytes at a time
+            std::vector<int32_t>& sums = lanczos_sums;
+            sums.resize(resized_row);
+            for (int y = 0; y < output_height; ++y)
+            {
+                const span_t& rows = lanczos_row_spans[y];
+                std::fill(sums.begin(), sums.end(), half);
+                const int32_t* weight = &lanczos_row_weights[rows.first_weight];
+                for (int sy = rows.begin; sy < rows.end; ++sy, ++weight)
+                {
+                    const unsigned char* resized = &columns_resized[(size_t)sy * resized_row];
+                    for (int b = 0; b < resized_row; ++b)
+                        sums[b] += resized[b] * *weight;
+                }
+                for (int x = 0; x < output_width; ++x)
+                {
+                    int total = 0;
+                    for (int c = 0; c < used; ++c)
+                        total += clip_sum(sums[x * used + c]);
+                    // (r + g + b) / 3 is 0 in integers, a gray frame counts its one channel three times
+                    out[y * output_width + x] = (used == 3 ? total : 3 * total) <= 2 ? 1.0f : 0.0f;
+                }
+            }
+        }
+
+        void frame_preprocessor_t::process(const unsigned char* pixels, int width, int height, int channels, size_t row_bytes, bool bottom_up, float* out)
+        {
+            if (width != frame_width || height != frame_height)
+            {
+                build_spans(height, output_height, row_spans, row_weights);
+                build_spans(width, output_width, column_spans, column_weights);
+                build_lanczos_spans(height, output_height, lanczos_row_spans, lanczos_row_weights);
+                build_lanczos_spans(width, output_width, lanczos_column_spans, lanczos_column_weights);
+                lanczos_stride = 0;
+                for (int x = 0; x < output_width; ++x)
+                    lanczos_stride = PRX_MAXIMUM(lanczos_stride, (lanczos_column_spans[x].end - lanczos_column_spans[x].begin + 7) & ~7);
+                lanczos_column_high.assign(output_width * lanczos_stride, 0);
+                lanczos_column_low.assign(output_width * lanczos_stride, 0);
+                for (int x = 0; x < output_width; ++x)
+                {
+                    const span_t& columns = lanczos_column_spans[x];
+                    for (int t = 0; t < columns.end - columns.begin; ++t)
+                    {
+                        int32_t weight = lanczos_column_weights[columns.first_weight + t];
+                        lanczos_column_high[x * lanczos_stride + t] = (int16_t)((weight - (weight & 255)) / 256);
+                        lanczos_column_low[x * lanczos_stride + t] = (int16_t)(weight & 255);
+                    }
+                }
+                full_row_weight = output_height / (float)height;
+                frame_width = width;
+                frame_height = height;
+            }
+            if (integer_luminance)
+            {
+                process_lanczos(pixels, width, height, channels, row_bytes, bottom_up, out);
+                return;
+            }
+            int row_count = width * channels;
+            row_sums.resize(row_count);
+            row_totals.resize(row_count);
+
+            bool color = channels >= 3;
+            // the column weights sum to 1, so this turns a sum of channels into the inverted luminance
+            float normalization = 1.0f / ((color ? 3 : 1) * 255.0f);
+            for (int y = 0; y < output_height; ++y)
+            {
+                const span_t& rows = row_spans[y];
+                std::fill(row_sums.begin(), row_sums.end(), 0.0f);
+                // rows the output row covers completely are added as integers, the partly covered ones at its
+                // edges are weighted
+                int whole_rows = 0;
+                for (int sy = rows.begin; sy < rows.end; ++sy)
+                {
+                    const unsigned char* row = pixels + (bottom_up ? height - 1 - sy : sy) * row_bytes;
+                    float weight = row_weights[rows.first_weight + sy - rows.begin];
+                    if (weight < full_row_weight * 0.9999f)
+                        accumulate_row(row, row_count, weight, row_sums.data());
+                    else
+                    {
+                        add_row(row, row_count, row_totals.data());
+                        if (++whole_rows == 257)
+                        {
+                            flush_totals(row_totals.data(), row_count, full_row_weight, row_sums.data());
+                            whole_rows = 0;
+                        }
+                    }
+                }
+                if (whole_rows > 0)
+                    flush_totals(row_totals.data(), row_count, full_row_weight, row_sums.data());
+
+                for (int x = 0; x < output_width; ++x)
+                {
+                    const span_t& columns = column_spans[x];
+                    const float* weight = &column_weights[columns.first_weight];
+                    float sum = 0;
+                    for (int sx = columns.begin; sx < columns.end; ++sx, ++weight)
+                    {
+                        const float* pixel = &row_sums[sx * channels];
+                        sum += *weight * (color ? pixel[0] + pixel[1] + pixel[2] : pixel[0]);
+                    }
+                    out[y * output_width + x] = 1.0f - sum * normalization;
+                }
+            }
+        }
+    }
+}
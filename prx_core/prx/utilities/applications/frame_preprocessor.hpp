@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef PRX_UTIL_FRAME_PREPROCESSOR_HPP
+#define	PRX_UTIL_FRAME_PREPROCESSOR_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        /**
+         * Turns a raw 8 bit frame into the input of digit_classifier_t in one pass: the frame is resized
+         * to the input size, and the luminance, the mean of red, green and blue, is inverted and normalized
+         * so ink is 1 and background 0. sense_environment.py does the last step in integers, which leaves 1
+         * only for cells whose resized channels add up to at most 2 and 0 everywhere else; that is the
+         * default, so the native and the Python sensing feed the classifier the same input.
+         * set_integer_luminance(false) keeps the continuous luminance instead.
+         *
+         * Which cells end up exactly black depends on the resize filter, so with the integer luminance the
+         * frame is resized like PIL's Image.ANTIALIAS does it: Lanczos reaching 3 output pixels to each side,
+         * with 22 bit fixed point weights, every row resized and rounded to bytes before the columns. Every
+         * source pixel is weighted for about 6 output pixels, with 16 bit SIMD multiplies of the weights
+         * split in two, which makes it several times slower than the area average.
+         *
+         * With the continuous luminance every output cell averages the source pixels it covers, weighting
+         * the pixels on its border by how much of them it covers. The source rows of an output row are
+         * summed with SIMD into a row of per byte sums, as 16 bit integers for the rows it covers
+         * completely, so every byte of the frame is read once; then each cell reads its part of that row.
+         *
+         * @brief <b> Fused resize and luminance normalization for sensing frames </b>
+         */
+        class frame_preprocessor_t
+        {
+          public:
+            frame_preprocessor_t(int output_width = 28, int output_height = 28);
+            virtual ~frame_preprocessor_t();
+
+            /**
+             * Writes output_height x output_width values to out.
+             *
+             * @param pixels The first byte of the frame.
+             * @param channels 1 or 2 (gray, gray and alpha), 3 or 4 (RGB, RGBA); alpha is ignored.
+             * @param row_bytes The distance between rows, at least width * channels.
+             * @param bottom_up True if the first row in memory is the bottom of the image, as in OpenGL.
+             */
+            void process(const unsigned char* pixels, int width, int height, int channels, size_t row_bytes, bool bottom_up, float* out);
+
+            void set_integer_luminance(bool integer) { integer_luminance = integer; }
+            bool get_integer_luminance() const { return integer_luminance; }
+
+            int get_output_width() const { return output_width; }
+            int get_output_height() const { return output_height; }
+
+          protected:
+            // the source pixels one output row or column covers, and how much of each
+            struct span_t
+            {
+                int begin, end;
+                // into weights
+                int first_weight;
+            };
+
+            // rebuilds the spans when the frame size changes
+            void build_spans(int source, int output, std::vector<span_t>& spans, std::vector<float>& weights);
+            // the spans and fixed point weights of PIL's Lanczos resize
+            void build_lanczos_spans(int source, int output, std::vector<span_t>& spans, std::vector<int32_t>& weights);
+            void process_lanczos(const unsigned char* pixels, int width, int height, int channels, size_t row_bytes, bool bottom_up, float* out);
+
+            int output_width, output_height;
+            bool integer_luminance;
+            int frame_width, frame_height;
+            std::vector<span_t> row_spans, column_spans;
+            std::vector<float> row_weights, column_weights;
+            std::vector<span_t> lanczos_row_spans, lanczos_column_spans;
+            std::vector<int32_t> lanczos_row_weights, lanczos_column_weights;
+            // the column weights split into weight / 256 and weight % 256 for 16 bit multiplies, every output
+            // column at a multiple of lanczos_stride, padded with zeros
+            int lanczos_stride;
+            std::vector<int16_t> lanczos_column_high, lanczos_column_low;
+            // one source row, a plane per used channel, and the frame resized in width only, rounded to bytes
+            std::vector<int16_t> planes;
+            std::vector<unsigned char> columns_resized;
+            std::vector<int32_t> lanczos_sums;
+            // the weight of a source row an output row covers completely
+            float full_row_weight;
+            // weighted sums of the bytes of the source rows in one output row, and integer sums of the
+            // completely covered rows not added to them yet
+            std::vector<float> row_sums;
+            std::vector<uint16_t> row_totals;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include "prx/utilities/applications/idx_file.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace prx
+{
+
+    namespace util
+    {
+        // the largest rank the header is allowed to declare
+        static const int idx_max_rank = 8;
+
+        static inline uint32_t read_big_endian(const unsigned char* bytes)
+        {
+            return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+        }
+
+        static bool file_exists(const std::string& file_path)
+        {
+            struct stat file_stat;
+            return stat(file_path.c_str(), &file_stat) == 0;
+        }
+
+        idx_file_t::idx_file_t()
+        {
+            data = NULL;
+            mapping = NULL;
+            mapping_bytes = 0;
+            close();
+        }
+
+        idx_file_t::~idx_file_t()
+        {
+            close();
+        }
+
+        size_t idx_file_t::get_element_size(element_type_t type)
+        {
+            switch (type)
+            {
+                case UNSIGNED_BYTE:
+                case SIGNED_BYTE:
+                    return 1;
+                case SHORT:
+                    return 2;
+                case INT:
+                case FLOAT:
+                    return 4;
+                case DOUBLE:
+                    return 8;
+            }
+            return 0;
+        }
+
+        void idx_file_t::close()
+        {
+            if (mapping != NULL)
+                munmap(mapping, mapping_bytes);
+            mapping = NULL;
+            mapping_bytes = 0;
+            std::vector<unsigned char>().swap(buffer);
+            data = NULL;
+            element_type = UNSIGNED_BYTE;
+            item_shape.clear();
+            item_count = item_bytes = 0;
+        }
+
+        bool idx_file_t::fail(const std::string& message)
+        {
+            close();
+            error = message;
+            return false;
+        }
+
+        size_t idx_file_t::parse_header(const unsigned char* bytes, size_t count, size_t& declared_items)
+        {
+            if (count < 4 || bytes[0] != 0 || bytes[1] != 0)
+                return 0;
+            element_type = (element_type_t)bytes[2];
+            int rank = bytes[3];
+            if (get_element_size(element_type) == 0 || rank < 1 || rank > idx_max_rank || count < 4 + 4 * (size_t)rank)
+                return 0;
+
+            declared_items = read_big_endian(bytes + 4);
+            item_shape.clear();
+            item_bytes = get_element_size(element_type);
+            for (int d = 1; d < rank; ++d)
+            {
+                uint32_t dimension = read_big_endian(bytes + 4 + 4 * d);
+                // no item is larger than a gigabyte, which also keeps the products below from overflowing
+                if (dimension == 0 || item_bytes * dimension > (1u << 30))
+                    return 0;
+                item_bytes *= dimension;
+                item_shape.push_back(dimension);
+            }
+            return 4 + 4 * rank;
+        }
+
+        bool idx_file_t::open(const std::string& file_path, size_t max_items)
+        {
+            close();
+            error.clear();
+
+            int fd = ::open(file_path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return fail("cannot open " + file_path);
+            struct stat file_stat;
+            unsigned char magic[2];
+            if (fstat(fd, &file_stat) != 0 || read(fd, magic, 2) != 2)
+            {
+                ::close(fd);
+                return fail(file_path + " is empty");
+            }
+            if (magic[0] == 0x1f && magic[1] == 0x8b)
+            {
+                ::close(fd);
+                return read_gzip(file_path, max_items);
+            }
+
+            size_t bytes = file_stat.st_size;
+            void* region = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (region == MAP_FAILED)
+                return fail("cannot map " + file_path);
+            mapping = region;
+            mapping_bytes = bytes;
+
+            size_t declared_items;
+            size_t header_bytes = parse_header((const unsigned char*)region, bytes, declared_items);
+            if (header_bytes == 0)
+                return fail(file_path + " does not start with an IDX header");
+            if ((bytes - header_bytes) / item_bytes != declared_items || (bytes - header_bytes) % item_bytes != 0)
+            {
+                std::stringstream message;
+                message << file_path << " declares " << declared_items << " items of " << item_bytes << " bytes but has " << bytes - header_bytes;
+                return fail(message.str());
+            }
+            item_count = max_items > 0 ? PRX_MINIMUM(max_items, declared_items) : declared_items;
+            data = (const unsigned char*)region + header_bytes;
+            return true;
+        }
+
+        bool idx_file_t::read_gzip(const std::string& file_path, size_t max_items)
+        {
+            gzFile file = gzopen(file_path.c_str(), "rb");
+            if (file == NULL)
+                return fail("cannot open " + file_path);
+            gzbuffer(file, 1 << 17);
+
+            // the fixed part of the header, then the dimensions it announces
+            unsigned char header[4 + 4 * idx_max_rank];
+            size_t declared_items = 0, header_bytes = 0;
+            if (gzread(file, header, 4) == 4 && header[3] >= 1 && header[3] <= idx_max_rank)
+            {
+                int dimension_bytes = 4 * header[3];
+                if (gzread(file, header + 4, dimension_bytes) == dimension_bytes)
+                    header_bytes = parse_header(header, 4 + dimension_bytes, declared_items);
+            }
+            if (header_bytes == 0)
+            {
+                gzclose(file);
+                return fail(file_path + " does not start with an IDX header");
+            }
+
+            item_count = max_items > 0 ? PRX_MINIMUM(max_items, declared_items) : declared_items;
+            size_t payload = item_count * item_bytes;
+            buffer.resize(payload);
+            size_t read_bytes = 0;
+            while (read_bytes < payload)
+            {
+                unsigned block = PRX_MINIMUM(payload - read_bytes, (size_t)1 << 20);
+                int count = gzread(file, buffer.data() + read_bytes, block);
+                if (count <= 0)
+                    break;
+                read_bytes += count;
+            }
+            // a file read to its end cannot have anything after the last item
+            unsigned char extra;
+            bool trailing = read_bytes == payload && item_count == declared_items && gzread(file, &extra, 1) > 0;
+            gzclose(file);
+
+            if (read_bytes != payload || trailing)
+            {
+                std::stringstream message;
+                message << file_path << " declares " << declared_items << " items of " << item_bytes << " bytes but "
+                        << (trailing ? "has more" : "ends early");
+                return fail(message.str());
+            }
+            data = buffer.data();
+            return true;
+        }
+
+        bool idx_dataset_t::open(const std::string& directory, const std::string& set, size_t max_items)
+        {
+            std::string images_path = directory + "/" + set + "-images-idx3-ubyte";
+            std::string labels_path = directory + "/" + set + "-labels-idx1-ubyte";
+            if (!file_exists(images_path))
+                images_path += ".gz";
+            if (!file_exists(labels_path))
+                labels_path += ".gz";
+            return open_files(images_path, labels_path, max_items);
+        }
+
+        bool idx_dataset_t::open_files(const std::string& images_path, const std::string& labels_path, size_t max_items)
+        {
+            error.clear();
+            if (!images.open(images_path, max_items))
+                error = images.get_error();
+            else if (!labels.open(labels_path, max_items))
+                error = labels.get_error();
+            else if (images.get_element_type() != idx_file_t::UNSIGNED_BYTE || images.get_item_shape().size() != 2)
+                error = images_path + " does not hold 8 bit images";
+            else if (labels.get_element_type() != idx_file_t::UNSIGNED_BYTE || !labels.get_item_shape().empty())
+                error = labels_path + " does not hold 8 bit labels";
+            else if (images.get_item_count() != labels.get_item_count())
+                error = images_path + " and " + labels_path + " hold different numbers of items";
+            if (error.empty())
+                return true;
+            close();
+            return false;
+        }
+
+        void idx_dataset_t::close()
+        {
+            images.close();
+            labels.close();
+        }
+
+        size_t idx_dataset_t::get_inputs(size_t first, size_t count, float* out) const
+        {
+            if (first >= get_count())
+                return 0;
+            count = PRX_MINIMUM(count, get_count() - first);
+            size_t size = images.get_item_bytes();
+            const unsigned char* pixels = get_image(first);
+            for (size_t i = 0; i < count * size; ++i)
+                out[i] = pixels[i] / 255.0f;
+            return count;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef PRX_UTIL_IDX_FILE_HPP
+#define	PRX_UTIL_IDX_FILE_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        /**
+         * An IDX file, the format of the MNIST sets in sensing/MNIST_data: two zero bytes, the element type,
+         * the rank, rank big-endian 32 bit dimensions, then the elements. The first dimension counts the
+         * items, an image or a label, and the rest are the shape of an item.
+         *
+         * An uncompressed file is mapped with mmap and read in place. A gzipped one is decompressed with zlib
+         * a block at a time into a buffer of the payload, stopping after the items asked for. Either way the
+         * items are views into that memory, and open checks the header and that the payload has exactly the
+         * elements the dimensions call for.
+         *
+         * @brief <b> Memory mapped or streamed reader of IDX files </b>
+         */
+        class idx_file_t
+        {
+          public:
+            enum element_type_t
+            {
+                UNSIGNED_BYTE = 0x08, SIGNED_BYTE = 0x09, SHORT = 0x0B, INT = 0x0C, FLOAT = 0x0D, DOUBLE = 0x0E
+            };
+
+            idx_file_t();
+            virtual ~idx_file_t();
+
+            /**
+             * Opens a raw or gzipped IDX file, telling them apart by the gzip magic. Returns false, with the
+             * reason in get_error, if the file is missing, truncated or malformed; the file is left closed.
+             *
+             * @param max_items If positive, at most this many items are read; a gzipped file is only
+             * decompressed that far.
+             */
+            bool open(const std::string& file_path, size_t max_items = 0);
+            void close();
+
+            bool is_open() const { return data != NULL; }
+            // true if the file was mapped rather than decompressed
+            bool is_mapped() const { return mapping != NULL; }
+            const std::string& get_error() const { return error; }
+
+            element_type_t get_element_type() const { return element_type; }
+            // the dimensions after the first one
+            const std::vector<uint32_t>& get_item_shape() const { return item_shape; }
+            size_t get_item_count() const { return item_count; }
+            size_t get_item_bytes() const { return item_bytes; }
+
+            /**
+             * The elements of item i, in the byte order of the file: multi-byte elements are big-endian.
+             * The pointer is valid until the file is closed.
+             */
+            const unsigned char* get_item(size_t i) const { return data + i * item_bytes; }
+
+            static size_t get_element_size(element_type_t type);
+
+          protected:
+            bool fail(const std::string& message);
+            // checks the header at the start of bytes and fills the shape, returns the header size or 0
+            size_t parse_header(const unsigned char* bytes, size_t count, size_t& declared_items);
+            bool read_gzip(const std::string& file_path, size_t max_items);
+
+            std::string error;
+            element_type_t element_type;
+            std::vector<uint32_t> item_shape;
+            size_t item_count, item_bytes;
+            const unsigned char* data;
+            // the whole file when mapped
+            void* mapping;
+            size_t mapping_bytes;
+            // the payload when decompressed
+            std::vector<unsigned char> buffer;
+
+          private:
+            idx_file_t(const idx_file_t&);
+            idx_file_t& operator=(const idx_file_t&);
+        };
+
+        /**
+         * An image file and its label file, such as t10k-images-idx3-ubyte.gz and t10k-labels-idx1-ubyte.gz,
+         * checked to hold 8 bit images and 8 bit labels of the same count.
+         *
+         * @brief <b> Pairs of images and labels from two IDX files </b>
+         */
+        class idx_dataset_t
+        {
+          public:
+            /**
+             * Opens <directory>/<set>-images-idx3-ubyte and <set>-labels-idx1-ubyte, taking the uncompressed
+             * file when there is one and the .gz otherwise. Returns false with the reason in get_error.
+             */
+            bool open(const std::string& directory, const std::string& set, size_t max_items = 0);
+            // opens the two files as named
+            bool open_files(const std::string& images_path, const std::string& labels_path, size_t max_items = 0);
+            void close();
+
+            const std::string& get_error() const { return error; }
+            size_t get_count() const { return images.get_item_count(); }
+            int get_rows() const { return images.get_item_shape()[0]; }
+            int get_columns() const { return images.get_item_shape()[1]; }
+
+            // rows x columns bytes, 0 is background and 255 ink
+            const unsigned char* get_image(size_t i) const { return images.get_item(i); }
+            int get_label(size_t i) const { return *labels.get_item(i); }
+
+            /**
+             * Writes count images starting at first as floats in [0,1], the input of digit_classifier_t.
+             * Returns how many were written, fewer if the set ends first.
+             */
+            size_t get_inputs(size_t first, size_t count, float* out) const;
+
+          protected:
+            std::string error;
+            idx_file_t images, labels;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "prx/utilities/applications/indexed_heap.hpp"
+
+namespace prx
+{
+
+    namespace util
+    {
+        indexed_heap_t::indexed_heap_t()
+        {}
+
+        indexed_heap_t::~indexed_heap_t()
+        {}
+
+        void indexed_heap_t::resize(int capacity)
+        {
+            heap.clear();
+            heap.reserve(capacity < 1024 ? capacity : 1024);
+            position.assign(capacity, -1);
+        }
+
+        void indexed_heap_t::clear()
+        {
+            for (auto &entry : heap)
+                position[entry.key] = -1;
+            heap.clear();
+        }
+
+        void indexed_heap_t::push_or_decrease(int key, int f, int g)
+        {
+            entry_t entry = {key, f, g};
+            int i = position[key];
+            if (i < 0)
+            {
+                heap.push_back(entry);
+                position[key] = (int)heap.size() - 1;
+                sift_up((int)heap.size() - 1);
+            }
+            else if (before(entry, heap[i]))
+            {
+                heap[i] = entry;
+                sift_up(i);
+            }
+        }
+
+        int indexed_heap_t::pop()
+        {
+            int key = heap[0].key;
+            position[key] = -1;
+
+            entry_t last = heap.back();
+            heap.pop_back();
+            if (!heap.empty())
+            {
+                place(0, last);
+                sift_down(0);
+            }
+            return key;
+        }
+
+        void indexed_heap_t::place(int i, const entry_t& entry)
+        {
+            heap[i] = entry;
+            position[entry.key] = i;
+        }
+
+        void indexed_heap_t::sift_up(int i)
+        {
+            entry_t entry = heap[i];
+            while (i > 0)
+            {
+                int up = (i - 1) / 2;
+                if (!before(entry, heap[up]))
+                    break;
+                place(i, heap[up]);
+                i = up;
+            }
+            place(i, entry);
+        }
+
+        void indexed_heap_t::sift_down(int i)
+        {
+            int n = (int)heap.size();
+            entry_t entry = heap[i];
+            while (true)
+            {
+                int child = 2 * i + 1;
+                if (child >= n)
+                    break;
+                if (child + 1 < n && before(heap[child + 1], heap[child]))
+                    child++;
+                if (!before(heap[child], entry))
+                    break;
+                place(i, heap[child]);
+                i = child;
+            }
+            place(i, entry);
+        }
+    }
+}
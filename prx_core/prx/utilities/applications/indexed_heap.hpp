@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef PRX_UTIL_INDEXED_HEAP_HPP
+#define	PRX_UTIL_INDEXED_HEAP_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        // Binary min-heap over integer keys in [0, capacity) which keeps the heap position of
+        // every key so that the priority of a queued key can be decreased in O(log n).
+        // Entries are ordered by f and ties are broken towards the larger g (deeper nodes first).
+        class indexed_heap_t
+        {
+          public:
+            indexed_heap_t();
+            virtual ~indexed_heap_t();
+
+            // size the position table; keys must be smaller than capacity
+            void resize(int capacity);
+
+            // remove every queued key, costs O(size) and not O(capacity)
+            void clear();
+
+            bool empty() const { return heap.empty(); }
+            int size() const { return (int)heap.size(); }
+            bool contains(int key) const { return position[key] >= 0; }
+            size_t get_reserved_bytes() const { return heap.capacity() * sizeof(entry_t) + position.capacity() * sizeof(int); }
+
+            // insert key, or lower its priority if it is already queued with a worse one
+            void push_or_decrease(int key, int f, int g);
+
+            // remove and return the key with the least f
+            int pop();
+
+          private:
+            struct entry_t
+            {
+                int key;
+                int f;
+                int g;
+            };
+
+            std::vector< entry_t > heap;
+            std::vector< int > position; // index of each key in heap, -1 when not queued
+
+            bool before(const entry_t& a, const entry_t& b) const
+            {
+                return a.f < b.f || (a.f == b.f && a.g > b.g);
+            }
+
+            void place(int i, const entry_t& entry);
+            void sift_up(int i);
+            void sift_down(int i);
+        };
+    }
+}
+
+#endif
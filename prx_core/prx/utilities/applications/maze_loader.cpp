@@ -0,0 +1,269 @@
+#include "prx/utilities/applications/maze_loader.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prx
+{
+
+    namespace util
+    {
+        static const char maze_cache_magic[8] = {'P', 'R', 'X', 'M', 'A', 'Z', 'E', '\0'};
+        static const uint32_t maze_cache_version = 1;
+
+        std::string maze_cache_path(const std::string& file_path)
+        {
+            return file_path + ".grid";
+        }
+
+        occupancy_grid_t* load_maze(const std::string& file_path, bool use_cache)
+        {
+            std::string cache_path = maze_cache_path(file_path);
+            if (use_cache)
+            {
+                occupancy_grid_t* cached = load_maze_cache(cache_path, file_path);
+                if (cached != NULL)
+                {
+                    PRX_PRINT("Mapped maze cache " << cache_path, PRX_TEXT_MAGENTA);
+                    return cached;
+                }
+            }
+
+            occupancy_grid_t* grid = parse_maze_text(file_path);
+            if (use_cache && !write_maze_cache(*grid, cache_path, file_path))
+                PRX_WARN_S("Could not write maze cache " << cache_path);
+            return grid;
+        }
+
+        // Position in a mapped text maze, with the line and column kept for error messages
+        struct maze_text_cursor_t
+        {
+            const char* position;
+            const char* end;
+            int line;
+            const char* line_start;
+
+            int column() const { return (int)(position - line_start) + 1; }
+
+            void skip_whitespace()
+            {
+                while (position < end)
+                {
+                    char ch = *position;
+                    if (ch == '\n')
+                    {
+                        line++;
+                        line_start = position + 1;
+                    }
+                    else if (ch != ' ' && ch != '\t' && ch != '\r')
+                        return;
+                    position++;
+                }
+            }
+
+            bool at_separator(const char* p) const
+            {
+                return p == end || *p == ' ' || *p == '\n' || *p == '\t' || *p == '\r';
+            }
+
+            // the current token, for error messages
+            std::string token() const
+            {
+                const char* p = position;
+                while (!at_separator(p) && p - position < 16)
+                    p++;
+                return std::string(position, p);
+            }
+        };
+
+        // Check 4 cells at once: "c c c c " with every c either '0' or '1', and return their values
+        // in the low 4 bits, or -1 if the 8 bytes are not in exactly that shape.
+        static inline int parse_four_cells(const char* p)
+        {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            if ((word & 0xFF00FF00FF00FF00ULL) != 0x2000200020002000ULL ||
+                (word & 0x00FE00FE00FE00FEULL) != 0x0030003000300030ULL)
+                return -1;
+            // gather bits 0, 16, 32 and 48
+            uint64_t cells = word & 0x0001000100010001ULL;
+            cells |= cells >> 15;
+            cells |= cells >> 30;
+            return (int)(cells & 15);
+        }
+
+        static bool parse_maze_dimension(maze_text_cursor_t& cursor, int& value)
+        {
+            cursor.skip_whitespace();
+            const char* start = cursor.position;
+            long parsed = 0;
+            while (cursor.position < cursor.end && *cursor.position >= '0' && *cursor.position <= '9' && parsed < (1L << 30))
+                parsed = parsed * 10 + (*cursor.position++ - '0');
+            value = (int)parsed;
+            return cursor.position != start && cursor.at_separator(cursor.position) && parsed < (1L << 30);
+        }
+
+        occupancy_grid_t* parse_maze_text(const std::string& file_path)
+        {
+            int fd = open(file_path.c_str(), O_RDONLY);
+            if (fd < 0)
+                PRX_FATAL_S("Error in trying to read file " << file_path);
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+            {
+                close(fd);
+                PRX_FATAL_S("Could not parse file " << file_path << ": the file is empty");
+            }
+            size_t bytes = file_stat.st_size;
+            void* mapping = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED)
+                PRX_FATAL_S("Error in trying to read file " << file_path);
+            madvise(mapping, bytes, MADV_SEQUENTIAL);
+
+            maze_text_cursor_t cursor;
+            cursor.position = (const char*)mapping;
+            cursor.end = cursor.position + bytes;
+            cursor.line = 1;
+            cursor.line_start = cursor.position;
+
+            int rows = 0, columns = 0;
+            if (!parse_maze_dimension(cursor, rows) || !parse_maze_dimension(cursor, columns))
+            {
+                int line = cursor.line, column = cursor.column();
+                munmap(mapping, bytes);
+                PRX_FATAL_S("Could not parse file " << file_path << ": expected the number of rows and columns at line " << line << ", column " << column);
+            }
+
+            occupancy_grid_t* grid = new occupancy_grid_t(rows, columns);
+            for (int i = 0; i < rows; ++i)
+            {
+                // cells are collected into a word and written 64 at a time
+                uint64_t pending = 0;
+                int pending_count = 0;
+                int pending_start = 0;
+                int j = 0;
+                while (j < columns)
+                {
+                    cursor.skip_whitespace();
+
+                    // fast path for the usual "0 1 0 1 " layout, never crosses the end of a row
+                    int cells;
+                    if (columns - j >= 4 && pending_count <= 60 && cursor.end - cursor.position >= 8 &&
+                        (cells = parse_four_cells(cursor.position)) >= 0)
+                    {
+                        pending |= (uint64_t)cells << pending_count;
+                        pending_count += 4;
+                        cursor.position += 8;
+                        j += 4;
+                    }
+                    else
+                    {
+                        if (cursor.position == cursor.end || !(*cursor.position == '0' || *cursor.position == '1') ||
+                            !cursor.at_separator(cursor.position + 1))
+                        {
+                            std::string found = cursor.position == cursor.end ? "end of file" : "'" + cursor.token() + "'";
+                            int line = cursor.line, column = cursor.column();
+                            delete grid;
+                            munmap(mapping, bytes);
+                            PRX_FATAL_S("Malformed maze. Cells can either be 0 or 1. Found " << found << " for cell (" << i << ", " << j << ") at line " << line << ", column " << column << " of " << file_path);
+                        }
+                        pending |= (uint64_t)(*cursor.position - '0') << pending_count;
+                        pending_count++;
+                        cursor.position++;
+                        j++;
+                    }
+
+                    if (pending_count == 64 || j == columns)
+                    {
+                        grid->set_free_bits(i, pending_start, pending, pending_count);
+                        pending = 0;
+                        pending_start += pending_count;
+                        pending_count = 0;
+                    }
+                }
+            }
+
+            munmap(mapping, bytes);
+            return grid;
+        }
+
+        occupancy_grid_t* load_maze_cache(const std::string& cache_path, const std::string& source_path)
+        {
+            struct stat source_stat, cache_stat;
+            if (stat(source_path.c_str(), &source_stat) != 0 || stat(cache_path.c_str(), &cache_stat) != 0)
+                return NULL;
+            if ((size_t)cache_stat.st_size < sizeof(maze_cache_header_t))
+                return NULL;
+
+            int fd = open(cache_path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return NULL;
+            size_t bytes = cache_stat.st_size;
+            void* mapping = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED)
+                return NULL;
+
+            const maze_cache_header_t* header = (const maze_cache_header_t*)mapping;
+            bool valid = std::memcmp(header->magic, maze_cache_magic, sizeof(maze_cache_magic)) == 0
+                && header->version == maze_cache_version
+                && header->rows >= 0 && header->columns >= 0
+                && header->stride == (header->columns + 2 + 63) / 64
+                && header->source_size == (uint64_t)source_stat.st_size
+                && header->source_mtime == (int64_t)source_stat.st_mtime
+                && header->words_offset + (uint64_t)(header->rows + 2) * header->stride * sizeof(uint64_t) <= bytes;
+            if (!valid)
+            {
+                munmap(mapping, bytes);
+                return NULL;
+            }
+
+            occupancy_grid_t* grid = new occupancy_grid_t();
+            grid->attach_mapping(header->rows, header->columns, mapping, bytes, header->words_offset);
+            return grid;
+        }
+
+        bool write_maze_cache(const occupancy_grid_t& grid, const std::string& cache_path, const std::string& source_path)
+        {
+            struct stat source_stat;
+            if (stat(source_path.c_str(), &source_stat) != 0)
+                return false;
+
+            maze_cache_header_t header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, maze_cache_magic, sizeof(maze_cache_magic));
+            header.version = maze_cache_version;
+            header.rows = grid.get_rows();
+            header.columns = grid.get_columns();
+            header.stride = grid.get_stride();
+            header.source_size = source_stat.st_size;
+            header.source_mtime = source_stat.st_mtime;
+            // keep the words cache line aligned in the mapping
+            header.words_offset = (sizeof(header) + 63) & ~(uint64_t)63;
+
+            // write next to the cache and rename, so a reader never maps a half written file
+            std::string temporary_path = cache_path + ".tmp";
+            std::ofstream fout(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!fout.good())
+                return false;
+            char padding[64] = {0};
+            fout.write((const char*)&header, sizeof(header));
+            fout.write(padding, header.words_offset - sizeof(header));
+            fout.write((const char*)grid.get_words(), grid.get_word_count() * sizeof(uint64_t));
+            fout.close();
+            if (fout.fail() || rename(temporary_path.c_str(), cache_path.c_str()) != 0)
+            {
+                unlink(temporary_path.c_str());
+                return false;
+            }
+            return true;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef PRX_UTIL_MAZE_LOADER_HPP
+#define	PRX_UTIL_MAZE_LOADER_HPP
+
+#include "prx/utilities/applications/occupancy_grid.hpp"
+
+#include <string>
+
+namespace prx
+{
+    namespace util
+    {
+        // Header of the binary maze cache. The packed occupancy words of occupancy_grid_t follow
+        // at words_offset, in host (little-endian) byte order.
+        struct maze_cache_header_t
+        {
+            char magic[8];          // "PRXMAZE\0"
+            uint32_t version;
+            int32_t rows;
+            int32_t columns;
+            int32_t stride;
+            uint64_t source_size;   // size and modification time of the text maze the cache was made from
+            int64_t source_mtime;
+            uint64_t words_offset;
+        };
+
+        /**
+         * Loads a maze once, validated, for both the application and the planner. The text maze is
+         * the number of rows, the number of columns, then rows of space separated 0 (blocked) or
+         * 1 (free) cells. A binary copy is kept next to it in \<file\>.grid and, while it is newer
+         * than the text maze, loaded with mmap instead of parsing the text again.
+         *
+         * Reports an unreadable or malformed maze with PRX_FATAL_S.
+         */
+        occupancy_grid_t* load_maze(const std::string& file_path, bool use_cache = true);
+
+        // parse the text maze without looking at the cache
+        occupancy_grid_t* parse_maze_text(const std::string& file_path);
+
+        // map a cache written by write_maze_cache, NULL if it is missing, stale or invalid
+        occupancy_grid_t* load_maze_cache(const std::string& cache_path, const std::string& source_path);
+
+        // returns false, without aborting, if the cache could not be written
+        bool write_maze_cache(const occupancy_grid_t& grid, const std::string& cache_path, const std::string& source_path);
+
+        std::string maze_cache_path(const std::string& file_path);
+    }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "prx/utilities/applications/occupancy_grid.hpp"
+
+#include <sys/mman.h>
+
+namespace prx
+{
+
+    namespace util
+    {
+        occupancy_grid_t::occupancy_grid_t()
+        {
+            mapping = NULL;
+            resize(0, 0);
+        }
+
+        occupancy_grid_t::occupancy_grid_t(int rows, int columns)
+        {
+            mapping = NULL;
+            resize(rows, columns);
+        }
+
+        occupancy_grid_t::~occupancy_grid_t()
+        {
+            release_mapping();
+        }
+
+        void occupancy_grid_t::resize(int rows, int columns)
+        {
+            release_mapping();
+            this->rows = rows;
+            this->columns = columns;
+            // two extra bits for the left and right border
+            stride = (columns + 2 + 63) / 64;
+            words.assign((size_t)(rows + 2) * stride, 0);
+            bits = words.data();
+        }
+
+        void occupancy_grid_t::attach_mapping(int rows, int columns, void* mapping, size_t mapping_bytes, size_t words_offset)
+        {
+            release_mapping();
+            words.clear();
+            words.shrink_to_fit();
+
+            this->rows = rows;
+            this->columns = columns;
+            stride = (columns + 2 + 63) / 64;
+            this->mapping = mapping;
+            this->mapping_bytes = mapping_bytes;
+            bits = (const uint64_t*)((const char*)mapping + words_offset);
+        }
+
+        void occupancy_grid_t::release_mapping()
+        {
+            if (mapping != NULL)
+                munmap(mapping, mapping_bytes);
+            mapping = NULL;
+            mapping_bytes = 0;
+        }
+
+        void occupancy_grid_t::set_free(int i, int j, bool free)
+        {
+            // mapped grids are read-only
+            if (mapping != NULL)
+                return;
+
+            int x = j + 1;
+            uint64_t& word = words[(i + 1) * stride + (x >> 6)];
+            uint64_t bit = (uint64_t)1 << (x & 63);
+            if (free)
+                word |= bit;
+            else
+                word &= ~bit;
+        }
+
+        void occupancy_grid_t::set_free_bits(int i, int j, uint64_t free_bits, int count)
+        {
+            if (mapping != NULL || count <= 0)
+                return;
+
+            if (count < 64)
+                free_bits &= ((uint64_t)1 << count) - 1;
+            int x = j + 1;
+            uint64_t* row = &words[(i + 1) * stride];
+            int shift = x & 63;
+            row[x >> 6] |= free_bits << shift;
+            // the run straddles two words
+            if (shift != 0 && shift + count > 64)
+                row[(x >> 6) + 1] |= free_bits >> (64 - shift);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef PRX_UTIL_OCCUPANCY_GRID_HPP
+#define	PRX_UTIL_OCCUPANCY_GRID_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        // Maze occupancy stored as one bit per cell (1 is free, 0 is blocked) in contiguous 64-bit words.
+        // Every row is padded to a whole number of words and the maze is surrounded by a one cell
+        // border of blocked cells, so neighbour lookups never need bounds checks.
+        class occupancy_grid_t
+        {
+          public:
+            occupancy_grid_t();
+            occupancy_grid_t(int rows, int columns);
+            virtual ~occupancy_grid_t();
+
+            // discard the contents and size the grid with every cell blocked
+            void resize(int rows, int columns);
+
+            // read the words from a mapped file laid out like get_words(), starting words_offset bytes in;
+            // the grid becomes read-only and unmaps the region when it is destroyed
+            void attach_mapping(int rows, int columns, void* mapping, size_t mapping_bytes, size_t words_offset);
+
+            int get_rows() const { return rows; }
+            int get_columns() const { return columns; }
+
+            // valid for -1 <= i <= rows and -1 <= j <= columns, the border reads as blocked
+            bool is_free(int i, int j) const
+            {
+                int x = j + 1;
+                return (bits[(i + 1) * stride + (x >> 6)] >> (x & 63)) & 1;
+            }
+
+            void set_free(int i, int j, bool free);
+
+            // mark the cells (i, j) .. (i, j + count - 1) whose bit is set in free_bits as free, count <= 64
+            void set_free_bits(int i, int j, uint64_t free_bits, int count);
+
+            // write the row*columns+col indices of the free left, right, up, down cells of (i,j) to out
+            // and return how many there are
+            int get_free_neighbors(int i, int j, int* out) const
+            {
+                int index = i * columns + j;
+                int count = 0;
+                out[count] = index - 1;       count += is_free(i, j - 1);
+                out[count] = index + 1;       count += is_free(i, j + 1);
+                out[count] = index - columns; count += is_free(i - 1, j);
+                out[count] = index + columns; count += is_free(i + 1, j);
+                return count;
+            }
+
+            int get_free_neighbors(int index, int* out) const
+            {
+                return get_free_neighbors(index / columns, index % columns, out);
+            }
+
+            // raw storage, (rows + 2) padded rows of get_stride() words including the border
+            const uint64_t* get_words() const { return bits; }
+            int get_stride() const { return stride; }
+            size_t get_word_count() const { return (size_t)(rows + 2) * stride; }
+
+            size_t get_memory_bytes() const { return get_word_count() * sizeof(uint64_t); }
+
+          protected:
+            int rows;
+            int columns;
+            // words per padded row
+            int stride;
+            // either words.data() or a pointer into mapping
+            const uint64_t* bits;
+            std::vector< uint64_t > words;
+            void* mapping;
+            size_t mapping_bytes;
+
+          private:
+            void release_mapping();
+
+            occupancy_grid_t(const occupancy_grid_t&);
+            occupancy_grid_t& operator=(const occupancy_grid_t&);
+        };
+    }
+}
+
+#endif
@@ -1,100 +1,76 @@
 #include "prx/utilities/applications/search.hpp"
 
+#include <algorithm>
+
 namespace prx
 {
 
     namespace util
     {
-        cell_t::cell_t(int r, int c, int empty_state)
+        node_pool_t::node_pool_t()
         {
-            row = r;
-            column = c;
-            empty = empty_state;
+            used = 0;
+            high_water_mark = 0;
         }
 
-        cell_t::~cell_t()
+        node_pool_t::~node_pool_t()
         {}
 
-        std::string cell_t::to_string()
+        int node_pool_t::allocate(int cell, int parent, int cost)
         {
-            // row, column
-            std::string r = std::to_string(this->row);
-            std::string c = std::to_string(this->column);
-            return "(" + r + ", " + c + ")";
-        }
+            node_t node = {cell, parent, cost};
+            if (used < (int)nodes.size())
+                nodes[used] = node;
+            else
+                nodes.push_back(node);
 
-        node_t::node_t(cell_t* c, node_t* par)
-        {
-            cell = c;
-            parent = par;
+            used++;
+            if (used > high_water_mark)
+                high_water_mark = used;
+            return used - 1;
         }
 
-        node_t::~node_t()
-        {
-            cell = NULL;
-        }
+        search_t::search_t()
+        {}
 
-        int node_t::get_heur(cell_t* goal)
-        {
-            // heuristic calculation
-            return manhattan_dist(this->cell, goal);
-        }
+        search_t::~search_t()
+        {}
 
-        int node_t::get_cost_and_heur(cell_t* goal)
+        void search_t::set_grid(const occupancy_grid_t* shared_grid)
         {
-            return this->cost + this->get_heur(goal);
+            grid = shared_grid;
+            allocate_workspace();
         }
 
-        int node_t::manhattan_dist(cell_t* a, cell_t* b)
+        void search_t::allocate_workspace()
         {
-            return manhattan_dist(a->row, a->column, b->row, b->column);
+            rows = grid->get_rows();
+            columns = grid->get_columns();
+
+            int cell_count = rows * columns;
+            node_of_cell.assign(cell_count, -1);
+            visit_stamp.assign(cell_count, 0);
+            closed_stamp.assign(cell_count, 0);
+            query_stamp = 0;
+            open.resize(cell_count);
         }
 
-        int node_t::manhattan_dist(int a_i, int a_j, int b_i, int b_j)
+        int search_t::manhattan_dist(int a_i, int a_j, int b_i, int b_j)
         {
             // does not take into account action costs which are calculated in nodes
-
-            // edge case: a and b reference same cell
-            if (a_i == b_i && a_j == b_j)
-                return 0;
-            else
-                return std::abs(a_j - a_i) + std::abs(b_j - b_i);
+            return std::abs(a_i - b_i) + std::abs(a_j - b_j);
         }
 
-        std::vector< std::pair<int, int> > node_t::produce_path()
+        size_t search_t::get_memory_high_water_mark() const
         {
-            // (adds full path from start to end node included)
-
-            std::vector< std::pair<int, int> > path;
-            node_t* ptr = this;
-            // traverse backwards
-            while (ptr != NULL)
-            {
-                path.push_back(std::make_pair(ptr->cell->row, ptr->cell->column));
-                ptr = ptr->parent;
-            }
-
-            std::reverse(path.begin(), path.end()); 
-            return path;
+            return pool.get_reserved_bytes()
+                + node_of_cell.capacity() * sizeof(int)
+                + (visit_stamp.capacity() + closed_stamp.capacity()) * sizeof(unsigned)
+                + open.get_reserved_bytes();
         }
 
-        search_t::search_t()
-        {}
-
-        search_t::~search_t()
-        {
-            for (int i=0; i < rows; i++)
-            {
-                for (int j=0; j < columns; j++)
-                {
-                    free(cells[i][j]);
-                }
-                free(cells[i]);
-            }
-        }
-
-        std::vector< std::pair<int, int> > search_t::search(std::string file_path,
-            int initial_i, int initial_j, int goal_i, int goal_j)
+        std::vector< std::pair<int, int> > search_t::search(int initial_i, int initial_j, int goal_i, int goal_j,
+            algorithm_t algorithm)
         {
         	std::vector< std::pair<int, int> > path;
 
@@ -107,13 +83,10 @@ namespace prx
             // for(int j=initial_j-1; j>=goal_j; --j)                                    //################
             //     path.push_back(std::make_pair(goal_i,j));                             //################ 
 
-            // READ data from file and map it to 2D array
-            if (this->cells == NULL)
-            {
-                set_cells_from_file(file_path);
-            }
-
-            path = a_star(initial_i, initial_j, goal_i, goal_j);
+            if (algorithm == JUMP_POINT)
+                path = jump_point_search(initial_i, initial_j, goal_i, goal_j);
+            else
+                path = a_star(initial_i, initial_j, goal_i, goal_j);
 
             // debug - output path
             // std::cout << "Generated path SOLUTION: \n";
@@ -129,192 +102,248 @@ namespace prx
         std::vector< std::pair<int, int> > search_t::a_star(int initial_i, int initial_j, int goal_i, int goal_j)
         {
             std::vector< std::pair<int, int> > path;
+            expansions = 0;
+
+            if (grid == NULL || initial_i < 0 || initial_i >= rows || initial_j < 0 || initial_j >= columns ||
+                goal_i < 0 || goal_i >= rows || goal_j < 0 || goal_j >= columns)
+            {
+                std::cout << "ERROR: Query outside of the maze\n";
+                return path;
+            }
 
             // BEGIN A-STAR ALGORITHM
-            // create open and visited collections
-            std::list< node_t* > open; // nodes which occupy the current search space
-            std::list< node_t* > visited; // cells already visited before
+            begin_query();
 
-            cell_t* goal = this->cells[goal_i][goal_j];
+            int start = initial_i * columns + initial_j;
+            int goal = goal_i * columns + goal_j;
 
-            cell_t* initial_cell = this->cells[initial_i][initial_j];
-            node_t* initial_node = new node_t(initial_cell, NULL);
-            open.push_back(initial_node); // add initial node
+            node_of_cell[start] = pool.allocate(start, -1, 0);
+            visit_stamp[start] = query_stamp;
+            open.push_or_decrease(start, manhattan_dist(initial_i, initial_j, goal_i, goal_j), 0);
 
+            int adjacent[4];
             while (!open.empty())
             {
-                // search all open node for the least estimated cost
-                node_t* least = least_est_cost_node(open, goal);
-                open.remove(least);
-                visited.push_back(least);
-
-                if (least == NULL) 
-                    std::cout << "Least should not be NULL\n";
-                // debug
-                // else
-                //     std::cout << "Least is referencing cell: " << least->cell->to_string() << "\n";
-
-                if (least->cell->row == goal_i && least->cell->column == goal_j) // check if least is goal
+                // least estimated cost node
+                int least = open.pop();
+                int least_node = node_of_cell[least];
+                closed_stamp[least] = query_stamp;
+                expansions++;
+
+                if (least == goal)
+                    return produce_path(least_node);
+
+                // produce successors, the heuristic is consistent so closed cells are final
+                int successor_cost = pool[least_node].cost + 1; // 1 as action cost
+                int count = grid->get_free_neighbors(least, adjacent);
+                for (int k = 0; k < count; k++)
                 {
-                    // if goal, make sure there is no open node with a lower cost
-                    // (not implementing for now)
-                    path = least->produce_path();
-                    return path;
-                }
-
-                // produce successors
-                std::vector< cell_t* > adjacent = get_adjacent_cells(least->cell);
-                for (auto &adj_cell : adjacent)
-                {
-                    node_t* successor = new node_t(adj_cell, least);
-                    successor->cost = least->cost + 1; // 1 as action cost
-
-                    // node in open list which references the same cell
-                    node_t* open_node_same_cell = find_node_by_cell(open, adj_cell);
-                    // node in visited list which references the same cell
-                    node_t* visited_node_same_cell = find_node_by_cell(visited, adj_cell);
-
-                    if (open_node_same_cell != NULL) 
+                    int adj = adjacent[k];
+                    if (closed_stamp[adj] == query_stamp)
+                        continue;
+                    if (visit_stamp[adj] == query_stamp)
                     {
-                        if (open_node_same_cell->cost <= successor->cost)
+                        // cannot do better than the open node for this cell, otherwise reuse it
+                        node_t& open_node = pool[node_of_cell[adj]];
+                        if (open_node.cost <= successor_cost)
                             continue;
-                        // cannot do better cost than current open node, so skip successor
-
-                        // open remove?
+                        open_node.cost = successor_cost;
+                        open_node.parent = least_node;
                     }
-                    else if (visited_node_same_cell != NULL)
+                    else
                     {
-                        if (visited_node_same_cell->cost <= successor->cost)
-                            continue;
-                        // cannot do better cost than current visited node, so skip successor
-                        else
-                            visited.remove(visited_node_same_cell);
+                        node_of_cell[adj] = pool.allocate(adj, least_node, successor_cost);
+                        visit_stamp[adj] = query_stamp;
                     }
 
-                    open.push_back(successor);
-
+                    int heur = manhattan_dist(adj / columns, adj % columns, goal_i, goal_j);
+                    open.push_or_decrease(adj, successor_cost + heur, successor_cost);
                 }
-
-                
             }
 
-            std::cout << "ERROR: Unexpected code reached\n";
+            std::cout << "ERROR: No path between (" << initial_i << ", " << initial_j << ") and (" << goal_i << ", " << goal_j << ")\n";
 
             return path;
         }
 
-        node_t* search_t::find_node_by_cell(std::list< node_t* > nodes, cell_t* cell)
+        std::vector< std::pair<int, int> > search_t::jump_point_search(int initial_i, int initial_j, int goal_i, int goal_j)
         {
-            for (auto &node : nodes)
+            // Canonical paths move vertically before horizontally. A vertical move may be followed by
+            // moves up, left and right; a horizontal move only continues, unless a blocked cell behind
+            // it makes a vertical step forced. Jumps skip every cell without such a decision to make.
+            std::vector< std::pair<int, int> > path;
+            expansions = 0;
+
+            if (grid == NULL || initial_i < 0 || initial_i >= rows || initial_j < 0 || initial_j >= columns ||
+                goal_i < 0 || goal_i >= rows || goal_j < 0 || goal_j >= columns)
             {
-                if (node->cell == cell)
-                    return node;
+                std::cout << "ERROR: Query outside of the maze\n";
+                return path;
             }
-            return NULL;
-        }
 
-        node_t* search_t::least_est_cost_node(std::list< node_t* > nodes, cell_t* goal)
-        {
-            node_t* least = NULL;
-            for (auto &node : nodes)
+            begin_query();
+
+            int start = initial_i * columns + initial_j;
+            int goal = goal_i * columns + goal_j;
+
+            node_of_cell[start] = pool.allocate(start, -1, 0);
+            visit_stamp[start] = query_stamp;
+            open.push_or_decrease(start, manhattan_dist(initial_i, initial_j, goal_i, goal_j), 0);
+
+            while (!open.empty())
             {
-                if (least == NULL || node->get_cost_and_heur(goal) < least->get_cost_and_heur(goal))
-                    least = node;
+                int least = open.pop();
+                int least_node = node_of_cell[least];
+                closed_stamp[least] = query_stamp;
+                expansions++;
+
+                if (least == goal)
+                    return produce_path(least_node);
+
+                int i = least / columns;
+                int j = least % columns;
+
+                // direction the node was reached from, (0, 0) for the start
+                int di = 0, dj = 0;
+                int parent_node = pool[least_node].parent;
+                if (parent_node != -1)
+                {
+                    int parent_cell = pool[parent_node].cell;
+                    di = (i > parent_cell / columns) - (i < parent_cell / columns);
+                    dj = (j > parent_cell % columns) - (j < parent_cell % columns);
+                }
+
+                if (dj == 0)
+                {
+                    // start or vertical move: up/down ahead, left and right are natural
+                    if (di != -1)
+                        push_jump_point(jump_vertical(i, j, 1, goal), least_node, goal_i, goal_j);
+                    if (di != 1)
+                        push_jump_point(jump_vertical(i, j, -1, goal), least_node, goal_i, goal_j);
+                    push_jump_point(jump_horizontal(i, j, -1, goal), least_node, goal_i, goal_j);
+                    push_jump_point(jump_horizontal(i, j, 1, goal), least_node, goal_i, goal_j);
+                }
+                else
+                {
+                    // horizontal move: keep going, and turn only where the turn is forced
+                    push_jump_point(jump_horizontal(i, j, dj, goal), least_node, goal_i, goal_j);
+                    if (grid->is_free(i - 1, j) && !grid->is_free(i - 1, j - dj))
+                        push_jump_point(jump_vertical(i, j, -1, goal), least_node, goal_i, goal_j);
+                    if (grid->is_free(i + 1, j) && !grid->is_free(i + 1, j - dj))
+                        push_jump_point(jump_vertical(i, j, 1, goal), least_node, goal_i, goal_j);
+                }
             }
-            return least;
-        }
 
-        std::vector< cell_t* > search_t::get_adjacent_cells(cell_t* cell)
-        {
-            return get_adjacent_cells(cell->row, cell->column);
+            std::cout << "ERROR: No path between (" << initial_i << ", " << initial_j << ") and (" << goal_i << ", " << goal_j << ")\n";
+
+            return path;
         }
-        
-        std::vector< cell_t* > search_t::get_adjacent_cells(int i, int j)
+
+        int search_t::jump_horizontal(int i, int j, int dj, int goal) const
         {
-            std::vector< cell_t* > adjacent;
-            
-            int left = j-1;
-            if (left >= 0 && left < rows)
+            while (true)
             {
-                cell_t* cell = this->cells[i][left];
-                if (cell->empty == 1)
-                    adjacent.push_back( cell );
+                j += dj;
+                if (!grid->is_free(i, j))
+                    return -1;
+
+                int index = i * columns + j;
+                if (index == goal)
+                    return index;
+
+                // a blocked cell behind a free cell above or below forces a turn here
+                if ((grid->is_free(i - 1, j) && !grid->is_free(i - 1, j - dj)) ||
+                    (grid->is_free(i + 1, j) && !grid->is_free(i + 1, j - dj)))
+                    return index;
             }
-            int right = j+1;
-            if (right >= 0 && right < rows)
+        }
+
+        int search_t::jump_vertical(int i, int j, int di, int goal) const
+        {
+            while (true)
             {
-                cell_t* cell = this->cells[i][right];
-                if (cell->empty == 1)
-                    adjacent.push_back( cell );
+                i += di;
+                if (!grid->is_free(i, j))
+                    return -1;
+
+                int index = i * columns + j;
+                if (index == goal)
+                    return index;
+
+                // stop wherever a sideways scan finds something worth expanding
+                if (jump_horizontal(i, j, -1, goal) != -1 || jump_horizontal(i, j, 1, goal) != -1)
+                    return index;
             }
-            int up = i-1;
-            if (up >= 0 && up < rows)
+        }
+
+        void search_t::push_jump_point(int jump_point, int parent_node, int goal_i, int goal_j)
+        {
+            if (jump_point == -1 || closed_stamp[jump_point] == query_stamp)
+                return;
+
+            int parent_cell = pool[parent_node].cell;
+            int i = jump_point / columns;
+            int j = jump_point % columns;
+            int cost = pool[parent_node].cost + manhattan_dist(i, j, parent_cell / columns, parent_cell % columns);
+
+            if (visit_stamp[jump_point] == query_stamp)
             {
-                cell_t* cell = this->cells[up][j];
-                if (cell->empty == 1)
-                    adjacent.push_back( cell );
+                node_t& open_node = pool[node_of_cell[jump_point]];
+                if (open_node.cost <= cost)
+                    return;
+                open_node.cost = cost;
+                open_node.parent = parent_node;
             }
-            int down = i+1;
-            if (down >= 0 && down < rows)
+            else
             {
-                cell_t* cell = this->cells[down][j];
-                if (cell->empty == 1)
-                    adjacent.push_back( cell );
+                node_of_cell[jump_point] = pool.allocate(jump_point, parent_node, cost);
+                visit_stamp[jump_point] = query_stamp;
             }
 
-            //debug
-            // for (auto &cell : adjacent)
-            // {
-            //     std::cout << "adj i: " << cell->row << ", adj j: " << cell->column << "\n";
-            // }
-            // std::cout << "end adj for: " << i << ", " << j << "\n";
+            open.push_or_decrease(jump_point, cost + manhattan_dist(i, j, goal_i, goal_j), cost);
+        }
 
-            return adjacent;
+        void search_t::begin_query()
+        {
+            open.clear();
+            pool.reset();
+            query_stamp++;
+            if (query_stamp == 0)
+            {
+                // stamps wrapped around, old entries could look current again
+                std::fill(visit_stamp.begin(), visit_stamp.end(), 0);
+                std::fill(closed_stamp.begin(), closed_stamp.end(), 0);
+                query_stamp = 1;
+            }
         }
 
-        void search_t::set_cells_from_file(std::string file_path)
+        std::vector< std::pair<int, int> > search_t::produce_path(int goal_node)
         {
-            std::ifstream maze_file (file_path);
-            if (maze_file.is_open())
+            // (adds full path from start to end node included)
+
+            std::vector< std::pair<int, int> > path;
+            // traverse backwards, one cell at a time along the straight line to each parent
+            for (int n = goal_node; n != -1; n = pool[n].parent)
             {
-                int i = 0;
-                std::string line;
-                while (getline(maze_file, line))
+                int i = pool[n].cell / columns;
+                int j = pool[n].cell % columns;
+                path.push_back(std::make_pair(i, j));
+
+                if (pool[n].parent == -1)
+                    break;
+                int parent_cell = pool[pool[n].parent].cell;
+                int di = (parent_cell / columns > i) - (parent_cell / columns < i);
+                int dj = (parent_cell % columns > j) - (parent_cell % columns < j);
+                for (int k = manhattan_dist(i, j, parent_cell / columns, parent_cell % columns) - 1; k > 0; k--)
                 {
-                    if (i == 0)
-                    {
-                        this->rows = stoi(line);
-                        this->cells = (cell_t***) malloc(this->rows * sizeof(cell_t**));
-                    }
-                    else if (i == 1)
-                    {
-                        this->columns = stoi(line);
-                        for(int r = 0; r < this->rows; r++)
-                            this->cells[r] = (cell_t**) malloc(this->columns * sizeof(cell_t*));
-                    }
-                    else
-                    {
-                        int x = 0;
-                        std::string raw_num; // string representation of a number
-                        std::stringstream ss (line);
-                        while (getline(ss, raw_num, ' '))
-                        {
-                            this->cells[i-2][x] = new cell_t(i-2, x, stoi(raw_num));
-                            x++;
-                        }
-                    }
-                    i++;
+                    i += di;
+                    j += dj;
+                    path.push_back(std::make_pair(i, j));
                 }
-                
-                // debug saved map
-                // for (int o=0; o < this->rows; o++)
-                // {
-                //     for (int p=0; p < this->columns; p++)
-                //         std::cout << this->cells[o][p]->empty << " ";
-                //     std::cout << "\n";
-                // }
-                maze_file.close();
             }
+
+            std::reverse(path.begin(), path.end());
+            return path;
         }
     }
 }
@@ -6,79 +6,121 @@
 #include <fstream>
 #include <ros/ros.h>
 
+#include "prx/utilities/applications/indexed_heap.hpp"
+#include "prx/utilities/applications/occupancy_grid.hpp"
+
 namespace prx
 {
     namespace util
     {
-        class cell_t
+        // A search node, compact enough that a whole query's worth lives in one contiguous pool
+        struct node_t
         {
-          public:
-            cell_t(int r, int c, int empty_state); // row, column, whether its empty or not
-            virtual ~cell_t();
-
-            int row = -1;
-            int column = -1;   
-            int empty = 1; // 1 is empty, 0 is non-empty(blocked)
-
-            std::string to_string();
+            int cell;   // row*columns+col of the cell it refers to
+            int parent; // index of the parent node in the pool, -1 for the root
+            int cost;   // g
         };
 
-        class node_t
+        // Per-query arena of search nodes. Storage is kept across queries so that steady state
+        // planning does not allocate, and reset only rewinds the allocation counter.
+        class node_pool_t
         {
           public:
-            node_t(cell_t* c, node_t* par); // the cell it refers to, parent node
-            virtual ~node_t();
+            node_pool_t();
+            virtual ~node_pool_t();
 
-            cell_t* cell = NULL;
-            node_t* parent = NULL;
-            
-            // g
-            int cost = 0;
-            // h
-            int get_heur(cell_t* goal);
+            // returns the index of the new node
+            int allocate(int cell, int parent, int cost);
 
-            // f
-            int get_cost_and_heur(cell_t* goal);
+            node_t& operator[](int index) { return nodes[index]; }
+            const node_t& operator[](int index) const { return nodes[index]; }
 
-            std::vector< std::pair<int, int> > produce_path();
+            // release every node in O(1)
+            void reset() { used = 0; }
 
-            // get Manhattan distance between two coordinates
-            int manhattan_dist(cell_t* a, cell_t* b);
-            int manhattan_dist(int a_i, int a_j, int b_i, int b_j);
+            int size() const { return used; }
+
+            // most nodes ever live at once, and the bytes reserved to hold them
+            int get_high_water_mark() const { return high_water_mark; }
+            size_t get_reserved_bytes() const { return nodes.capacity() * sizeof(node_t); }
+
+          private:
+            std::vector< node_t > nodes;
+            int used;
+            int high_water_mark;
         };
 
         class search_t
         {
+          public:
+            // planners available through search()
+            enum algorithm_t
+            {
+                A_STAR, JUMP_POINT
+            };
+
           private:
             int rows = 0;
             int columns = 0;
 
-            // the 2D array of cells in the environment/graph
-            cell_t*** cells = NULL;
+            // the environment/graph, loaded and owned by the application
+            const occupancy_grid_t* grid = NULL;
+
+            // nodes reached by the current query
+            node_pool_t pool;
+
+            // per-cell search state, indexed by row*columns+col and valid only where visit_stamp matches query_stamp
+            std::vector< int > node_of_cell;
+            std::vector< unsigned > visit_stamp;
+            std::vector< unsigned > closed_stamp;
+            unsigned query_stamp = 0;
+
+            // open set of cell indices keyed by f = g + h
+            indexed_heap_t open;
+
+            // number of nodes expanded by the last query
+            int expansions = 0;
 
             // perform a-star search
             std::vector< std::pair<int, int> > a_star(int initial_i, int initial_j, int goal_i, int goal_j);
 
-            // return node in nodes (list) if the node is referencing the target cell, otherwise NULL
-            node_t* find_node_by_cell(std::list< node_t* > nodes, cell_t* cell);
+            // perform jump point search, specialised for the uniform cost 4-connected maze
+            std::vector< std::pair<int, int> > jump_point_search(int initial_i, int initial_j, int goal_i, int goal_j);
+
+            // scan from (i, j) along a row or a column and return the index of the first jump point, -1 if there is none
+            int jump_horizontal(int i, int j, int dj, int goal) const;
+            int jump_vertical(int i, int j, int di, int goal) const;
+
+            // queue a jump point found from the node at parent_node, keeping the cheaper of two routes to it
+            void push_jump_point(int jump_point, int parent_node, int goal_i, int goal_j);
+
+            // start a new query, invalidating the per-cell state of the previous one in O(1)
+            void begin_query();
+
+            // walk the parent links back from the goal node, filling in the cells between jump points
+            std::vector< std::pair<int, int> > produce_path(int goal_node);
 
-            // find the least est. cost node in a collection of nodes
-            node_t* least_est_cost_node(std::list< node_t* > nodes, cell_t* goal);
-            
-            // given a cell's coordinates, return a vector containing left, right, up, down cells, if they exist
-            // (vector type since it may have less than 4 cells)
-            std::vector< cell_t* > get_adjacent_cells(cell_t* cell);
-            std::vector< cell_t* > get_adjacent_cells(int i, int j);
-            
-            // READ file data and fill cells member with data
-            void set_cells_from_file(std::string file_path);
+            // size the per-cell search state for the current grid
+            void allocate_workspace();
 
           public:
             search_t();
             virtual ~search_t();
 
-            std::vector< std::pair<int, int> > search(std::string file_path, 
-                int initial_i, int initial_j, int goal_i, int goal_j);
+            // search on a grid owned by the caller, see load_maze
+            void set_grid(const occupancy_grid_t* shared_grid);
+
+            std::vector< std::pair<int, int> > search(int initial_i, int initial_j, int goal_i, int goal_j,
+                algorithm_t algorithm = A_STAR);
+
+            // nodes expanded by the last query, jump points only in JUMP_POINT mode
+            int get_expansions() const { return expansions; }
+
+            // bytes held by the search workspace, which stays flat once the largest query has been seen
+            size_t get_memory_high_water_mark() const;
+
+            // get Manhattan distance between two coordinates
+            static int manhattan_dist(int a_i, int a_j, int b_i, int b_j);
         };
 
 
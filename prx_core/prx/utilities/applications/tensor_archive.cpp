@@ -0,0 +1,178 @@
+#include "prx/utilities/applications/tensor_archive.hpp"
+#include "prx/utilities/definitions/defs.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prx
+{
+
+    namespace util
+    {
+        static const char tensor_archive_magic[8] = {'P', 'R', 'X', 'T', 'E', 'N', 'S', '\0'};
+        static const uint32_t tensor_archive_version = 1;
+
+        size_t tensor_archive_t::tensor_t::get_element_count() const
+        {
+            size_t count = 1;
+            for (unsigned i = 0; i < shape.size(); ++i)
+                count *= shape[i];
+            return count;
+        }
+
+        tensor_archive_t::tensor_archive_t()
+        {
+            mapping = NULL;
+            mapping_bytes = 0;
+        }
+
+        tensor_archive_t::~tensor_archive_t()
+        {
+            close();
+        }
+
+        void tensor_archive_t::close()
+        {
+            if (mapping != NULL)
+                munmap(mapping, mapping_bytes);
+            mapping = NULL;
+            mapping_bytes = 0;
+            tensors.clear();
+            description.clear();
+        }
+
+        void tensor_archive_t::swap(tensor_archive_t& other)
+        {
+            description.swap(other.description);
+            tensors.swap(other.tensors);
+            std::swap(mapping, other.mapping);
+            std::swap(mapping_bytes, other.mapping_bytes);
+        }
+
+        bool tensor_archive_t::is_archive(const std::string& file_path)
+        {
+            char magic[8];
+            int fd = ::open(file_path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            bool found = read(fd, magic, sizeof(magic)) == sizeof(magic) && std::memcmp(magic, tensor_archive_magic, sizeof(magic)) == 0;
+            ::close(fd);
+            return found;
+        }
+
+        bool tensor_archive_t::write(const std::string& file_path, const std::string& description, const std::vector<tensor_t>& tensors)
+        {
+            tensor_archive_header_t header;
+            std::memset(&header, 0, sizeof(header));
+            if (description.size() >= sizeof(header.description))
+                return false;
+            std::memcpy(header.magic, tensor_archive_magic, sizeof(header.magic));
+            header.version = tensor_archive_version;
+            header.tensor_count = tensors.size();
+            std::memcpy(header.description, description.data(), description.size());
+
+            std::vector<tensor_archive_entry_t> entries(tensors.size());
+            uint64_t offset = sizeof(header) + entries.size() * sizeof(tensor_archive_entry_t);
+            for (unsigned t = 0; t < tensors.size(); ++t)
+            {
+                tensor_archive_entry_t& entry = entries[t];
+                std::memset(&entry, 0, sizeof(entry));
+                if (tensors[t].name.size() >= sizeof(entry.name) || tensors[t].shape.size() > 4)
+                    return false;
+                std::memcpy(entry.name, tensors[t].name.data(), tensors[t].name.size());
+                entry.dtype = tensors[t].dtype;
+                entry.rank = tensors[t].shape.size();
+                for (unsigned d = 0; d < entry.rank; ++d)
+                    entry.shape[d] = tensors[t].shape[d];
+                offset = (offset + 63) / 64 * 64;
+                entry.offset = offset;
+                entry.bytes = tensors[t].bytes;
+                offset += entry.bytes;
+            }
+
+            std::ofstream fout(file_path.c_str(), std::ios::binary);
+            fout.write((const char*)&header, sizeof(header));
+            if (!entries.empty())
+                fout.write((const char*)entries.data(), entries.size() * sizeof(tensor_archive_entry_t));
+            const char padding[64] = {0};
+            uint64_t position = sizeof(header) + entries.size() * sizeof(tensor_archive_entry_t);
+            for (unsigned t = 0; t < tensors.size(); ++t)
+            {
+                fout.write(padding, entries[t].offset - position);
+                fout.write((const char*)tensors[t].data, tensors[t].bytes);
+                position = entries[t].offset + entries[t].bytes;
+            }
+            return fout.good();
+        }
+
+        bool tensor_archive_t::open(const std::string& file_path)
+        {
+            close();
+
+            int fd = ::open(file_path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(tensor_archive_header_t))
+            {
+                ::close(fd);
+                return false;
+            }
+            size_t bytes = file_stat.st_size;
+            void* region = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (region == MAP_FAILED)
+                return false;
+
+            const char* base = (const char*)region;
+            const tensor_archive_header_t* header = (const tensor_archive_header_t*)base;
+            bool valid = std::memcmp(header->magic, tensor_archive_magic, sizeof(tensor_archive_magic)) == 0
+                && header->version == tensor_archive_version
+                && sizeof(tensor_archive_header_t) + (uint64_t)header->tensor_count * sizeof(tensor_archive_entry_t) <= bytes;
+
+            std::vector<tensor_t> read_tensors;
+            const tensor_archive_entry_t* entries = (const tensor_archive_entry_t*)(base + sizeof(tensor_archive_header_t));
+            for (uint32_t t = 0; valid && t < header->tensor_count; ++t)
+            {
+                const tensor_archive_entry_t& entry = entries[t];
+                tensor_t tensor;
+                tensor.name = std::string(entry.name, strnlen(entry.name, sizeof(entry.name)));
+                tensor.dtype = (dtype_t)entry.dtype;
+                tensor.data = base + entry.offset;
+                tensor.bytes = entry.bytes;
+                size_t element_size = entry.dtype == INT8 ? 1 : 4;
+                valid = entry.rank <= 4 && (entry.dtype == FLOAT32 || entry.dtype == INT8 || entry.dtype == INT32)
+                    && entry.offset % 64 == 0 && entry.offset <= bytes && entry.bytes <= bytes - entry.offset;
+                for (uint32_t d = 0; valid && d < entry.rank; ++d)
+                    tensor.shape.push_back(entry.shape[d]);
+                valid = valid && tensor.get_element_count() * element_size == entry.bytes;
+                read_tensors.push_back(tensor);
+            }
+
+            if (!valid)
+            {
+                munmap(region, bytes);
+                return false;
+            }
+
+            mapping = region;
+            mapping_bytes = bytes;
+            tensors.swap(read_tensors);
+            description = std::string(header->description, strnlen(header->description, sizeof(header->description)));
+            return true;
+        }
+
+        const tensor_archive_t::tensor_t* tensor_archive_t::find(const std::string& name) const
+        {
+            for (unsigned i = 0; i < tensors.size(); ++i)
+                if (tensors[i].name == name)
+                    return &tensors[i];
+            return NULL;
+        }
+    }
+}
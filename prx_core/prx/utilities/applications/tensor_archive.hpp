@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef PRX_UTIL_TENSOR_ARCHIVE_HPP
+#define	PRX_UTIL_TENSOR_ARCHIVE_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        // Layout of the tensor archive written by sensing/export_weights.py. Everything is little-endian:
+        // the header, tensor_count entries, then the payloads, each starting on a 64 byte boundary.
+        struct tensor_archive_header_t
+        {
+            char magic[8];              // "PRXTENS\0"
+            uint32_t version;
+            uint32_t tensor_count;
+            char description[240];      // layer description of the network, may be empty
+        };
+
+        struct tensor_archive_entry_t
+        {
+            char name[64];
+            uint32_t dtype;
+            uint32_t rank;
+            uint64_t shape[4];
+            uint64_t offset;            // from the start of the file
+            uint64_t bytes;
+        };
+
+        /**
+         * A read-only tensor archive mapped with mmap. The tensors are views into the mapping, so
+         * loading a model does no copies.
+         *
+         * @brief <b> Memory mapped archive of named tensors </b>
+         */
+        class tensor_archive_t
+        {
+          public:
+            enum dtype_t
+            {
+                FLOAT32 = 1, INT8 = 2, INT32 = 3
+            };
+
+            struct tensor_t
+            {
+                std::string name;
+                dtype_t dtype;
+                std::vector<int64_t> shape;
+                const void* data;
+                size_t bytes;
+
+                size_t get_element_count() const;
+            };
+
+            tensor_archive_t();
+            virtual ~tensor_archive_t();
+
+            // map an archive, returns false and leaves the archive empty if it is missing or invalid
+            bool open(const std::string& file_path);
+            void close();
+
+            // exchange the mappings of two archives
+            void swap(tensor_archive_t& other);
+
+            // true if the file starts with the archive magic
+            static bool is_archive(const std::string& file_path);
+
+            // writes tensors (data and bytes have to be set) in the layout open reads, returns false if the
+            // file cannot be written or a name or the description does not fit
+            static bool write(const std::string& file_path, const std::string& description, const std::vector<tensor_t>& tensors);
+
+            const std::string& get_description() const { return description; }
+            const std::vector<tensor_t>& get_tensors() const { return tensors; }
+
+            // NULL if there is no tensor with this name
+            const tensor_t* find(const std::string& name) const;
+
+          protected:
+            std::string description;
+            std::vector<tensor_t> tensors;
+            void* mapping;
+            size_t mapping_bytes;
+
+          private:
+            tensor_archive_t(const tensor_archive_t&);
+            tensor_archive_t& operator=(const tensor_archive_t&);
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file shared_frame_ring.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/communication/shared_frame_ring.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace prx
+{
+    namespace util
+    {
+        static const char shared_frame_magic[8] = {'P', 'R', 'X', 'F', 'R', 'A', 'M', 'E'};
+        static const uint32_t shared_frame_version = 1;
+
+        // the segment is the header, then slot_count slots of a slot_t and slot_bytes of pixels, all
+        // on 64 byte boundaries
+        struct shared_frame_ring_t::header_t
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t slot_count;
+            uint64_t slot_bytes;
+            uint64_t slot_stride;
+            uint64_t latest;
+            char padding[24];
+        };
+
+        struct shared_frame_ring_t::slot_t
+        {
+            // odd while the writer is in the slot
+            uint64_t lock;
+            uint64_t sequence;
+            int32_t width, height, channels, bottom_up;
+            uint64_t row_bytes;
+            double stamp;
+            char padding[16];
+        };
+
+        static inline size_t round_up(size_t bytes)
+        {
+            return (bytes + 63) / 64 * 64;
+        }
+
+        shared_frame_ring_t::shared_frame_ring_t()
+        {
+            owner = false;
+            header = NULL;
+            mapping_bytes = 0;
+            writing = NULL;
+        }
+
+        shared_frame_ring_t::~shared_frame_ring_t()
+        {
+            close();
+        }
+
+        bool shared_frame_ring_t::map(int fd, size_t bytes, bool writable)
+        {
+            void* region = mmap(NULL, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+            if (region == MAP_FAILED)
+                return false;
+            header = (header_t*)region;
+            mapping_bytes = bytes;
+            return true;
+        }
+
+        bool shared_frame_ring_t::create(const std::string& name, unsigned slot_count, size_t slot_bytes)
+        {
+            close();
+            if (slot_count == 0)
+                return false;
+            size_t stride = sizeof(slot_t) + round_up(slot_bytes);
+            size_t bytes = sizeof(header_t) + slot_count * stride;
+
+            shm_unlink(name.c_str());
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+            if (fd < 0)
+                return false;
+            // the mapping outlives the descriptor, which is closed here whether or not mapping worked
+            bool mapped = ftruncate(fd, bytes) == 0 && map(fd, bytes, true);
+            ::close(fd);
+            if (!mapped)
+            {
+                shm_unlink(name.c_str());
+                return false;
+            }
+
+            // the segment starts zeroed, so every slot is unlocked and empty
+            header->version = shared_frame_version;
+            header->slot_count = slot_count;
+            header->slot_bytes = slot_bytes;
+            header->slot_stride = stride;
+            header->latest = 0;
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            std::memcpy(header->magic, shared_frame_magic, sizeof(header->magic));
+            this->name = name;
+            owner = true;
+            return true;
+        }
+
+        bool shared_frame_ring_t::open(const std::string& name)
+        {
+            close();
+            int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                return false;
+            struct stat segment;
+            bool mapped = fstat(fd, &segment) == 0 && (size_t)segment.st_size >= sizeof(header_t) && map(fd, segment.st_size, false);
+            ::close(fd);
+            if (!mapped)
+                return false;
+            bool valid = std::memcmp(header->magic, shared_frame_magic, sizeof(shared_frame_magic)) == 0
+                && header->version == shared_frame_version && header->slot_count > 0
+                && sizeof(header_t) + header->slot_count * header->slot_stride <= mapping_bytes;
+            if (!valid)
+            {
+                close();
+                return false;
+            }
+            this->name = name;
+            return true;
+        }
+
+        void shared_frame_ring_t::close()
+        {
+            if (header != NULL)
+                munmap(header, mapping_bytes);
+            if (owner)
+                shm_unlink(name.c_str());
+            header = NULL;
+            mapping_bytes = 0;
+            owner = false;
+            writing = NULL;
+        }
+
+        shared_frame_ring_t::slot_t* shared_frame_ring_t::get_slot(uint64_t sequence) const
+        {
+            return (slot_t*)((char*)header + sizeof(header_t) + (sequence % header->slot_count) * header->slot_stride);
+        }
+
+        unsigned char* shared_frame_ring_t::begin_write(int width, int height, int channels, size_t row_bytes, bool bottom_up)
+        {
+            if (!owner || (uint64_t)row_bytes * height > header->slot_bytes)
+                return NULL;
+            uint64_t sequence = header->latest + 1;
+            writing = get_slot(sequence);
+            __atomic_store_n(&writing->lock, writing->lock + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            writing->sequence = sequence;
+            writing->width = width;
+            writing->height = height;
+            writing->channels = channels;
+            writing->bottom_up = bottom_up;
+            writing->row_bytes = row_bytes;
+            return (unsigned char*)(writing + 1);
+        }
+
+        uint64_t shared_frame_ring_t::end_write()
+        {
+            if (writing == NULL)
+                return 0;
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            writing->stamp = now.tv_sec + now.tv_usec * 1e-6;
+            uint64_t sequence = writing->sequence;
+            __atomic_store_n(&writing->lock, writing->lock + 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&header->latest, sequence, __ATOMIC_RELEASE);
+            writing = NULL;
+            return sequence;
+        }
+
+        uint64_t shared_frame_ring_t::get_latest_sequence() const
+        {
+            return header == NULL ? 0 : __atomic_load_n(&header->latest, __ATOMIC_ACQUIRE);
+        }
+
+        bool shared_frame_ring_t::read_latest(shared_frame_t& frame) const
+        {
+            // a few tries, in case the writer laps the slot between reading latest and the slot
+            for (int attempt = 0; attempt < 4; ++attempt)
+            {
+                uint64_t sequence = get_latest_sequence();
+                if (sequence == 0)
+                    return false;
+                const slot_t* slot = get_slot(sequence);
+                uint64_t lock = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+                if (lock % 2 != 0 || slot->sequence != sequence)
+                    continue;
+                frame.sequence = sequence;
+                frame.width = slot->width;
+                frame.height = slot->height;
+                frame.channels = slot->channels;
+                frame.row_bytes = slot->row_bytes;
+                frame.bottom_up = slot->bottom_up != 0;
+                frame.stamp = slot->stamp;
+                frame.pixels = (const unsigned char*)(slot + 1);
+                if (is_valid(frame))
+                    return true;
+            }
+            return false;
+        }
+
+        bool shared_frame_ring_t::wait_for_frame(uint64_t sequence, double timeout, shared_frame_t& frame) const
+        {
+            for (double waited = 0; waited <= timeout; waited += 0.001)
+            {
+                if (get_latest_sequence() > sequence && read_latest(frame))
+                    return true;
+                usleep(1000);
+            }
+            return false;
+        }
+
+        bool shared_frame_ring_t::is_valid(const shared_frame_t& frame) const
+        {
+            if (header == NULL || frame.sequence == 0)
+                return false;
+            const slot_t* slot = get_slot(frame.sequence);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            return __atomic_load_n(&slot->lock, __ATOMIC_RELAXED) % 2 == 0 && slot->sequence == frame.sequence;
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * @file shared_frame_ring.hpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+#pragma once
+
+#ifndef PRX_SHARED_FRAME_RING_HPP
+#define	PRX_SHARED_FRAME_RING_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace prx
+{
+    namespace util
+    {
+        /**
+         * A frame in a \ref shared_frame_ring_t. The pixels point into the shared mapping, so they are only
+         * good while shared_frame_ring_t::is_valid says the slot has not been rewritten.
+         *
+         * @brief <b> A view of one frame in shared memory </b>
+         */
+        struct shared_frame_t
+        {
+            shared_frame_t() : sequence(0), width(0), height(0), channels(0), row_bytes(0), bottom_up(false), stamp(0), pixels(NULL) { }
+
+            /** @brief Frames are numbered from 1 in the order they were written */
+            uint64_t sequence;
+            int width, height, channels;
+            size_t row_bytes;
+            /** @brief True if the first row is the bottom of the image, as read back from OpenGL */
+            bool bottom_up;
+            /** @brief Wall clock seconds when the frame was written */
+            double stamp;
+            const unsigned char* pixels;
+        };
+
+        /**
+         * A ring of frame slots in POSIX shared memory, written by one process, such as the visualization
+         * reading back its framebuffer, and read by others without copies, encoding or files. Every slot
+         * is guarded by a sequence lock, so a reader can tell whether the writer reused the slot while it
+         * was reading. Any process can stand in for the writer, which is how it runs headless.
+         *
+         * @brief <b> Shared memory ring buffer of frames </b>
+         */
+        class shared_frame_ring_t
+        {
+          public:
+            shared_frame_ring_t();
+            virtual ~shared_frame_ring_t();
+
+            /**
+             * Creates the ring as its writer, replacing a ring with the same name. The name is a POSIX shared
+             * memory name such as "/prx_frames". Returns false if the segment cannot be created.
+             */
+            bool create(const std::string& name, unsigned slot_count, size_t slot_bytes);
+
+            // maps an existing ring to read it, returns false if there is none
+            bool open(const std::string& name);
+
+            // unmaps the ring, and removes it if this is its writer
+            void close();
+
+            bool is_open() const { return header != NULL; }
+
+            /**
+             * Starts writing the next frame and returns where its pixels go, or NULL if the frame does not
+             * fit in a slot. Readers see the frame once end_write returns its sequence number.
+             */
+            unsigned char* begin_write(int width, int height, int channels, size_t row_bytes, bool bottom_up);
+            uint64_t end_write();
+
+            // the sequence number of the newest frame, 0 before the first
+            uint64_t get_latest_sequence() const;
+
+            // the newest frame, false if there is none yet
+            bool read_latest(shared_frame_t& frame) const;
+
+            // waits up to timeout seconds for a frame newer than sequence, polling every millisecond
+            bool wait_for_frame(uint64_t sequence, double timeout, shared_frame_t& frame) const;
+
+            // false once the slot of the frame has been rewritten, anything read from it since is unreliable
+            bool is_valid(const shared_frame_t& frame) const;
+
+          protected:
+            struct header_t;
+            struct slot_t;
+
+            slot_t* get_slot(uint64_t sequence) const;
+            // maps bytes of fd; the caller closes fd
+            bool map(int fd, size_t bytes, bool writable);
+
+            std::string name;
+            bool owner;
+            header_t* header;
+            size_t mapping_bytes;
+            // the slot begin_write handed out
+            slot_t* writing;
+
+          private:
+            shared_frame_ring_t(const shared_frame_ring_t&);
+            shared_frame_ring_t& operator=(const shared_frame_ring_t&);
+        };
+    }
+}
+
+#endif
@@ -63,5 +63,13 @@ namespace prx
             //    PRX_INFO_S("tftoRAT:" << rat.getX() << "," << rat.getY()<< "," << rat.getZ()<< "," << rat.getW());
         }
 
+        void tf_broadcaster_t::queue_positions(const std::vector<std::string>& names, const double* x, const double* y, double z, const tf::Quaternion& orientation)
+        {
+            ros::Time now = ros::Time::now();
+            transforms.reserve(transforms.size() + names.size());
+            for (unsigned k = 0; k < names.size(); ++k)
+                transforms.push_back(tf::StampedTransform(tf::Transform(orientation, tf::Vector3(x[k], y[k], z)), now, "map", names[k]));
+        }
+
     }
 }
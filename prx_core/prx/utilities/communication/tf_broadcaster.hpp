@@ -48,6 +48,19 @@ namespace prx
              */
             void queue_config(const config_t& config, const std::string& name);
 
+            /**
+             * Queues the positions of many frames with one orientation, all stamped with the same time, so a
+             * whole fleet goes out in the next broadcast as one message
+             * 
+             * @brief Queues the positions of many frames at once
+             * @param names The pathnames used to index the configurations
+             * @param x The x coordinate of every frame
+             * @param y The y coordinate of every frame
+             * @param z The z coordinate shared by the frames
+             * @param orientation The orientation shared by the frames
+             */
+            void queue_positions(const std::vector<std::string>& names, const double* x, const double* y, double z, const tf::Quaternion& orientation);
+
             /**
              * Broadcasts all queued configurations, and then clears the queue
              * 
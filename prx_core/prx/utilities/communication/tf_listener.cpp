@@ -19,9 +19,45 @@ namespace prx
     namespace util
     {
 
+        tf_listener_t::tf_listener_t()
+        {
+            lookup_count = 0;
+            stamp_query_count = 0;
+        }
+
+        void tf_listener_t::reset_counters() const
+        {
+            lookup_count = 0;
+            stamp_query_count = 0;
+        }
+
+        bool tf_listener_t::lookup_if_changed(const std::string& name, config_t& config, tf_stamp_t& stamp) const
+        {
+            ros::Time latest;
+            std::string error;
+            stamp_query_count++;
+            if( tf_listener.getLatestCommonTime("map", name, latest, &error) != tf::NO_ERROR )
+                return false;
+            if( stamp.resolved && latest == stamp.time )
+                return false;
+
+            try
+            {
+                lookup(name, config);
+            }
+            catch( tf::TransformException ex )
+            {
+                return false;
+            }
+            stamp.time = latest;
+            stamp.resolved = true;
+            return true;
+        }
+
         void tf_listener_t::lookup(const std::string& name, config_t& config) const
         {
             tf::StampedTransform transform;
+            lookup_count++;
 
             try
             {
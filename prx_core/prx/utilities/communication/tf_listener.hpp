@@ -25,6 +25,22 @@ namespace prx
 
         class config_t;
 
+        /**
+         * The tf stamp a cached transform was last read at, used to skip lookups
+         * of transforms that have not changed.
+         *
+         * @brief <b> The stamp of a cached transform </b>
+         */
+        struct tf_stamp_t
+        {
+            tf_stamp_t() : resolved(false) { }
+
+            /** @brief The stamp of the latest transform read */
+            ros::Time time;
+            /** @brief Whether the transform has been read at all */
+            bool resolved;
+        };
+
         /**
          * This class is used to access transforms stored in tf and create configurations
          * from these transforms for use in other classes.
@@ -39,6 +55,8 @@ namespace prx
 
           public:
 
+            tf_listener_t();
+
             /**
              * Performs a global transformation lookup and update the given config
              * 
@@ -48,10 +66,34 @@ namespace prx
              */
             void lookup(const std::string& name, config_t& config) const;
 
+            /**
+             * Asks tf for the latest stamp of the transform and only performs the lookup
+             * when it differs from the cached stamp. Missing transforms are reported by the
+             * return value instead of an exception.
+             *
+             * @brief Looks up a transform only if it has changed since the cached stamp
+             * @param name The pathname to lookup
+             * @param config The configuration that will be updated
+             * @param stamp The cached stamp, updated when the lookup is performed
+             * @return True if config was updated
+             */
+            bool lookup_if_changed(const std::string& name, config_t& config, tf_stamp_t& stamp) const;
+
+            /** @brief Full transform lookups performed since the counters were reset */
+            unsigned get_lookup_count() const { return lookup_count; }
+
+            /** @brief Stamp queries performed by lookup_if_changed since the counters were reset */
+            unsigned get_stamp_query_count() const { return stamp_query_count; }
+
+            void reset_counters() const;
+
           private:
             /** @brief The ros::tf listener */
             tf::TransformListener tf_listener;
 
+            mutable unsigned lookup_count;
+            mutable unsigned stamp_query_count;
+
         };
 
     }
@@ -0,0 +1,96 @@
+/**
+ * @file thread_pool.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/utilities/definitions/thread_pool.hpp"
+
+namespace prx
+{
+    namespace util
+    {
+        thread_pool_t::thread_pool_t(unsigned thread_count)
+        {
+            if (thread_count == 0)
+                thread_count = std::thread::hardware_concurrency();
+            work = NULL;
+            task_count = 0;
+            next_task = 0;
+            busy = 0;
+            job = 0;
+            stopping = false;
+            for (unsigned t = 1; t < thread_count; ++t)
+                workers.push_back(std::thread(&thread_pool_t::work_loop, this, t));
+        }
+
+        thread_pool_t::~thread_pool_t()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            job_ready.notify_all();
+            for (unsigned t = 0; t < workers.size(); ++t)
+                workers[t].join();
+        }
+
+        void thread_pool_t::take_tasks(unsigned thread)
+        {
+            for (int task = next_task++; task < task_count; task = next_task++)
+                (*work)(task, thread);
+        }
+
+        void thread_pool_t::work_loop(unsigned thread)
+        {
+            unsigned long finished_job = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while (!stopping && job == finished_job)
+                        job_ready.wait(lock);
+                    if (stopping)
+                        return;
+                    finished_job = job;
+                }
+                take_tasks(thread);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy == 0)
+                    job_done.notify_one();
+            }
+        }
+
+        void thread_pool_t::run(int task_count, const work_t& work)
+        {
+            if (workers.empty() || task_count <= 1)
+            {
+                for (int task = 0; task < task_count; ++task)
+                    work(task, 0);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                this->work = &work;
+                this->task_count = task_count;
+                next_task = 0;
+                busy = workers.size();
+                ++job;
+            }
+            job_ready.notify_all();
+            take_tasks(0);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while (busy > 0)
+                job_done.wait(lock);
+            this->work = NULL;
+        }
+    }
+}
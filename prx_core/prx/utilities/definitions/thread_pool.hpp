@@ -0,0 +1,76 @@
+/**
+ * @file thread_pool.hpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+#pragma once
+
+#ifndef PRX_THREAD_POOL_HPP
+#define PRX_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace prx
+{
+    namespace util
+    {
+        /**
+         * A fixed set of threads that run the tasks of one job at a time. The thread calling run works on
+         * the job too, as thread 0, so a pool of one thread runs everything inline. Tasks are handed out in
+         * order but finish in any order; work that has to be reproducible writes every task's result to its
+         * own place and combines them in task order afterwards.
+         *
+         * @brief <b> Pool of worker threads for data parallel jobs </b>
+         */
+        class thread_pool_t
+        {
+          public:
+            typedef std::function<void (int task, unsigned thread)> work_t;
+
+            // thread_count 0 uses one thread per core
+            thread_pool_t(unsigned thread_count = 0);
+            virtual ~thread_pool_t();
+
+            // the number of threads a job runs on, including the caller
+            unsigned get_thread_count() const { return workers.size() + 1; }
+
+            // runs work for every task in [0, task_count) and returns when all of them are done
+            void run(int task_count, const work_t& work);
+
+          protected:
+            void work_loop(unsigned thread);
+            // takes tasks of the current job until there are none left
+            void take_tasks(unsigned thread);
+
+            std::vector<std::thread> workers;
+            std::mutex mutex;
+            std::condition_variable job_ready, job_done;
+            const work_t* work;
+            int task_count;
+            std::atomic<int> next_task;
+            // workers still in the current job
+            unsigned busy;
+            // counts jobs, so a worker can tell a new one from the one it finished
+            unsigned long job;
+            bool stopping;
+
+          private:
+            thread_pool_t(const thread_pool_t&);
+            thread_pool_t& operator=(const thread_pool_t&);
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file osg_mesh_batch.cpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+
+#include "prx/visualization/PLUGINS/OSG/osg_mesh_batch.hpp"
+
+namespace prx
+{
+    using namespace util;
+
+    namespace vis
+    {
+        // Sums the drawables of every geode below a node
+        class drawable_counter_t : public osg::NodeVisitor
+        {
+          public:
+            drawable_counter_t() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), count(0) { }
+
+            virtual void apply(osg::Geode& geode)
+            {
+                count += geode.getNumDrawables();
+            }
+
+            unsigned count;
+        };
+
+        osg_mesh_batch_t::osg_mesh_batch_t()
+        {
+            root = new osg::Group();
+            root->setName("mesh_batch");
+            instance_count = 0;
+        }
+
+        osg::Node* osg_mesh_batch_t::get_mesh(const std::string& filename)
+        {
+            boost::unordered_map< std::string, osg::ref_ptr<osg::Node>, string_hash>::iterator found = meshes.find(filename);
+            if( found != meshes.end() )
+                return found->second.get();
+            osg::ref_ptr<osg::Node> mesh = osgDB::readNodeFile(filename);
+            if( mesh == NULL )
+                PRX_WARN_S("Could not read the obstacle mesh " << filename);
+            meshes[filename] = mesh;
+            return mesh.get();
+        }
+
+        void osg_mesh_batch_t::set_material(const std::string& material_name, osg::StateSet* state)
+        {
+            materials[material_name] = state;
+        }
+
+        bool osg_mesh_batch_t::has_material(const std::string& material_name) const
+        {
+            return materials.find(material_name) != materials.end();
+        }
+
+        bool osg_mesh_batch_t::add(const std::string& filename, const std::string& material_name, const osg::Matrixd& transform)
+        {
+            PRX_ASSERT(has_material(material_name));
+            osg::Node* mesh = get_mesh(filename);
+            if( mesh == NULL )
+                return false;
+
+            osg::ref_ptr<osg::Group>& group = pending[material_name];
+            if( group == NULL )
+            {
+                group = new osg::Group();
+                group->setName("mesh_batch:" + material_name);
+                group->setStateSet(materials[material_name].get());
+            }
+            // shared by every instance until merge flattens the transforms into copies of it
+            osg::ref_ptr<osg::MatrixTransform> instance = new osg::MatrixTransform(transform);
+            instance->setDataVariance(osg::Object::STATIC);
+            instance->addChild(mesh);
+            group->addChild(instance);
+            instance_count++;
+            return true;
+        }
+
+        void osg_mesh_batch_t::merge()
+        {
+            for( boost::unordered_map< std::string, osg::ref_ptr<osg::Group>, string_hash>::iterator it = pending.begin(); it != pending.end(); ++it )
+            {
+                osg::Group* group = it->second.get();
+                unsigned before = count_drawables(group);
+                osgUtil::Optimizer optimizer;
+                optimizer.optimize(group, osgUtil::Optimizer::STATIC_OBJECT_DETECTION | osgUtil::Optimizer::SHARE_DUPLICATE_STATE
+                                   | osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | osgUtil::Optimizer::REMOVE_REDUNDANT_NODES
+                                   | osgUtil::Optimizer::MERGE_GEODES | osgUtil::Optimizer::MERGE_GEOMETRY);
+                root->addChild(group);
+                PRX_DEBUG_COLOR("Mesh batch " << it->first << ": " << group->getNumChildren() << " nodes, " << before << " drawables merged into "
+                                << count_drawables(group), PRX_TEXT_GREEN);
+            }
+            pending.clear();
+        }
+
+        unsigned osg_mesh_batch_t::count_drawables() const
+        {
+            return count_drawables(root.get());
+        }
+
+        unsigned osg_mesh_batch_t::count_drawables(osg::Node* node)
+        {
+            drawable_counter_t counter;
+            node->accept(counter);
+            return counter.count;
+        }
+
+    }
+}
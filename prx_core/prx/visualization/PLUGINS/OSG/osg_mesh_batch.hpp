@@ -0,0 +1,84 @@
+/**
+ * @file osg_mesh_batch.hpp
+ *
+ * @copyright Software License Agreement (BSD License)
+ * Copyright (c) 2013, Rutgers the State University of New Jersey, New Brunswick
+ * All Rights Reserved.
+ * For a full description see the file named LICENSE.
+ *
+ * Authors: Andrew Dobson, Andrew Kimmel, Athanasios Krontiris, Zakary Littlefield, Kostas Bekris
+ *
+ * Email: pracsys@googlegroups.com
+ */
+#pragma once
+
+#ifndef PRACSYS_OSG_MESH_BATCH_HPP
+#define PRACSYS_OSG_MESH_BATCH_HPP
+
+#include "prx/utilities/definitions/hash.hpp"
+#include "prx/visualization/PLUGINS/OSG/osg_basic.hpp"
+
+#include <string>
+
+namespace prx
+{
+    namespace vis
+    {
+
+        /**
+         * Static mesh obstacles drawn as few merged drawables. Every mesh file is read once and every obstacle
+         * adds an instance of it under a static transform, in the group of its material. merge then flattens the
+         * transforms into the vertices and merges the geometry that ends up with the same state, so the walls of
+         * a maze draw with a handful of drawables instead of at least one per wall.
+         *
+         * @brief <b> A batch of static mesh obstacles </b>
+         */
+        class osg_mesh_batch_t
+        {
+
+          public:
+            osg_mesh_batch_t();
+
+            /** @brief The node the batch draws under, added to the scene once */
+            osg::Group* get_root() const { return root.get(); }
+
+            /** @brief The mesh in filename, read on first use; NULL if it cannot be read */
+            osg::Node* get_mesh(const std::string& filename);
+
+            /** @brief The state every instance of a material shares, set once before the first add with it */
+            void set_material(const std::string& material_name, osg::StateSet* state);
+            bool has_material(const std::string& material_name) const;
+
+            /**
+             * Adds one instance of the mesh in filename at transform, drawn with a material set before.
+             *
+             * @brief Adds an instance of a mesh
+             * @return False if the mesh cannot be read
+             */
+            bool add(const std::string& filename, const std::string& material_name, const osg::Matrixd& transform);
+
+            /** @brief Flattens and merges the instances added since the last merge */
+            void merge();
+
+            unsigned get_instance_count() const { return instance_count; }
+
+            /** @brief The drawables the batch renders */
+            unsigned count_drawables() const;
+
+            /** @brief The drawables under any node */
+            static unsigned count_drawables(osg::Node* node);
+
+          protected:
+            osg::ref_ptr<osg::Group> root;
+            boost::unordered_map< std::string, osg::ref_ptr<osg::StateSet>, util::string_hash> materials;
+            /** @brief Instances added since the last merge, one group per material */
+            boost::unordered_map< std::string, osg::ref_ptr<osg::Group>, util::string_hash> pending;
+            /** @brief Read meshes, NULL for files that could not be read */
+            boost::unordered_map< std::string, osg::ref_ptr<osg::Node>, util::string_hash> meshes;
+            unsigned instance_count;
+        };
+
+    }
+}
+
+#endif
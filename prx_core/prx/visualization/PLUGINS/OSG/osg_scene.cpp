@@ -28,6 +28,7 @@
 #include <boost/tuple/tuple.hpp> // boost::tie
 #include <osgUtil/Optimizer>
 #include <queue>
+#include <sstream>
 
 #include <osg/BlendFunc>
 #include <osg/LightModel>
@@ -65,6 +66,10 @@ namespace prx
             {
                 delete it->second;
             }
+            for( boost::unordered_map< std::string, obstacle_batch_t*, string_hash>::iterator it = obstacle_batches.begin(); it != obstacle_batches.end(); ++it )
+            {
+                delete it->second;
+            }
         }
 
         void osg_scene_t::add_light(osg_light_t& light)
@@ -615,6 +620,7 @@ namespace prx
             // ss->setMode(GL_NORMALIZE, osg::StateAttribute::ON); 
 
             root->addChild(lightGroup);
+            root->addChild(mesh_batch.get_root());
 
             PRX_DEBUG_COLOR("Finished Creating the OSG scene.", PRX_TEXT_GREEN);
         }
@@ -1010,6 +1016,139 @@ namespace prx
                 parent->setAttitude(toOSGQuat(root_conf.get_orientation()));
                 parent->setPosition(toVec3(root_conf.get_position()));
                 obstacles[geom_name] = parent;
+                // placed at the origin, tf moves them
+                dynamic_obstacles[geom_name] = true;
+            }
+        }
+
+        void osg_scene_t::add_static_box(const std::string& name, const std::string& material_name, const geometry_t* geom, const config_t& conf)
+        {
+            double lx, ly, lz;
+            geom->get_box(lx, ly, lz);
+            std::stringstream key;
+            key << material_name << "/" << lx << "/" << ly << "/" << lz;
+
+            obstacle_batch_t* batch;
+            if( obstacle_batches.find(key.str()) == obstacle_batches.end() )
+            {
+                batch = new obstacle_batch_t();
+                batch->flushed = 0;
+
+                // The 6 faces of the shared box, two triangles each
+                osg::Vec3 h(lx / 2, ly / 2, lz / 2);
+                batch->box_vertices = new osg::Vec3Array();
+                batch->box_normals = new osg::Vec3Array();
+                for( int axis = 0; axis < 3; axis++ )
+                {
+                    for( int side = -1; side <= 1; side += 2 )
+                    {
+                        osg::Vec3 normal, u, v;
+                        normal[axis] = side;
+                        u[(axis + 1) % 3] = 1;
+                        v[(axis + 2) % 3] = side;
+                        osg::Vec3 corners[4] = {
+                            osg::Vec3(normal - u - v), osg::Vec3(normal + u - v),
+                            osg::Vec3(normal + u + v), osg::Vec3(normal - u + v) };
+                        const int order[6] = {0, 1, 2, 0, 2, 3};
+                        for( int k = 0; k < 6; k++ )
+                        {
+                            const osg::Vec3& c = corners[order[k]];
+                            batch->box_vertices->push_back(osg::Vec3(c.x() * h.x(), c.y() * h.y(), c.z() * h.z()));
+                            batch->box_normals->push_back(normal);
+                        }
+                    }
+                }
+
+                batch->vertices = new osg::Vec3Array();
+                batch->normals = new osg::Vec3Array();
+                batch->triangles = new osg::DrawArrays(osg::PrimitiveSet::TRIANGLES, 0, 0);
+                batch->geometry = new osg::Geometry();
+                batch->geometry->setUseDisplayList(false);
+                batch->geometry->setUseVertexBufferObjects(true);
+                batch->geometry->setVertexArray(batch->vertices);
+                batch->geometry->setNormalArray(batch->normals);
+                batch->geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+                batch->geometry->addPrimitiveSet(batch->triangles);
+                batch->geode = new osg::Geode();
+                batch->geode->setName("obstacle_batch:" + key.str());
+                batch->geode->addDrawable(batch->geometry);
+
+                PRX_ASSERT(template_material_mapping.find(material_name) != template_material_mapping.end());
+                osg_material_t* material = new osg_material_t(*(template_material_mapping[material_name]));
+                material->setColorMode(osg::Material::OFF);
+                batch->geode->getOrCreateStateSet()->setAttribute(material, osg::StateAttribute::ON);
+
+                root->addChild(batch->geode);
+                obstacle_batches[key.str()] = batch;
+            }
+            else
+            {
+                batch = obstacle_batches[key.str()];
+            }
+
+            osg::Matrixd transform = osg::Matrixd::rotate(toOSGQuat(conf.get_orientation())) * osg::Matrixd::translate(toVec3(conf.get_position()));
+            batch->instances.push_back(transform);
+            static_obstacles[name] = batch;
+            obstacle_stamps[name].resolved = true;
+        }
+
+        bool osg_scene_t::add_static_mesh(const std::string& name, const parameter_reader_t* reader, const config_t& conf)
+        {
+            std::string material_name = reader->get_attribute("visualization_geometry/material");
+            if( !mesh_batch.has_material(material_name) )
+            {
+                // the state init_geometries gives a mesh, shared by every mesh of the material
+                PRX_ASSERT(template_material_mapping.find(material_name) != template_material_mapping.end());
+                osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet();
+                osg_material_t* material = new osg_material_t(*(template_material_mapping[material_name]));
+                material->setColorMode(osg::Material::OFF);
+                stateset->setMode(GL_LIGHTING, osg::StateAttribute::ON);
+                stateset->setAttribute(material, osg::StateAttribute::ON);
+                mesh_batch.set_material(material_name, stateset.get());
+            }
+
+            osg::Matrixd transform = osg::Matrixd::rotate(toOSGQuat(conf.get_orientation())) * osg::Matrixd::translate(toVec3(conf.get_position()));
+            if( reader->has_attribute("visualization_geometry/local_transform") )
+            {
+                config_t local_transform = *reader->initialize_new<config_t > (std::string("visualization_geometry/local_transform"));
+                transform = osg::Matrixd::rotate(toOSGQuat(local_transform.get_orientation())) * osg::Matrixd::translate(toVec3(local_transform.get_position())) * transform;
+            }
+            if( !mesh_batch.add(reader->get_attribute("visualization_geometry/filename"), material_name, transform) )
+                return false;
+            static_obstacles[name] = NULL;
+            obstacle_stamps[name].resolved = true;
+            return true;
+        }
+
+        void osg_scene_t::flush_obstacle_batches()
+        {
+            mesh_batch.merge();
+            for( boost::unordered_map< std::string, obstacle_batch_t*, string_hash>::iterator it = obstacle_batches.begin(); it != obstacle_batches.end(); ++it )
+            {
+                obstacle_batch_t* batch = it->second;
+                if( batch->flushed == batch->instances.size() )
+                    continue;
+
+                unsigned box_size = batch->box_vertices->size();
+                batch->vertices->reserve(batch->instances.size() * box_size);
+                batch->normals->reserve(batch->instances.size() * box_size);
+                for( unsigned i = batch->flushed; i < batch->instances.size(); i++ )
+                {
+                    const osg::Matrixd& transform = batch->instances[i];
+                    for( unsigned k = 0; k < box_size; k++ )
+                    {
+                        batch->vertices->push_back((*batch->box_vertices)[k] * transform);
+                        batch->normals->push_back(osg::Matrixd::transform3x3((*batch->box_normals)[k], transform));
+                    }
+                }
+                batch->flushed = batch->instances.size();
+
+                batch->triangles->setCount(batch->vertices->size());
+                batch->vertices->dirty();
+                batch->normals->dirty();
+                batch->triangles->dirty();
+                batch->geometry->dirtyBound();
+                PRX_DEBUG_COLOR("Obstacle batch " << it->first << " holds " << batch->instances.size() << " boxes", PRX_TEXT_GREEN);
             }
         }
 
@@ -1030,24 +1169,46 @@ namespace prx
                     root_conf.zero();
                     if(body_key_value.second->has_attribute("root_configuration"))
                         root_conf.init(body_key_value.second->get_child("root_configuration").get());
+                    // Obstacles are static unless they say otherwise, and static boxes and meshes are batched
+                    bool is_static = body_key_value.second->get_attribute_as<bool>("static", true);
                     foreach(const parameter_reader_t* r, readers)
                     {
                         geom_name = r->get_attribute_as< std::string > ("name");
                         std::string name = obstacles_path + "/obstacles/" + body_key_value.first + "/" + geom_name;
                         // PRX_INFO_S("The geom name is : " << name << " | " << geom_name);
-                        osg::ref_ptr<osg::PositionAttitudeTransform> parent = new osg::PositionAttitudeTransform();
-                        init_geometries(obstacles_path + "/obstacles/" + body_key_value.first, geom_name, r, parent);
+                        if( static_obstacles.find(name) != static_obstacles.end() )
+                            continue;
                         config_t conf;
                         conf.init(r->get_child("config").get());
                         // PRX_INFO_S("++["<<root_conf.get_position()[0]<<","<<root_conf.get_position()[1]<<","<<root_conf.get_position()[2]<<"]");
                         // PRX_INFO_S("--["<<conf.get_position()[0]<<","<<conf.get_position()[1]<<","<<conf.get_position()[2]<<"]");
                         conf.relative_to_global(root_conf);
+                        if( is_static && !r->has_element("visualization_geometry") && r->get_attribute("collision_geometry/type") == "box" )
+                        {
+                            geometry_t box;
+                            r->initialize(&box, "collision_geometry");
+                            add_static_box(name, r->get_attribute("collision_geometry/material"), &box, conf);
+                            continue;
+                        }
+                        // unreadable meshes go the usual way, which draws the collision geometry instead
+                        if( is_static && r->has_element("visualization_geometry") && r->get_attribute("visualization_geometry/type") == "mesh"
+                            && add_static_mesh(name, r, conf) )
+                            continue;
+                        osg::ref_ptr<osg::PositionAttitudeTransform> parent = new osg::PositionAttitudeTransform();
+                        init_geometries(obstacles_path + "/obstacles/" + body_key_value.first, geom_name, r, parent);
                         parent->setAttitude(toOSGQuat(conf.get_orientation()));
                         parent->setPosition(toVec3(conf.get_position()));
                         obstacles[name] = parent;
+                        if( !is_static )
+                            dynamic_obstacles[name] = true;
+                        else
+                            obstacle_stamps[name].resolved = true;
                     }
 
                 }
+                flush_obstacle_batches();
+                PRX_INFO_S("Batched " << static_obstacles.size() << " static obstacles into " << obstacle_batches.size() + mesh_batch.count_drawables()
+                           << " drawables, " << mesh_batch.get_instance_count() << " of them meshes");
             }
             else
             {
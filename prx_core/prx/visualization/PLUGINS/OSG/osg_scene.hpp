@@ -17,6 +17,7 @@
 
 #include "prx/utilities/definitions/defs.hpp"
 #include "prx/utilities/definitions/hash.hpp"
+#include "prx/utilities/communication/tf_listener.hpp"
 #include "prx/visualization/scene.hpp"
 #include "osg_ghost_switch.hpp"
 #include "prx/visualization/PLUGINS/OSG/osg_basic.hpp"
@@ -24,6 +25,7 @@
 #include "prx/visualization/PLUGINS/OSG/osg_material.hpp"
 #include "prx/visualization/PLUGINS/OSG/osg_texture.hpp"
 #include "prx/visualization/PLUGINS/OSG/osg_hud.hpp"
+#include "prx/visualization/PLUGINS/OSG/osg_mesh_batch.hpp"
 
 #include <osgText/Font>
 #include <osgText/Text>
@@ -34,6 +36,31 @@ namespace prx
     namespace vis 
     {
 
+/**
+ * Static box obstacles that share a size and a material are drawn as one
+ * merged geometry. The shared box is stored once in local coordinates and every
+ * obstacle contributes a world transform, which is applied when its triangles
+ * are appended to the batch.
+ *
+ * @brief <b> A batch of static box obstacles </b>
+ */
+struct obstacle_batch_t
+{
+    /** @brief The shared box, 12 triangles in local coordinates */
+    osg::ref_ptr<osg::Vec3Array> box_vertices;
+    osg::ref_ptr<osg::Vec3Array> box_normals;
+    /** @brief One world transform per obstacle in the batch */
+    std::vector<osg::Matrixd> instances;
+
+    osg::ref_ptr<osg::Geode> geode;
+    osg::ref_ptr<osg::Geometry> geometry;
+    osg::ref_ptr<osg::Vec3Array> vertices;
+    osg::ref_ptr<osg::Vec3Array> normals;
+    osg::ref_ptr<osg::DrawArrays> triangles;
+    /** @brief Instances already uploaded to the vertex arrays */
+    unsigned flushed;
+};
+
 /**
  * OSG implementation of abstract scene class
  * 
@@ -231,6 +258,27 @@ public:
     
     /** @brief Maps obstacle names to obstacles PAT nodes */
     boost::unordered_map< std::string, osg::ref_ptr<osg::PositionAttitudeTransform> , util::string_hash> obstacles;
+
+    /** @brief Obstacles in the obstacles map that can move, their transforms are re-read whenever tf has a newer one */
+    boost::unordered_map< std::string, bool , util::string_hash> dynamic_obstacles;
+
+    /**
+     * @brief The tf stamps obstacles were last moved with. Static obstacles are resolved as soon as they are placed
+     * from their configuration, since nothing broadcasts them on tf; only dynamic obstacles are looked up.
+     */
+    boost::unordered_map< std::string, util::tf_stamp_t , util::string_hash> obstacle_stamps;
+
+    /**
+     * @brief Maps the names of batched static obstacles to their box batch, NULL for the ones in mesh_batch. These have
+     * no PAT node and are never moved.
+     */
+    boost::unordered_map< std::string, obstacle_batch_t* , util::string_hash> static_obstacles;
+
+    /** @brief Batches of static box obstacles, keyed by material and box size */
+    boost::unordered_map< std::string, obstacle_batch_t* , util::string_hash> obstacle_batches;
+
+    /** @brief Static obstacles drawn with a mesh, merged per material */
+    osg_mesh_batch_t mesh_batch;
     
     /** @brief Maps system pathnames to their respective osg Node pointers */
     boost::unordered_map< std::string, osg::ref_ptr<osg::Node> , util::string_hash> systems;
@@ -262,6 +310,35 @@ private:
      */
     osg::ref_ptr<osg::Node> make_geometry(const std::string& name, const util::geometry_t* geom, osg_material_t* material, bool transparent, bool use_color = false);
     
+    /**
+     * Adds a static box obstacle to the batch for its material and size, creating
+     * the batch the first time it is needed. The batch is drawn once flush_obstacle_batches is called.
+     *
+     * @brief Adds a box obstacle to a batched drawable
+     * @param name The full name of the obstacle geometry
+     * @param material_name The template material of the box
+     * @param geom The box geometry
+     * @param conf The global configuration of the box
+     */
+    void add_static_box(const std::string& name, const std::string& material_name, const util::geometry_t* geom, const util::config_t& conf);
+
+    /**
+     * Adds a static obstacle drawn with a mesh to mesh_batch, with its visualization local transform. The batch is
+     * drawn once flush_obstacle_batches is called.
+     *
+     * @brief Adds a mesh obstacle to the merged meshes
+     * @param name The full name of the obstacle geometry
+     * @param reader The reader of the geometry, with a mesh visualization_geometry
+     * @param conf The global configuration of the obstacle
+     * @return False if the mesh cannot be read, the obstacle is then left to the caller
+     */
+    bool add_static_mesh(const std::string& name, const util::parameter_reader_t* reader, const util::config_t& conf);
+
+    /**
+     * @brief Uploads the boxes and merges the meshes added since the last flush
+     */
+    void flush_obstacle_batches();
+
     /** @brief Used in make geometry to determine line thickness of line geometric primitives */
     double line_thickness;
 
@@ -18,15 +18,62 @@
 
 #include <osg/Version>
 
+#include <atomic>
+
 namespace prx 
 { 
     using namespace util;
     namespace vis 
     {
 
+/**
+ * Reads back the framebuffer of a camera into a shared frame ring after the camera has drawn, for
+ * as many frames as have been requested.
+ *
+ * @brief <b> Framebuffer read back into shared memory </b>
+ */
+class shared_frame_capture_t : public osg::Camera::DrawCallback
+{
+public:
+    shared_frame_capture_t(shared_frame_ring_t* ring) : ring(ring), requested(0) { }
+
+    void request(int frames)
+    {
+        requested += frames;
+    }
+
+    virtual void operator()(osg::RenderInfo& render_info) const
+    {
+        // request runs on the ROS callback thread and this on the draw thread, take one frame only if one is left
+        int left = requested.load();
+        do
+        {
+            if (left <= 0)
+                return;
+        } while (!requested.compare_exchange_weak(left, left - 1));
+        const osg::Viewport* viewport = render_info.getCurrentCamera()->getViewport();
+        int width = viewport->width(), height = viewport->height();
+        // tightly packed RGB rows, bottom row first as OpenGL returns them
+        unsigned char* pixels = ring->begin_write(width, height, 3, width * 3, true);
+        if (pixels == NULL)
+        {
+            PRX_WARN_S("A " << width << "x" << height << " frame does not fit in the shared frame slots, raise shared_frame_bytes");
+            return;
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(viewport->x(), viewport->y(), width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+        ring->end_write();
+    }
+
+private:
+    shared_frame_ring_t* ring;
+    mutable std::atomic<int> requested;
+};
+
 osg_viewer_t::osg_viewer_t()
 {
     follow_name = "";
+    follow_window_num = 0;
 }
 
 osg_viewer_t::~osg_viewer_t()
@@ -204,7 +251,9 @@ osg::ref_ptr<osgViewer::ScreenCaptureHandler> osg_viewer_t::init_handlers(int nu
 void osg_viewer_t::take_screenshot(unsigned screen_num, int num_screenshots)
 {
     // PRX_PRINT("Screenshot handlers..."<<screenshot_handlers.size()<<", "<<screen_num<<", "<<num_screenshots, PRX_TEXT_CYAN);
-    if (screen_num < screenshot_handlers.size())
+    if (frame_capture.valid())
+        frame_capture->request(num_screenshots);
+    else if (screen_num < screenshot_handlers.size())
     {
         screenshot_handlers[follow_window_num]->setFramesToCapture(num_screenshots);
         screenshot_handlers[follow_window_num]->startCapture();
@@ -405,6 +454,19 @@ void osg_viewer_t::init(const parameter_reader_t* reader)
 
     if(reader->has_attribute("follow_object"))
         follow_name = reader->get_attribute("follow_object");
+
+    // Sensing frames go through shared memory instead of prx_output/images/_0.jpg
+    std::string shared_frames = reader->get_attribute_as<std::string>("shared_frames", "");
+    if(!shared_frames.empty())
+    {
+        unsigned slots = reader->get_attribute_as<unsigned>("shared_frame_slots", 3);
+        size_t slot_bytes = reader->get_attribute_as<unsigned>("shared_frame_bytes", 1920 * 1080 * 3);
+        if(!frame_ring.create(shared_frames, slots, slot_bytes))
+            PRX_FATAL_S("Could not create the shared frame ring " << shared_frames);
+        frame_capture = new shared_frame_capture_t(&frame_ring);
+        windows[follow_window_num]->get_wrapped_view()->getCamera()->setFinalDrawCallback(frame_capture.get());
+        PRX_PRINT("Writing sensing frames to shared memory " << shared_frames, PRX_TEXT_GREEN);
+    }
 }
 
     }
@@ -21,6 +21,7 @@
 #include "prx/visualization/PLUGINS/OSG/osg_geode.hpp"
 #include "prx/visualization/PLUGINS/OSG/osg_window.hpp"
 #include "prx/visualization/PLUGINS/OSG/osg_texture.hpp"
+#include "prx/utilities/communication/shared_frame_ring.hpp"
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem.hpp>
 
@@ -29,6 +30,8 @@ namespace prx
     namespace vis 
     {
 
+class shared_frame_capture_t;
+
 /**
  * OSG implementation of the viewer_t abstract class 
  * 
@@ -78,6 +81,12 @@ private:
     /** @brief Maps window number to screenshot handler */
     std::vector< osg::ref_ptr<osgViewer::ScreenCaptureHandler> > screenshot_handlers;
 
+    /** @brief Frames read back for sensing when "shared_frames" names a shared memory ring, instead of screenshot files */
+    util::shared_frame_ring_t frame_ring;
+
+    /** @brief Draw callback of the follow window that writes requested frames to frame_ring */
+    osg::ref_ptr<shared_frame_capture_t> frame_capture;
+
 public:
     osg_viewer_t();
     ~osg_viewer_t();
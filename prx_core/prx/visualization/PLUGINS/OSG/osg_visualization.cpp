@@ -38,6 +38,8 @@ namespace prx
         {
             PRX_DEBUG_S("Constructing OSG visualization.");
             initialized = false;
+            frame_lookups = 0;
+            frame_stamp_queries = 0;
 
             const std::string model_path = std::getenv("PRACSYS_PATH");
             osgDB::setDataFilePathList(model_path+"/meshes/");
@@ -90,71 +92,52 @@ namespace prx
 //
 //        }
         
-        void update_configurations(const tf_listener_t& listener, osg_scene_t& scene)
+        void osg_visualization_t::update_configurations()
         {
+            osg_scene_t& scene = *osg_scene;
+            listener->reset_counters();
+
             // Working memory.
             config_t config;
 
             typedef boost::unordered_map< std::string, osg::ref_ptr<osg::PositionAttitudeTransform>, string_hash>::iterator iter_t;
 
             // PRX_PRINT("Things to update? " << scene.info_geoms_to_update.size(), PRX_TEXT_RED);
-            foreach(std::string geom_name, scene.info_geoms_to_update)
+            // Info geometries whose transform has not moved since it was last read stay where they are
+            foreach(const std::string& geom_name, scene.info_geoms_to_update)
             {
-                try
-                {
-                    listener.lookup(geom_name, config);
-                    // PRX_PRINT(":: " << geom_name << " : " << config, PRX_TEXT_RED);
-                }
-                catch( tf::TransformException ex)
-                {
-                    continue;
-                }
-                scene.move_info_geometry(geom_name, config);
+                if( listener->lookup_if_changed(geom_name, config, transform_stamps[geom_name]) )
+                    scene.move_info_geometry(geom_name, config);
             }
             scene.info_geoms_to_update.clear();
             for( iter_t iter = scene.rigid_bodies.begin(); iter != scene.rigid_bodies.end(); ++iter )
             {
                 const std::string& name = iter->first;
-                try
-                {
-                    listener.lookup(name, config);
-                    // PRX_PRINT(":: " << name << " : " << config, PRX_TEXT_BLUE);
-                }
-                catch(tf::TransformException ex)
-                {
-                    continue;
-                }
-//                PRX_DEBUG_COLOR("Plt Listener name: " << name << " : " << config.print(),PRX_TEXT_MAGENTA);
-                //        config.print();
-                
-                scene.move_geometry(name, config);
-                
+                if( listener->lookup_if_changed(name, config, transform_stamps[name]) )
+                    scene.move_geometry(name, config);
             }
-            
-            for(iter_t iter = scene.obstacles.begin(); iter!=scene.obstacles.end(); ++iter)
+
+            // Static obstacles stay where osg_scene_t placed them from their configuration, only the
+            // dynamic ones follow tf
+            typedef boost::unordered_map< std::string, bool, string_hash>::iterator dynamic_iter_t;
+            for(dynamic_iter_t iter = scene.dynamic_obstacles.begin(); iter != scene.dynamic_obstacles.end(); ++iter)
             {
                 const std::string& name = iter->first;
-                try
-                {
-                    listener.lookup(name, config);
-                    // PRX_PRINT(":: " << name << " : " << config, PRX_TEXT_GREEN);
-                }
-                catch(tf::TransformException ex)
-                {       
-                    continue;                    
-                }
-//                PRX_DEBUG_COLOR("Obs Listener name: " << name<< " : " << config.print(),PRX_TEXT_RED);
-                
-                osg::PositionAttitudeTransform* current_node =
-                scene.obstacles[name]->asTransform()->asPositionAttitudeTransform();
+                if( !listener->lookup_if_changed(name, config, scene.obstacle_stamps[name]) )
+                    continue;
+
+                osg::PositionAttitudeTransform* current_node = scene.obstacles[name].get();
 
                 double quat[4];
                 config.get_xyzw_orientation(quat);
                 current_node->setAttitude(toOSGQuat(quat));
                 current_node->setPosition(toVec3(config.get_position()));
-                
             }
 
+            if( listener->get_lookup_count() != frame_lookups )
+                PRX_DEBUG_COLOR("tf lookups this frame: " << listener->get_lookup_count() << " (" << listener->get_stamp_query_count() << " stamp queries)", PRX_TEXT_CYAN);
+            frame_lookups = listener->get_lookup_count();
+            frame_stamp_queries = listener->get_stamp_query_count();
         }
 
         bool osg_visualization_t::run()
@@ -170,7 +153,7 @@ namespace prx
             {
                 //        ros::getGlobalCallbackQueue()->callAvailable();
                 ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.04));
-                update_configurations(*listener, *osg_scene);
+                update_configurations();
 
                 for (unsigned i = 0; i <window_screenshot_queue.size(); i++)
                 {
@@ -198,7 +181,8 @@ namespace prx
             {
                 if (poll_tf)
                 {
-                    listener->lookup(geom_names[i], temp_conf);
+                    if( !listener->lookup_if_changed(geom_names[i], temp_conf, transform_stamps[geom_names[i]]) )
+                        continue;
                 }
                 else
                 {
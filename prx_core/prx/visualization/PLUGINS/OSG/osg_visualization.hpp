@@ -59,6 +59,22 @@ protected:
     
     std::vector< std::pair<unsigned,int> > window_screenshot_queue;
 
+    /** @brief The tf stamps plants and info geometries were last moved with, see osg_scene_t::obstacle_stamps for obstacles */
+    boost::unordered_map< std::string, util::tf_stamp_t, util::string_hash> transform_stamps;
+    /** @brief Full tf lookups performed during the last frame */
+    unsigned frame_lookups;
+    /** @brief tf stamp queries performed during the last frame */
+    unsigned frame_stamp_queries;
+
+    /**
+     * Moves plants, info geometries and obstacles to their latest tf configuration.
+     * A transform is only looked up when tf has a newer stamp than the one it was
+     * last read with, and static obstacles are looked up once.
+     *
+     * @brief Updates the scene from tf
+     */
+    void update_configurations();
+
 public:
 
     osg_visualization_t();
@@ -94,6 +110,12 @@ public:
 
     void take_screenshot(unsigned screen_num, int num_screenshots);
 
+    /** @brief Full tf lookups performed during the last frame */
+    unsigned get_frame_lookups() const { return frame_lookups; }
+
+    /** @brief tf stamp queries performed during the last frame */
+    unsigned get_frame_stamp_queries() const { return frame_stamp_queries; }
+
 };
 
     }
@@ -0,0 +1,208 @@
+"""Converts a TensorFlow checkpoint (tf_model-8.index + tf_model-8.data-00000-of-00001) into the
+tensor archive read by prx::util::tensor_archive_t, without needing TensorFlow.
+
+    python export_weights.py <checkpoint prefix> <output> [--layers "dense 10"] [--order W1,b1]
+
+The archive is little-endian: a 256 byte header, one 120 byte entry per tensor (name, dtype, shape,
+offset, size) and the payloads, each aligned to 64 bytes. Tensors are written in layer order, weights
+before bias, which is the order digit_classifier_t consumes them in. --order overrides it.
+"""
+import re
+import struct
+import sys
+
+ARCHIVE_MAGIC = b'PRXTENS\0'
+ARCHIVE_VERSION = 1
+HEADER_SIZE = 256
+ENTRY_SIZE = 120
+ALIGNMENT = 64
+
+# TensorFlow DataType values we can convert, to (archive dtype, element size)
+TF_DTYPES = {1: (1, 4), 3: (3, 4), 6: (2, 1)}
+
+
+def read_varint(data, position):
+    result = 0
+    shift = 0
+    while True:
+        byte = bytearray(data[position:position + 1])[0]
+        position += 1
+        result |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return result, position
+
+
+def read_block(data, offset, size):
+    """The key/value pairs of one uncompressed SSTable block."""
+    if bytearray(data[offset + size:offset + size + 1])[0] != 0:
+        raise ValueError('compressed checkpoint index blocks are not supported')
+    block = data[offset:offset + size]
+    restart_count = struct.unpack('<I', block[-4:])[0]
+    end = len(block) - 4 * (restart_count + 1)
+    entries = []
+    key = b''
+    position = 0
+    while position < end:
+        shared, position = read_varint(block, position)
+        unshared, position = read_varint(block, position)
+        value_size, position = read_varint(block, position)
+        key = key[:shared] + block[position:position + unshared]
+        position += unshared
+        entries.append((key, block[position:position + value_size]))
+        position += value_size
+    return entries
+
+
+def read_fields(message):
+    """The (field number, value) pairs of a protobuf message, values are ints or bytes."""
+    fields = []
+    position = 0
+    while position < len(message):
+        tag, position = read_varint(message, position)
+        field, wire_type = tag >> 3, tag & 7
+        if wire_type == 0:
+            value, position = read_varint(message, position)
+        elif wire_type == 1:
+            value = struct.unpack('<Q', message[position:position + 8])[0]
+            position += 8
+        elif wire_type == 2:
+            size, position = read_varint(message, position)
+            value = message[position:position + size]
+            position += size
+        elif wire_type == 5:
+            value = struct.unpack('<I', message[position:position + 4])[0]
+            position += 4
+        else:
+            raise ValueError('unsupported protobuf wire type %d' % wire_type)
+        fields.append((field, value))
+    return fields
+
+
+def read_checkpoint(prefix):
+    """Returns [(name, tf dtype, shape, bytes)] for every tensor in the checkpoint."""
+    with open(prefix + '.index', 'rb') as index_file:
+        index = index_file.read()
+    # the footer is the metaindex and index block handles, padding and an 8 byte magic
+    footer = index[-48:]
+    _, position = read_varint(footer, 0)
+    _, position = read_varint(footer, position)
+    index_offset, position = read_varint(footer, position)
+    index_size, position = read_varint(footer, position)
+
+    shards = {}
+    shard_count = 1
+    tensors = []
+    for _, handle in read_block(index, index_offset, index_size):
+        block_offset, position = read_varint(handle, 0)
+        block_size, position = read_varint(handle, position)
+        for key, value in read_block(index, block_offset, block_size):
+            if not key:
+                # the BundleHeaderProto, sorted first
+                shard_count = dict(read_fields(value)).get(1, 1)
+                continue
+            name = key.decode('utf-8')
+            dtype, shape, shard, offset, size = 0, [], 0, 0, 0
+            for field, field_value in read_fields(value):
+                if field == 1:
+                    dtype = field_value
+                elif field == 2:
+                    for dim_field, dim in read_fields(field_value):
+                        if dim_field == 2:
+                            shape.extend(size_value for size_field, size_value in read_fields(dim) if size_field == 1)
+                elif field == 3:
+                    shard = field_value
+                elif field == 4:
+                    offset = field_value
+                elif field == 5:
+                    size = field_value
+                elif field == 7:
+                    raise ValueError('partitioned variable %s is not supported' % name)
+            if shard not in shards:
+                with open('%s.data-%05d-of-%05d' % (prefix, shard, shard_count), 'rb') as data_file:
+                    shards[shard] = data_file.read()
+            tensors.append((name, dtype, shape, shards[shard][offset:offset + size]))
+    return tensors
+
+
+def layer_order(name):
+    """conv layers before dense ones, then by layer number, weights before bias."""
+    lower = name.lower()
+    number = re.findall(r'\d+', name)
+    return ('fc' in lower or 'dense' in lower, int(number[-1]) if number else 0, not lower.startswith('w'), name)
+
+
+def write_archive(path, tensors, description):
+    description = description.encode('utf-8')
+    if len(description) >= 240:
+        raise ValueError('the layer description is longer than 239 bytes')
+    offset = HEADER_SIZE + ENTRY_SIZE * len(tensors)
+    entries = []
+    payloads = []
+    for name, dtype, shape, payload in tensors:
+        if dtype not in TF_DTYPES:
+            raise ValueError('tensor %s has unsupported dtype %d' % (name, dtype))
+        if len(shape) > 4 or len(name) >= 64:
+            raise ValueError('tensor %s cannot be stored' % name)
+        archive_dtype, element_size = TF_DTYPES[dtype]
+        elements = 1
+        for dim in shape:
+            elements *= dim
+        if elements * element_size != len(payload):
+            raise ValueError('tensor %s has %d bytes for shape %s' % (name, len(payload), shape))
+        offset = (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+        padded_shape = list(shape) + [0] * (4 - len(shape))
+        entries.append(struct.pack('<64sII4QQQ', name.encode('utf-8'), archive_dtype, len(shape),
+                                   padded_shape[0], padded_shape[1], padded_shape[2], padded_shape[3],
+                                   offset, len(payload)))
+        payloads.append((offset, payload))
+        offset += len(payload)
+
+    with open(path, 'wb') as archive:
+        archive.write(struct.pack('<8sII240s', ARCHIVE_MAGIC, ARCHIVE_VERSION, len(tensors), description))
+        for entry in entries:
+            archive.write(entry)
+        for payload_offset, payload in payloads:
+            archive.write(b'\0' * (payload_offset - archive.tell()))
+            archive.write(payload)
+
+
+def main(arguments):
+    description = ''
+    order = None
+    positional = []
+    i = 0
+    while i < len(arguments):
+        if arguments[i] == '--layers':
+            description = arguments[i + 1]
+            i += 1
+        elif arguments[i] == '--order':
+            order = arguments[i + 1].split(',')
+            i += 1
+        else:
+            positional.append(arguments[i])
+        i += 1
+    if len(positional) != 2:
+        print(__doc__)
+        return 1
+
+    tensors = read_checkpoint(positional[0])
+    by_name = dict((tensor[0], tensor) for tensor in tensors)
+    if order is not None:
+        missing = [name for name in order if name not in by_name]
+        if missing:
+            print('Not in the checkpoint: %s (it has %s)' % (', '.join(missing), ', '.join(sorted(by_name))))
+            return 1
+        tensors = [by_name[name] for name in order]
+    else:
+        tensors.sort(key=lambda tensor: layer_order(tensor[0]))
+
+    write_archive(positional[1], tensors, description)
+    for name, dtype, shape, payload in tensors:
+        print('%-16s %-16s %d bytes' % (name, 'x'.join(str(dim) for dim in shape), len(payload)))
+    print('Wrote %s' % positional[1])
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,70 @@
+"""Writes the logits the source model gives the first t10k images, for classifier_benchmark to check the
+native classifier against.
+
+    python reference_logits.py <checkpoint prefix> <MNIST_data directory> <output> [count]
+
+With TensorFlow the meta graph is restored and the input of op_y, the logits of the softmax, is run on the
+images. Without it the checkpoint is read like export_weights.py does and the graph of
+tf_train_model_ASSIGNMENT_FILE.py, softmax(x W1 + b1), is evaluated in float64.
+
+Every line of the output is the label of one image followed by its 10 logits.
+"""
+import gzip
+import os
+import struct
+import sys
+
+import numpy as np
+
+
+def read_images(directory, count):
+    with gzip.open(os.path.join(directory, 't10k-images-idx3-ubyte.gz'), 'rb') as image_file:
+        data = image_file.read()
+    with gzip.open(os.path.join(directory, 't10k-labels-idx1-ubyte.gz'), 'rb') as label_file:
+        labels = label_file.read()
+    _, total, rows, columns = struct.unpack('>IIII', data[:16])
+    count = min(count, total)
+    size = rows * columns
+    images = np.frombuffer(data[16:16 + count * size], dtype=np.uint8).reshape(count, size)
+    # as input_data.read_data_sets and idx_dataset_t scale them
+    return images.astype(np.float32) / 255.0, bytearray(labels[8:8 + count])
+
+
+def tensorflow_logits(prefix, images):
+    import tensorflow as tf
+    saver = tf.train.import_meta_graph(prefix + '.meta')
+    with tf.Session() as session:
+        saver.restore(session, prefix)
+        graph = tf.get_default_graph()
+        logits = graph.get_tensor_by_name('op_y:0').op.inputs[0]
+        return session.run(logits, feed_dict={graph.get_tensor_by_name('ph_x:0'): images})
+
+
+def checkpoint_logits(prefix, images):
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    from export_weights import read_checkpoint
+    tensors = dict((name, np.frombuffer(payload, dtype=np.float32).reshape(shape))
+                   for name, dtype, shape, payload in read_checkpoint(prefix) if dtype == 1)
+    return np.dot(images.astype(np.float64), tensors['W1'].astype(np.float64)) + tensors['b1']
+
+
+def main(arguments):
+    if len(arguments) not in (3, 4):
+        print(__doc__)
+        return 1
+    images, labels = read_images(arguments[1], int(arguments[3]) if len(arguments) > 3 else 100)
+    try:
+        logits = tensorflow_logits(arguments[0], images)
+        source = 'TensorFlow'
+    except ImportError:
+        logits = checkpoint_logits(arguments[0], images)
+        source = 'the checkpoint in float64, TensorFlow is not installed'
+    with open(arguments[2], 'w') as output:
+        for label, row in zip(labels, logits):
+            output.write('%d %s\n' % (label, ' '.join(repr(float(value)) for value in row)))
+    print('Wrote the logits of %d images from %s to %s' % (len(labels), source, arguments[2]))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
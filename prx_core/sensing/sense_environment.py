@@ -83,6 +83,11 @@ for arr in array:
     for ar in arr:
     	image_array.append(ar)
 im_array = np.array(image_array)
+# a second argument stores the classifier input, the reference preprocess_check compares the C++ pipeline against
+if len(sys.argv) > 2:
+	reference = open(sys.argv[2], 'w')
+	reference.write("\n".join(repr(value) for value in image_array)+"\n")
+	reference.close()
 print image_array
 print im_array
 out = predict(im_array)